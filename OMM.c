@@ -1,24 +1,72 @@
 #include "matrix.h"
 //#include "matrix.test.h"
+//#include "output.test.h"
+//#include "scheduler.test.h"
+//#include "matrix.bench.h"
 #include "output.h"
+#include "wcet.h"
+#include "codegen.h"
+#include "display.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "patterns.h"
 #include "types.h"
 #include "config.h"
 #include "nodetypes.h"
+#include "definitions.h"
 
 #include <built_in.h>
 
 //#define RUNTESTS
+//#define RUNBENCH
 #define DACTESTS
 
+// run the patch through code emitted by emitPatch() instead of runMatrix().
+// The emitted file must be added to the project and the patch built below
+// must be the one it was emitted from.
+//#define COMPILED_PATCH
+
+// record the results of the nodes added with addTraceNode() below after every
+// matrix run, and dump them on the serial port when a 'd' is received. The
+// dump blocks the main loop, so the outputs stop updating while it is sent.
+//#define TRACE_PATCH
+
 // The number of dac updates finished since last time the matrix were run.
 // This is checked before a new runMatrix is called as timing is done through
 // a timer interrupt that increments what dac to update.
 // NB: As dacs may have been updated multiple times since the matrix run started,
 // any ramp increments should be multiplied by this number to get correct timing.
 // This is done by using intervalMultiplier, which is a copy of dacUpdatesFinished
-// that stays constant through a whole run of the matrix.
+// that stays constant through a whole run of the matrix, to set the time scale
+// of the matrix.
 unsigned short dacUpdatesFinished;
-unsigned short intervalMultiplier;  //TODO: set og reset denne
+unsigned short intervalMultiplier;
+
+// the matrix running the current patch
+Matrix matrix;
+
+// tasks run by the main loop, the matrix first
+Scheduler scheduler;
+Task matrixTaskEntry;
+Task displayTaskEntry;
+
+// a sliced matrix run is in progress
+unsigned short frameRunning;
+
+// S&H output the lcd was last stepped on
+unsigned short displayTick;
+
+// timer counts used by one pass of the display task
+#define DISPLAY_TASK_COUNTS 150
+
+#ifdef TRACE_PATCH
+Task traceTaskEntry;
+
+// timer counts used to check the serial port for a dump command
+#define TRACE_TASK_COUNTS 20
+#endif
+
+unsigned short iteration;
 
 // Lcd module connections
 sbit LCD_RS at LATB2_bit;
@@ -42,6 +90,7 @@ char txt2[] = "EasyPIC7";
 void interrupt() {
     unsigned short i;
     matrixint *tempOutputBuffer;
+    matrixint dacValue;
     
     if(PIR1.TMR1IF){
         //restart timer
@@ -50,23 +99,33 @@ void interrupt() {
         PIE1.TMR1IE = 1;
         PIR1.TMR1IF = 0;
 
+        // gates and triggers are updated on every tick, not once per rotation
+        flushGateOutputs(&matrix);
+
         if(shToUpdate == 0){
         
-            if(matrixCalculationCompleted){
+            if(matrix.matrixCalculationCompleted){
                 // swap output buffer with dac buffer to make sure nothing 
                 // changes while updating dacs.
-                tempOutputBuffer = outputBuffer;
-                outputBuffer = dacBuffer;
+                tempOutputBuffer = matrix.outputBuffer;
+                matrix.outputBuffer = dacBuffer;
                 dacBuffer = tempOutputBuffer;
-                matrixCalculationCompleted = 0;
+                matrix.matrixCalculationCompleted = 0;
+            } else {
+                // matrix did not finish in time, dac rate is too fast
+                dacMissedSwaps++;
             }
 
             // signal that data has been copied and that next matrix calculation
             // may start.
             dacUpdatesFinished++;
+            dacRotations++;
         }
 
-        //writeToDac(dacBuffer[shToUpdate]);
+        // interpolated channels are stepped here even while the dac write
+        // is disabled, so they keep their timing.
+        dacValue = nextDacValue(shToUpdate);
+        //writeToDac(dacValue);
 
         // step to next sample and hold output
         // TODO: Fix sh shift register
@@ -79,30 +138,25 @@ void interrupt() {
     }
 }
 
-void printSignedShort(unsigned short row, unsigned short col, short in){
-  unsigned short inExpanded;
-  unsigned short rest;
-  if(in < 0){
-    Lcd_Chr(row, col, '-');
-    inExpanded = -in;
-  } else {
-    Lcd_Chr(row, col, ' ');
-    inExpanded = in;
-  }
-
-  rest = inExpanded % 10;
-  Lcd_Chr(row, col+3, 48 + rest);
-
-  rest = (inExpanded / 10) % 10;
-  Lcd_Chr(row, col+2, 48 + rest);
-
-  rest = (inExpanded / 100) % 10;
-  Lcd_Chr(row, col+1, 48 + rest);
-}
-
 #ifdef RUNTESTS
 void main() {
     runMatrixTests();
+    runOutputTests();
+    runSchedulerTests();
+}
+#endif
+
+#ifdef RUNBENCH
+void benchSink(char character){
+    UART1_Write(character);
+}
+
+// benchmark results are sent over the serial port as CSV
+void main() {
+    UART1_Init(115200);
+    matrixTimerInit();
+    runMatrixBenchmarks(benchSink);
+    while(1);
 }
 #endif
 
@@ -112,7 +166,7 @@ void main() {
 
     iteration = 0;
     dacStep = 0;
-    outputBufferInit();
+    outputBufferInit(&matrix);
     dacInit();
 
     Lcd_Init();                        // Initialize Lcd
@@ -147,15 +201,105 @@ void main() {
 #endif
 
 #ifndef RUNTESTS
+#ifndef RUNBENCH
 #ifndef DACTESTS
+// Foreground task, starts a matrix run once the previous result has been
+// swapped into the dac buffer. Returns 1 if the matrix ran.
+unsigned short matrixTask(){
+#if MATRIX_SLICE_NODES
+    // Large patches run a slice at a time. A new run starts once the
+    // previous one has been copied to the dacs and is handed over when its
+    // last slice is done, so the dac rate stays the same and the outputs
+    // are updated every few S&H rotations instead of glitching.
+    if(!frameRunning && !matrix.matrixCalculationCompleted && dacUpdatesFinished){
+        intervalMultiplier = dacUpdatesFinished;
+        dacUpdatesFinished = 0;
+        startDacFrame(intervalMultiplier);
+        matrix.timeScale = dacTimeScale * intervalMultiplier;
+        frameRunning = 1;
+    }
+    if(frameRunning){
+        if(runMatrixSlice(&matrix, MATRIX_SLICE_NODES)){
+            frameRunning = 0;
+#ifdef TRACE_PATCH
+            traceTick(&matrix);
+#endif
+        }
+        return 1;
+    }
+#else
+    // wait for the previous run to be swapped into the dac buffer
+    if(dacUpdatesFinished && !matrix.matrixCalculationCompleted){
+        intervalMultiplier = dacUpdatesFinished;
+        dacUpdatesFinished = 0;
+        startDacFrame(intervalMultiplier);
+        matrix.timeScale = dacTimeScale * intervalMultiplier;
+
+        matrixTimerStart();
+#ifdef COMPILED_PATCH
+        runCompiledPatch(&matrix);
+#else
+        runMatrix(&matrix);
+#endif
+        adaptDacInterval(matrixTimerRead());
+#ifdef TRACE_PATCH
+        traceTick(&matrix);
+#endif
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+// Background task, updates the framebuffer and moves the lcd one byte
+// closer to it. The lcd takes one byte per dac tick, which is longer than it
+// needs to execute it.
+unsigned short displayTask(){
+    displaySignedShort(2,1,matrix.outputBuffer[0]);
+    displaySignedShort(2,12,iteration++);
+
+    if(displayTick != shToUpdate){
+        displayTick = shToUpdate;
+        displayStep();
+    }
+    return 1;
+}
+
+#ifdef TRACE_PATCH
+void traceSink(char character){
+    UART1_Write(character);
+}
+
+// Background task, dumps the trace when asked to over the serial port
+unsigned short traceTask(){
+    if(!UART1_Data_Ready()){
+        return 0;
+    }
+    if(UART1_Read() != 'd'){
+        return 0;
+    }
+    traceStop();
+    dumpTrace(traceSink);
+    traceStart();
+    return 1;
+}
+#endif
+
 void main() {
-    unsigned short iteration, dacStep;
+    unsigned short dacStep, patchTiming;
+    unsigned int timerStart;
     Node aNode0, aNode1, aNode2, aNode3, aNode4, aNode5;
 
     iteration = 0;
     dacStep = 0;
-    outputBufferInit();
+    frameRunning = 0;
+    resetMatrix(&matrix);
+    outputBufferInit(&matrix);
+    matrix.patterns = sequencerPatterns;
+    matrix.patternsInUse = SEQUENCER_PATTERNS;
+    loadDacCalibration();
     dacInit();
+    gateOutputInit(&matrix);
 
     dacUpdatesFinished = 0;             //necessary to start runMatrix.
     dacTimerInit();
@@ -164,60 +308,128 @@ void main() {
     Lcd_Init();                        // Initialize Lcd
     Lcd_Cmd(_LCD_CLEAR);               // Clear display
     Lcd_Cmd(_LCD_CURSOR_OFF);          // Cursor off
-    Lcd_Out(1,1,txt1);                 // Write text in first row
+    displayInit();
+    displayText(1,1,txt1);             // Write text in first row
 
-    inputBuffer[0] = 2;
-    inputBuffer[1] = 4;
+    matrix.inputBuffer[0] = 2;
+    matrix.inputBuffer[1] = 4;
 
     aNode0.func = getFunctionPointer(NODE_INPUT);
-    aNode0.params[0] = 0;
-    aNode0.paramIsConstant = 0b0000001;
-    addNode(&aNode0);
+    addNode(&matrix, &aNode0);
+    addConstantParam(&matrix, &aNode0, 0);
 
     aNode1.func = getFunctionPointer(NODE_INPUT);
-    aNode1.params[0] = 1;
-    aNode1.paramIsConstant = 0b0000001;
-    addNode(&aNode1);
+    addNode(&matrix, &aNode1);
+    addConstantParam(&matrix, &aNode1, 1);
 
     aNode2.func = getFunctionPointer(NODE_SUM);
-    aNode2.params[0] = 0;
-    aNode2.params[1] = 4;
-    aNode2.paramsInUse = 2;
-    aNode2.paramIsConstant = 0b00000000;
-    addNode(&aNode2);
+    addNode(&matrix, &aNode2);
+    addNodeParam(&matrix, &aNode2, 0);
+    addNodeParam(&matrix, &aNode2, 4);
 
     aNode3.func = getFunctionPointer(NODE_OUTPUT);
-    aNode3.params[0] = 0; // write to 0
-    aNode3.params[1] = 2; // value from 2;
-    aNode3.paramIsConstant = 0b00000001;
-    addNode(&aNode3);
+    addNode(&matrix, &aNode3);
+    addConstantParam(&matrix, &aNode3, 0); // write to 0
+    addNodeParam(&matrix, &aNode3, 2);     // value from 2;
 
     aNode4.func = getFunctionPointer(NODE_DELAY_LINE);
     aNode4.result = 0; //set initial state to 0
-    aNode4.params[0] = 2;
-    aNode4.paramIsConstant = 0b00000000;
-    addNode(&aNode4);
+    addNode(&matrix, &aNode4);
+    addNodeParam(&matrix, &aNode4, 2);
+
+    // indexes are checked once here instead of every time the matrix runs,
+    // don't start outputs with a broken patch.
+    if(validatePatch(&matrix) != PATCH_OK){
+        displayText(2,1,"Patch error");
+        displayFlush();
+        while(1);
+    }
+
+    // replace common node chains with single fused nodes
+    fusePatch(&matrix);
+
+    // spread nodes running at lower rates over the matrix runs
+    staggerNodeRates(&matrix);
+
+    // resolve params to pointers where the target has room for them
+    linkPatch(&matrix);
+
+#ifdef TRACE_PATCH
+    // node indexes are the ones after fusePatch()
+    UART1_Init(115200);
+    traceInit();
+    addTraceNode(&matrix, 2);
+    addTraceNode(&matrix, 4);
+    traceStart();
+#endif
+
+    // from here on the dac rate follows the measured matrix load
+    dacRateInit();
+    matrixTimerInit();
+
+    // make sure the patch can finish within one S&H rotation at the starting
+    // rate, slow the dacs down to the fastest safe rate if not.
+    timerStart = getDacTimerStart();
+    patchTiming = checkPatchTiming(&matrix, timerStart);
+    if(patchTiming == WCET_OVERRUN){
+#if MATRIX_SLICE_NODES
+        // the patch runs in slices over several rotations, keep the dac rate
+        displayText(2,1,"Sliced patch");
+#else
+        timerStart = getMinimumDacTimerStart(&matrix);
+        if(timerStart == 0){
+            displayText(2,1,"Patch too slow");
+            displayFlush();
+            while(1);
+        }
+        setDacInterval(65536 - timerStart);
+        displayText(2,1,"Slow dac rate");
+#endif
+    } else if(patchTiming == WCET_WARNING){
+        displayText(2,1,"Near dac limit");
+    }
 
     // calculate initial state. dacUpdatesFinished will be 0, so any ramps
     // will not be incremented.
-    runMatrix();
+    matrix.timeScale = 0;
+#ifdef COMPILED_PATCH
+    runCompiledPatch(&matrix);
+#else
+    runMatrix(&matrix);
+#endif
     
+    // show the startup status before the dacs take over the time
+    displayFlush();
+    displayTick = shToUpdate;
+
+    // the matrix runs first on every pass, the display only in the time left
+    // before the next buffer swap.
+    schedulerInit(&scheduler);
+    matrixTaskEntry.func = matrixTask;
+    matrixTaskEntry.cost = 0;
+    matrixTaskEntry.period = 0;
+    addTask(&scheduler, &matrixTaskEntry);
+    displayTaskEntry.func = displayTask;
+    displayTaskEntry.cost = DISPLAY_TASK_COUNTS;
+    displayTaskEntry.period = 0;
+    addTask(&scheduler, &displayTaskEntry);
+#ifdef TRACE_PATCH
+    traceTaskEntry.func = traceTask;
+    traceTaskEntry.cost = TRACE_TASK_COUNTS;
+    traceTaskEntry.period = 0;
+    addTask(&scheduler, &traceTaskEntry);
+#endif
+
     // start writing to outputs
     dacTimerStart();
 
-    // tight loop that runs at most once for every dacUpdate cycle.
     while(1){
-        if(dacUpdatesFinished){
-            dacUpdatesFinished = 0;
-            intervalMultiplier = 0;
-            runMatrix();
-        }
-        printSignedShort(2,1,outputBuffer[0]);
-        printSignedShort(2,12,iteration++);
+        runScheduler(&scheduler);
     }
 }
 #endif
 #endif
+#endif
 
 /*
 TODO:
@@ -231,11 +443,6 @@ TODO:
 - quantizer - quantize to tone or other unit
 - glide/slide/resistance
 - Trigger (sends trigger pulse if input is high)
-- set og reset denne intervalMultiplier
-
-Mathematical expressions
-- divide
-- average
 
 Outputs
 - CV
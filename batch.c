@@ -0,0 +1,155 @@
+#include "types.h"
+#include "config.h"
+#include "matrix.h"
+#include "batch.h"
+
+// Batch runner for rendering many patches on the host, e.g. for offline
+// rendering or patch regression tests. Every job runs its own Matrix, which
+// shares no state with other matrixes, so jobs run on separate threads without
+// locking the engine. Each thread starts with an equal share of the jobs and
+// takes them from the front. A thread that runs out steals the back half of
+// the jobs another thread has left, so jobs of uneven length still keep all
+// threads busy.
+
+#ifdef TARGET_HOST
+#include <pthread.h>
+
+struct batch;
+
+typedef struct batchWorker{
+    // jobs left to this worker, from next up to end. Other workers steal
+    // from the end.
+    pthread_mutex_t lock;
+    unsigned int next;
+    unsigned int end;
+
+    struct batch *batch;
+    pthread_t thread;
+    unsigned short started;
+} BatchWorker;
+
+typedef struct batch{
+    BatchJob *jobs;
+    BatchWorker workers[BATCH_MAX_THREADS];
+    unsigned short workersInUse;
+} Batch;
+
+void runBatchJob(BatchJob *aJob){
+    unsigned long run;
+    for(run = 0; run < aJob->runs; run++){
+        runMatrix(aJob->matrix);
+        if(aJob->afterRun){
+            aJob->afterRun(aJob->matrix, run, aJob->context);
+        }
+    }
+}
+
+// Move the back half of the jobs another worker has left to aWorker, which
+// has none left. Returns 0 if no worker has jobs left.
+unsigned short stealBatchJobs(Batch *aBatch, BatchWorker *aWorker){
+    unsigned short i, self;
+    unsigned int first, end;
+    BatchWorker *victim;
+
+    self = aWorker - aBatch->workers;
+    for(i = 1; i < aBatch->workersInUse; i++){
+        victim = &aBatch->workers[(self + i) % aBatch->workersInUse];
+        pthread_mutex_lock(&victim->lock);
+        end = victim->end;
+        first = end - (end - victim->next + 1) / 2;
+        victim->end = first;
+        pthread_mutex_unlock(&victim->lock);
+
+        if(first < end){
+            pthread_mutex_lock(&aWorker->lock);
+            aWorker->next = first;
+            aWorker->end = end;
+            pthread_mutex_unlock(&aWorker->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Take the next job of a worker, stealing when it has none left. Returns 0
+// when all jobs are taken.
+BatchJob *takeBatchJob(Batch *aBatch, BatchWorker *aWorker){
+    BatchJob *aJob;
+    do {
+        aJob = 0;
+        pthread_mutex_lock(&aWorker->lock);
+        if(aWorker->next < aWorker->end){
+            aJob = &aBatch->jobs[aWorker->next];
+            aWorker->next++;
+        }
+        pthread_mutex_unlock(&aWorker->lock);
+        if(aJob){
+            return aJob;
+        }
+    } while(stealBatchJobs(aBatch, aWorker));
+    return 0;
+}
+
+void *runBatchWorker(void *argument){
+    BatchWorker *aWorker;
+    BatchJob *aJob;
+
+    aWorker = argument;
+    while((aJob = takeBatchJob(aWorker->batch, aWorker)) != 0){
+        runBatchJob(aJob);
+    }
+    return 0;
+}
+
+// Run all jobs on up to threads threads, the calling thread included, and
+// return once they are done. Threads that can not be started leave their jobs
+// to the others. Returns the number of threads that ran jobs.
+unsigned short runBatch(BatchJob *jobs, unsigned int jobCount, unsigned short threads){
+    Batch aBatch;
+    unsigned short i, started;
+    BatchWorker *aWorker;
+
+    if(threads > BATCH_MAX_THREADS){
+        threads = BATCH_MAX_THREADS;
+    }
+    if(threads > jobCount){
+        threads = jobCount;
+    }
+    if(threads == 0){
+        threads = 1;
+    }
+
+    aBatch.jobs = jobs;
+    aBatch.workersInUse = threads;
+    for(i = 0; i < threads; i++){
+        aWorker = &aBatch.workers[i];
+        pthread_mutex_init(&aWorker->lock, 0);
+        aWorker->next = (unsigned long)jobCount * i / threads;
+        aWorker->end = (unsigned long)jobCount * (i + 1) / threads;
+        aWorker->batch = &aBatch;
+        aWorker->started = 0;
+    }
+
+    started = 1;
+    for(i = 1; i < threads; i++){
+        aWorker = &aBatch.workers[i];
+        if(pthread_create(&aWorker->thread, 0, runBatchWorker, aWorker) == 0){
+            aWorker->started = 1;
+            started++;
+        }
+    }
+    runBatchWorker(&aBatch.workers[0]);
+
+    // workers still running may steal from any other worker, so the locks
+    // are only destroyed once all have stopped
+    for(i = 0; i < threads; i++){
+        if(aBatch.workers[i].started){
+            pthread_join(aBatch.workers[i].thread, 0);
+        }
+    }
+    for(i = 0; i < threads; i++){
+        pthread_mutex_destroy(&aBatch.workers[i].lock);
+    }
+    return started;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include "types.h"
+
+// most threads runBatch() uses
+#define BATCH_MAX_THREADS 64
+
+// called after every run of a batch job, e.g. to set the inputs of the next
+// run or collect the outputs
+typedef void (*batchRunFunction)(Matrix *aMatrix, unsigned long run, void *context);
+
+typedef struct batchJob{
+    // matrix with a valid patch, not shared with any other job
+    Matrix *matrix;
+
+    // number of times to run the matrix
+    unsigned long runs;
+
+    // called after every run with context, or 0
+    batchRunFunction afterRun;
+    void *context;
+} BatchJob;
+
+#ifdef TARGET_HOST
+unsigned short runBatch(BatchJob *jobs, unsigned int jobCount, unsigned short threads);
+#endif
+
+#endif
\ No newline at end of file
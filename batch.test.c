@@ -0,0 +1,129 @@
+#include "test/munit.h"
+#include "test/asserts.h"
+#include "types.h"
+#include "config.h"
+#include "matrix.h"
+#include "matrix.bench.h"
+#include "batch.h"
+
+// Runs on the host only, runBatch() is not built for the PIC.
+
+#define BATCH_TEST_JOBS 12
+#define BATCH_TEST_NODES 200
+#define BATCH_TEST_RUNS 50
+
+// the first job runs much longer than the rest, so the others are stolen
+// from the thread it was given to
+#define BATCH_TEST_LONG_RUNS 5000
+
+// what a job saw after its runs, to compare with running it alone
+typedef struct batchTestRun{
+    unsigned short job;
+    unsigned long runs;
+    long checksum;
+} BatchTestRun;
+
+Matrix batchMatrixes[BATCH_TEST_JOBS];
+Node batchNodes[BATCH_TEST_JOBS][MAX_OPERATIONS];
+matrixint batchOutputBuffers[BATCH_TEST_JOBS][MAX_SH_OUTPUTS];
+BatchTestRun batchRuns[BATCH_TEST_JOBS];
+BatchJob batchJobs[BATCH_TEST_JOBS];
+
+Matrix serialMatrixes[BATCH_TEST_JOBS];
+Node serialNodes[BATCH_TEST_JOBS][MAX_OPERATIONS];
+matrixint serialOutputBuffers[BATCH_TEST_JOBS][MAX_SH_OUTPUTS];
+BatchTestRun serialRuns[BATCH_TEST_JOBS];
+
+// sum up the outputs and set the inputs of the next run
+void batchTestAfterRun(Matrix *aMatrix, unsigned long run, void *context){
+    BatchTestRun *aRun;
+    unsigned short i;
+
+    aRun = context;
+    aRun->runs++;
+    for(i = 0; i<MAX_SH_OUTPUTS; i++){
+        aRun->checksum += aMatrix->outputBuffer[i] * (i + 1);
+    }
+    for(i = 0; i<MAX_INPUTS; i++){
+        aMatrix->inputBuffer[i] = (matrixint)(run * 7 + aRun->job * 13 + i * 31);
+    }
+}
+
+// the same random patch for each job in both sets of matrixes
+void resetBatchTest(){
+    unsigned short job;
+
+    benchSeed = 0xBA7C;
+    for(job = 0; job<BATCH_TEST_JOBS; job++){
+        generatePatch(1 + benchRandom() % BATCH_TEST_NODES, 1 + job % 8, job % 9);
+        copyBenchPatch(&batchMatrixes[job], batchNodes[job], batchOutputBuffers[job]);
+        copyBenchPatch(&serialMatrixes[job], serialNodes[job], serialOutputBuffers[job]);
+
+        batchRuns[job].job = job;
+        batchRuns[job].runs = 0;
+        batchRuns[job].checksum = 0;
+        serialRuns[job] = batchRuns[job];
+
+        batchJobs[job].matrix = &batchMatrixes[job];
+        batchJobs[job].runs = BATCH_TEST_RUNS;
+        batchJobs[job].afterRun = batchTestAfterRun;
+        batchJobs[job].context = &batchRuns[job];
+    }
+    batchJobs[0].runs = BATCH_TEST_LONG_RUNS;
+}
+
+// run the jobs one by one and check that the batch got the same
+void assertBatchMatchesSerial(unsigned int jobCount, char *message){
+    unsigned short job, i;
+    unsigned long run;
+    unsigned short same;
+
+    same = 1;
+    for(job = 0; job<jobCount; job++){
+        for(run = 0; run<batchJobs[job].runs; run++){
+            runMatrix(&serialMatrixes[job]);
+            batchTestAfterRun(&serialMatrixes[job], run, &serialRuns[job]);
+        }
+        if(batchRuns[job].runs != serialRuns[job].runs || batchRuns[job].checksum != serialRuns[job].checksum){
+            same = 0;
+        }
+        for(i = 0; i<batchMatrixes[job].nodesInUse; i++){
+            if(batchNodes[job][i].result != serialNodes[job][i].result){
+                same = 0;
+            }
+        }
+    }
+    assertEquals(1,same,message);
+}
+
+void testBatchMatchesSerial(){
+    assertEquals(4,runBatch(batchJobs, BATCH_TEST_JOBS, 4),"Batch threads");
+    assertBatchMatchesSerial(BATCH_TEST_JOBS, "Batch matches serial");
+}
+
+void testBatchSingleThread(){
+    assertEquals(1,runBatch(batchJobs, BATCH_TEST_JOBS, 1),"Batch single thread");
+    assertBatchMatchesSerial(BATCH_TEST_JOBS, "Batch single thread matches serial");
+}
+
+void testBatchMoreThreadsThanJobs(){
+    assertEquals(3,runBatch(batchJobs, 3, BATCH_MAX_THREADS + 1),"Batch thread per job");
+    assertBatchMatchesSerial(3, "Batch thread per job matches serial");
+    assertEquals(0,batchRuns[3].runs,"Batch leaves other jobs");
+}
+
+void testBatchEmpty(){
+    assertEquals(1,runBatch(batchJobs, 0, 4),"Batch without jobs");
+    assertEquals(0,batchRuns[0].runs,"Batch without jobs runs nothing");
+}
+
+// setup and run test suite
+void runBatchTests(){
+    reset();
+    resetBatchTest();
+    add(&testBatchMatchesSerial);
+    add(&testBatchSingleThread);
+    add(&testBatchMoreThreadsThanJobs);
+    add(&testBatchEmpty);
+    run(resetBatchTest);
+}
\ No newline at end of file
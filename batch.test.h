@@ -0,0 +1 @@
+extern void runBatchTests();
\ No newline at end of file
@@ -0,0 +1,649 @@
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "nodetypes.h"
+#include "matrix.h"
+#include "matrix.private.h"
+#include "codegen.h"
+
+// Ahead of time compiler turning a patch into straight line C. The emitted
+// runCompiledPatch() does the same as runMatrix() on the patch, without node
+// dispatch or param lookups: simple nodes are written out inline with their
+// constant params filled in, nodes with only constant inputs are calculated
+// while emitting and their state lives in static variables. Time based and
+// other complex nodes are still run through their node function on the Node
+// in the matrix, so the emitted code must run on a matrix holding the same
+// patch, after the same validatePatch(), fusePatch() and staggerNodeRates().
+
+// write a string to the sink
+void emitString(charSink sink, const char *text){
+    while(*text){
+        sink(*text);
+        text++;
+    }
+}
+
+// write a number in decimal
+void emitNumber(charSink sink, int number){
+    char digits[6];
+    unsigned short count;
+    unsigned int rest;
+
+    if(number < 0){
+        sink('-');
+        rest = -number;
+    } else {
+        rest = number;
+    }
+
+    count = 0;
+    do {
+        digits[count] = '0' + rest % 10;
+        rest = rest / 10;
+        count++;
+    } while(rest);
+
+    while(count){
+        count--;
+        sink(digits[count]);
+    }
+}
+
+// indent to a nesting level, four spaces per level
+void emitIndent(charSink sink, unsigned short level){
+    unsigned short i;
+    for(i = 0; i<level; i++){
+        emitString(sink, "    ");
+    }
+}
+
+// write a name followed by a node index, e.g. result3
+void emitName(charSink sink, const char *name, nodeindex index){
+    emitString(sink, name);
+    emitNumber(sink, index);
+}
+
+// write where the result of a node is kept
+void emitResult(charSink sink, unsigned short *flags, nodeindex index){
+    if(flags[index] & CODEGEN_IN_STRUCT){
+        emitName(sink, "aMatrix->nodes[", index);
+        emitString(sink, "]->result");
+    } else {
+        emitName(sink, "result", index);
+    }
+}
+
+// write a constant value, negative values in parentheses so they can follow
+// any operator.
+void emitConstant(charSink sink, matrixint value){
+    if(value < 0){
+        sink('(');
+        emitNumber(sink, value);
+        sink(')');
+    } else {
+        emitNumber(sink, value);
+    }
+}
+
+// write the value of a param as read by node index. Constants and results of
+// earlier folded nodes are written as numbers. Attenuations are written with
+// the depth they have when emitting.
+void emitParam(Matrix *aMatrix, charSink sink, unsigned short *flags, nodeindex index, paramindex paramId){
+    Node *aNode;
+    nodeindex source;
+
+    Attenuation *anAttenuation;
+
+    aNode = aMatrix->nodes[index];
+    source = getParamNode(aMatrix, aNode, paramId);
+    if(source == MAX_OPERATIONS || (source < index && (flags[source] & CODEGEN_FOLDED))){
+        emitConstant(sink, getParam(aMatrix, aNode, paramId));
+    } else if(isAttenuatedParam(aMatrix, aNode, paramId)){
+        anAttenuation = &aMatrix->attenuations[aMatrix->params[aNode->firstParam + paramId]];
+        emitString(sink, "attenuateValue(");
+        emitResult(sink, flags, source);
+        emitString(sink, ", ");
+        emitConstant(sink, anAttenuation->gain);
+        emitString(sink, ", ");
+        emitConstant(sink, anAttenuation->offset);
+        sink(')');
+    } else {
+        emitResult(sink, flags, source);
+    }
+}
+
+// write all params of a node with a separator in between
+void emitParamList(Matrix *aMatrix, charSink sink, unsigned short *flags, nodeindex index, const char *separator){
+    paramindex param;
+    for(param = 0; param < aMatrix->nodes[index]->paramsInUse; param++){
+        if(param){
+            emitString(sink, separator);
+        }
+        emitParam(aMatrix, sink, flags, index, param);
+    }
+}
+
+// write "<result> = " for a node
+void emitAssign(charSink sink, unsigned short *flags, nodeindex index){
+    emitResult(sink, flags, index);
+    emitString(sink, " = ");
+}
+
+// write a trigger that fires once when condition is true, see nodeFuncTrigger.
+// The condition has already been written as "if(<condition>".
+void emitTriggerBody(charSink sink, unsigned short *flags, nodeindex index, unsigned short level){
+    emitString(sink, "){\r\n");
+    emitIndent(sink, level + 1);
+    emitName(sink, "if(state", index);
+    emitString(sink, " == 0){\r\n");
+    emitIndent(sink, level + 2);
+    emitAssign(sink, flags, index);
+    emitString(sink, "MAX_POSITIVE;\r\n");
+    emitIndent(sink, level + 2);
+    emitName(sink, "state", index);
+    emitString(sink, " = MAX_POSITIVE;\r\n");
+    emitIndent(sink, level + 1);
+    emitString(sink, "} else {\r\n");
+    emitIndent(sink, level + 2);
+    emitAssign(sink, flags, index);
+    emitString(sink, "0;\r\n");
+    emitIndent(sink, level + 1);
+    emitString(sink, "}\r\n");
+    emitIndent(sink, level);
+    emitString(sink, "} else {\r\n");
+    emitIndent(sink, level + 1);
+    emitName(sink, "state", index);
+    emitString(sink, " = 0;\r\n");
+    emitIndent(sink, level);
+    emitString(sink, "}\r\n");
+}
+
+// Returns the number of params the inline code for a node type reads, or
+// NODE_TYPES if the type has no inline code and must run through its node
+// function.
+unsigned short getInlineParams(unsigned short type){
+    switch(type){
+        case NODE_SUM:
+        case NODE_MAX:
+        case NODE_MIN:
+        case NODE_BINARY_AND:
+        case NODE_BINARY_OR:
+            return 0;
+        case NODE_MULTIPLY:
+        case NODE_INVERT:
+        case NODE_INVERT_EACH_SIDE:
+        case NODE_DELAY_LINE:
+        case NODE_TRIGGER:
+        case NODE_BINARY_NOT:
+        case NODE_INPUT:
+            return 1;
+        case NODE_SWITCH:
+        case NODE_COMPARE:
+        case NODE_SCALE:
+        case NODE_BINARY_XOR:
+        case NODE_OUTPUT:
+        case NODE_GATE_OUTPUT:
+        case NODE_FUSED_COMPARE_TRIGGER:
+            return 2;
+        case NODE_MEMORY:
+        case NODE_TRIGGER_OUTPUT:
+        case NODE_FUSED_INPUT_SCALE_OUTPUT:
+        case NODE_FUSED_INPUT_OFFSET_SCALE:
+            return 3;
+    }
+    return NODE_TYPES;
+}
+
+// returns 1 if the result of a node type only depends on its params
+unsigned short isPureNode(unsigned short type){
+    switch(type){
+        case NODE_SUM:
+        case NODE_MULTIPLY:
+        case NODE_INVERT:
+        case NODE_INVERT_EACH_SIDE:
+        case NODE_DELAY_LINE:
+        case NODE_SWITCH:
+        case NODE_COMPARE:
+        case NODE_MAX:
+        case NODE_MIN:
+        case NODE_SCALE:
+        case NODE_BINARY_AND:
+        case NODE_BINARY_OR:
+        case NODE_BINARY_XOR:
+        case NODE_BINARY_NOT:
+            return 1;
+    }
+    return 0;
+}
+
+// returns 1 if a node type keeps state between runs in Node.state
+unsigned short usesState(unsigned short type){
+    return type == NODE_TRIGGER || type == NODE_TRIGGER_OUTPUT || type == NODE_FUSED_COMPARE_TRIGGER;
+}
+
+// returns 1 if a node type writes a result
+unsigned short writesResult(unsigned short type){
+    return type != NODE_OUTPUT && type != NODE_GATE_OUTPUT && type != NODE_TRIGGER_OUTPUT &&
+           type != NODE_FUSED_INPUT_SCALE_OUTPUT;
+}
+
+// Returns 1 if a node can be written out inline. Nodes reading their own
+// result can not, as the inline code would read the new result instead of the
+// one the node function starts from.
+unsigned short isInlineNode(Matrix *aMatrix, nodeindex index){
+    Node *aNode;
+    paramindex param;
+    unsigned short required;
+
+    aNode = aMatrix->nodes[index];
+    required = getInlineParams(getFunctionType(aNode->func));
+    if(required == NODE_TYPES || aNode->paramsInUse < required){
+        return 0;
+    }
+    for(param = 0; param < aNode->paramsInUse; param++){
+        if(getParamNode(aMatrix, aNode, param) == index){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// returns 1 if all params of a node are constants or folded earlier nodes
+unsigned short hasConstantParams(Matrix *aMatrix, unsigned short *flags, nodeindex index){
+    Node *aNode;
+    paramindex param;
+    nodeindex source;
+
+    aNode = aMatrix->nodes[index];
+    for(param = 0; param < aNode->paramsInUse; param++){
+        source = getParamNode(aMatrix, aNode, param);
+        if(source != MAX_OPERATIONS && (source >= index || !(flags[source] & CODEGEN_FOLDED))){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// write the code of a single node run
+void emitNodeBody(Matrix *aMatrix, charSink sink, unsigned short *flags, nodeindex index, unsigned short level){
+    Node *aNode;
+    unsigned short type;
+    paramindex param;
+
+    aNode = aMatrix->nodes[index];
+    type = getFunctionType(aNode->func);
+
+    if(flags[index] & CODEGEN_FALLBACK){
+        emitIndent(sink, level);
+        emitName(sink, "aMatrix->nodes[", index);
+        emitName(sink, "]->func(aMatrix, aMatrix->nodes[", index);
+        emitString(sink, "]);\r\n");
+        return;
+    }
+
+    if(flags[index] & CODEGEN_FOLDED){
+        emitIndent(sink, level);
+        emitAssign(sink, flags, index);
+        emitConstant(sink, aNode->result);
+        emitString(sink, ";\r\n");
+        return;
+    }
+
+    emitIndent(sink, level);
+    switch(type){
+        case NODE_SUM:
+            emitAssign(sink, flags, index);
+            if(aNode->paramsInUse == 0){
+                emitString(sink, "0");
+            }
+            emitParamList(aMatrix, sink, flags, index, " + ");
+            emitString(sink, ";\r\n");
+            break;
+        case NODE_MULTIPLY:
+            emitAssign(sink, flags, index);
+            emitParamList(aMatrix, sink, flags, index, " * ");
+            emitString(sink, ";\r\n");
+            break;
+        case NODE_INVERT:
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " == MAX_NEGATIVE ? MAX_POSITIVE : -");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ";\r\n");
+            break;
+        case NODE_INVERT_EACH_SIDE:
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " >= 0 ? MAX_POSITIVE - ");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " : MAX_NEGATIVE - 1 - ");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ";\r\n");
+            break;
+        case NODE_DELAY_LINE:
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ";\r\n");
+            break;
+        case NODE_MEMORY:
+            emitString(sink, "if(");
+            emitParam(aMatrix, sink, flags, index, 2);
+            emitString(sink, "){\r\n");
+            emitIndent(sink, level + 1);
+            emitAssign(sink, flags, index);
+            emitString(sink, "0;\r\n");
+            emitIndent(sink, level);
+            emitString(sink, "} else if(");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, "){\r\n");
+            emitIndent(sink, level + 1);
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ";\r\n");
+            emitIndent(sink, level);
+            emitString(sink, "}\r\n");
+            break;
+        case NODE_SWITCH:
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, " ? ");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " : 0;\r\n");
+            break;
+        case NODE_COMPARE:
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " > ");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, " ? BINARY_TRUE : BINARY_FALSE;\r\n");
+            break;
+        case NODE_MAX:
+        case NODE_MIN:
+            emitAssign(sink, flags, index);
+            if(aNode->paramsInUse == 0){
+                emitString(sink, type == NODE_MAX ? "MAX_NEGATIVE;\r\n" : "MAX_POSITIVE;\r\n");
+                break;
+            }
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ";\r\n");
+            for(param = 1; param < aNode->paramsInUse; param++){
+                emitIndent(sink, level);
+                emitString(sink, "if(");
+                emitParam(aMatrix, sink, flags, index, param);
+                emitString(sink, type == NODE_MAX ? " > " : " < ");
+                emitResult(sink, flags, index);
+                emitString(sink, "){\r\n");
+                emitIndent(sink, level + 1);
+                emitAssign(sink, flags, index);
+                emitParam(aMatrix, sink, flags, index, param);
+                emitString(sink, ";\r\n");
+                emitIndent(sink, level);
+                emitString(sink, "}\r\n");
+            }
+            break;
+        case NODE_SCALE:
+            emitAssign(sink, flags, index);
+            emitString(sink, "scaleValues(");
+            emitParamList(aMatrix, sink, flags, index, ", ");
+            emitString(sink, ");\r\n");
+            break;
+        case NODE_TRIGGER:
+            emitString(sink, "if(");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " > 0");
+            emitTriggerBody(sink, flags, index, level);
+            break;
+        case NODE_BINARY_AND:
+        case NODE_BINARY_OR:
+            emitAssign(sink, flags, index);
+            if(aNode->paramsInUse == 0){
+                emitString(sink, type == NODE_BINARY_AND ? "BINARY_TRUE;\r\n" : "BINARY_FALSE;\r\n");
+                break;
+            }
+            for(param = 0; param < aNode->paramsInUse; param++){
+                if(param){
+                    emitString(sink, type == NODE_BINARY_AND ? " && " : " || ");
+                }
+                emitParam(aMatrix, sink, flags, index, param);
+                emitString(sink, " > 0");
+            }
+            emitString(sink, " ? BINARY_TRUE : BINARY_FALSE;\r\n");
+            break;
+        case NODE_BINARY_XOR:
+            emitAssign(sink, flags, index);
+            emitString(sink, "(");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " > 0) != (");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, " > 0) ? BINARY_TRUE : BINARY_FALSE;\r\n");
+            break;
+        case NODE_BINARY_NOT:
+            emitAssign(sink, flags, index);
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " > 0 ? BINARY_FALSE : BINARY_TRUE;\r\n");
+            break;
+        case NODE_INPUT:
+            emitAssign(sink, flags, index);
+            emitString(sink, "aMatrix->inputBuffer[");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, "];\r\n");
+            break;
+        case NODE_OUTPUT:
+            emitString(sink, "aMatrix->outputBuffer[");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, "] = ");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, ";\r\n");
+            break;
+        case NODE_GATE_OUTPUT:
+            emitString(sink, "if(");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, " > 0){\r\n");
+            emitIndent(sink, level + 1);
+            emitString(sink, "aMatrix->gateBuffer |= 1 << ");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ";\r\n");
+            emitIndent(sink, level);
+            emitString(sink, "} else {\r\n");
+            emitIndent(sink, level + 1);
+            emitString(sink, "aMatrix->gateBuffer &= ~(1 << ");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, ");\r\n");
+            emitIndent(sink, level);
+            emitString(sink, "}\r\n");
+            break;
+        case NODE_TRIGGER_OUTPUT:
+            emitString(sink, "if(");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, " > 0){\r\n");
+            emitIndent(sink, level + 1);
+            emitName(sink, "if(state", index);
+            emitString(sink, " == 0){\r\n");
+            emitIndent(sink, level + 2);
+            emitString(sink, "aMatrix->triggerCountdown[");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, "] = ");
+            emitParam(aMatrix, sink, flags, index, 2);
+            emitString(sink, ";\r\n");
+            emitIndent(sink, level + 2);
+            emitName(sink, "state", index);
+            emitString(sink, " = MAX_POSITIVE;\r\n");
+            emitIndent(sink, level + 1);
+            emitString(sink, "}\r\n");
+            emitIndent(sink, level);
+            emitString(sink, "} else {\r\n");
+            emitIndent(sink, level + 1);
+            emitName(sink, "state", index);
+            emitString(sink, " = 0;\r\n");
+            emitIndent(sink, level);
+            emitString(sink, "}\r\n");
+            break;
+        case NODE_FUSED_INPUT_SCALE_OUTPUT:
+            emitString(sink, "aMatrix->outputBuffer[");
+            emitParam(aMatrix, sink, flags, index, 2);
+            emitString(sink, "] = scaleValues(aMatrix->inputBuffer[");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, "], ");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, ");\r\n");
+            break;
+        case NODE_FUSED_INPUT_OFFSET_SCALE:
+            emitAssign(sink, flags, index);
+            emitString(sink, "scaleValues(aMatrix->inputBuffer[");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, "] + ");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitString(sink, ", ");
+            emitParam(aMatrix, sink, flags, index, 2);
+            emitString(sink, ");\r\n");
+            break;
+        case NODE_FUSED_COMPARE_TRIGGER:
+            emitString(sink, "if(");
+            emitParam(aMatrix, sink, flags, index, 0);
+            emitString(sink, " > ");
+            emitParam(aMatrix, sink, flags, index, 1);
+            emitTriggerBody(sink, flags, index, level);
+            break;
+    }
+}
+
+// write a node, run every 2^rateShift matrix runs like in runMatrix()
+void emitNode(Matrix *aMatrix, charSink sink, unsigned short *flags, nodeindex index){
+    Node *aNode;
+    aNode = aMatrix->nodes[index];
+
+    emitIndent(sink, 1);
+    emitName(sink, "// node ", index);
+    emitString(sink, "\r\n");
+
+    if(aNode->rateShift == 0 && aNode->rateCountdown == 0){
+        emitNodeBody(aMatrix, sink, flags, index, 1);
+        return;
+    }
+
+    emitIndent(sink, 1);
+    emitName(sink, "if(countdown", index);
+    emitString(sink, "){\r\n");
+    emitIndent(sink, 2);
+    emitName(sink, "countdown", index);
+    emitString(sink, "--;\r\n");
+    emitIndent(sink, 1);
+    emitString(sink, "} else {\r\n");
+    emitNodeBody(aMatrix, sink, flags, index, 2);
+    emitIndent(sink, 2);
+    emitName(sink, "countdown", index);
+    emitString(sink, " = ");
+    emitNumber(sink, (1 << aNode->rateShift) - 1);
+    emitString(sink, ";\r\n");
+    emitIndent(sink, 1);
+    emitString(sink, "}\r\n");
+}
+
+// write a static variable for a node, e.g. "static short state3 = 0;"
+void emitStatic(charSink sink, const char *type, const char *name, nodeindex index, int value){
+    emitString(sink, "static ");
+    emitString(sink, type);
+    emitString(sink, " ");
+    emitName(sink, name, index);
+    emitString(sink, " = ");
+    emitNumber(sink, value);
+    emitString(sink, ";\r\n");
+}
+
+// Write a validated patch as a C file defining runCompiledPatch(). The
+// results and state the nodes have now become the initial values of the
+// compiled patch, the patch is only checked so a running patch keeps its
+// state. Returns PATCH_OK or the error found by checkPatch().
+unsigned short emitPatch(Matrix *aMatrix, charSink sink){
+    unsigned short flags[MAX_OPERATIONS];
+    matrixint initialResult[MAX_OPERATIONS];
+    unsigned short status, type;
+    nodeindex i, source;
+    paramindex param;
+    Node *aNode;
+
+    status = checkPatch(aMatrix);
+    if(status != PATCH_OK){
+        return status;
+    }
+
+    // find out which nodes can be written out inline and where results are
+    // read.
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        flags[i] = 0;
+        initialResult[i] = aMatrix->nodes[i]->result;
+    }
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        if(!isInlineNode(aMatrix, i)){
+            flags[i] |= CODEGEN_FALLBACK | CODEGEN_IN_STRUCT;
+        }
+        for(param = 0; param < aNode->paramsInUse; param++){
+            source = getParamNode(aMatrix, aNode, param);
+            if(source == MAX_OPERATIONS){
+                continue;
+            }
+            flags[source] |= CODEGEN_READ;
+            if(source >= i){
+                flags[source] |= CODEGEN_LATE_READ;
+            }
+            // node functions read results from the Node
+            if(flags[i] & CODEGEN_FALLBACK){
+                flags[source] |= CODEGEN_IN_STRUCT;
+            }
+        }
+    }
+
+    // calculate nodes that only depend on constants. Readers later in the
+    // patch get the result as a constant, the node itself is only kept if
+    // its result is read before it runs or from the Node.
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        if(!(flags[i] & CODEGEN_FALLBACK) && isPureNode(getFunctionType(aNode->func)) &&
+           aNode->rateShift == 0 && aNode->rateCountdown == 0 && hasConstantParams(aMatrix, flags, i)){
+            aNode->func(aMatrix, aNode);
+            flags[i] |= CODEGEN_FOLDED;
+        }
+        if(!(flags[i] & CODEGEN_FOLDED) || (flags[i] & (CODEGEN_LATE_READ | CODEGEN_IN_STRUCT))){
+            flags[i] |= CODEGEN_EMITTED;
+        }
+    }
+
+    emitString(sink, "// generated by emitPatch(), changes are lost when the patch is compiled again\r\n");
+    emitString(sink, "#include \"types.h\"\r\n");
+    emitString(sink, "#include \"definitions.h\"\r\n");
+    emitString(sink, "#include \"matrix.private.h\"\r\n\r\n");
+
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        if(!(flags[i] & CODEGEN_EMITTED)){
+            continue;
+        }
+        type = getFunctionType(aNode->func);
+        if(!(flags[i] & CODEGEN_IN_STRUCT) && (writesResult(type) || (flags[i] & CODEGEN_READ))){
+            emitStatic(sink, "matrixint", "result", i, initialResult[i]);
+        }
+        if(!(flags[i] & CODEGEN_FALLBACK) && usesState(type)){
+            emitStatic(sink, "short", "state", i, aNode->state);
+        }
+        if(aNode->rateShift || aNode->rateCountdown){
+            emitStatic(sink, "unsigned short", "countdown", i, aNode->rateCountdown);
+        }
+    }
+
+    emitString(sink, "\r\nvoid runCompiledPatch(Matrix *aMatrix){\r\n");
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        if(flags[i] & CODEGEN_EMITTED){
+            emitNode(aMatrix, sink, flags, i);
+        }
+    }
+    emitIndent(sink, 1);
+    emitString(sink, "aMatrix->matrixCalculationCompleted = 1;\r\n");
+    emitString(sink, "}\r\n");
+
+    // folding ran the node functions, put the results back
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aMatrix->nodes[i]->result = initialResult[i];
+    }
+    return PATCH_OK;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef _CODEGEN_H
+#define _CODEGEN_H
+
+#include "types.h"
+
+// per node flags used while emitting a patch
+#define CODEGEN_IN_STRUCT 0x01   // result is kept in the Node, not in a static
+#define CODEGEN_FALLBACK 0x02    // node is run through its node function
+#define CODEGEN_READ 0x04        // result is read by another node
+#define CODEGEN_LATE_READ 0x08   // result is read by the node itself or an earlier node
+#define CODEGEN_FOLDED 0x10      // result is constant and known when emitting
+#define CODEGEN_EMITTED 0x20     // node has code in the compiled patch
+
+unsigned short emitPatch(Matrix *aMatrix, charSink sink);
+
+// defined by the emitted patch
+extern void runCompiledPatch(Matrix *aMatrix);
+
+#endif
\ No newline at end of file
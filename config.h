@@ -1,7 +1,120 @@
-#ifndef _CONFIG_H
-#define _CONFIG_H
-
-#define MAX_OPERATIONS 20
-#define MAX_SH_OUTPUTS 8
-
+#ifndef _CONFIG_H
+#define _CONFIG_H
+
+#ifdef TARGET_HOST
+#include "host.h"
+#endif
+
+// Capacities of the matrix and outputs. Select the target by defining one of
+// TARGET_LARGE_MCU or TARGET_HOST in the project settings (default is the small
+// PIC), or override single values the same way. Sizes are checked against the
+// RAM budget at compile time, see matrix.c and output.c.
+#if defined(TARGET_HOST)
+    #define DEFAULT_MAX_OPERATIONS 1000
+    #define DEFAULT_MAX_OPERANDS 4000
+    #define DEFAULT_MAX_SH_OUTPUTS 64
+    #define DEFAULT_MAX_INPUTS 64
+    #define DEFAULT_MATRIX_RAM_BUDGET 262144
+    #define DEFAULT_MAX_ATTENUATIONS 1000
+    #define DEFAULT_DELAY_ARENA_SIZE 4096
+    #define DEFAULT_TRACE_BLOCKS 64
+    #define DEFAULT_EEPROM_SIZE 4096
+#elif defined(TARGET_LARGE_MCU)
+    #define DEFAULT_MAX_OPERATIONS 300
+    #define DEFAULT_MAX_OPERANDS 900
+    #define DEFAULT_MAX_SH_OUTPUTS 64
+    #define DEFAULT_MAX_INPUTS 32
+    #define DEFAULT_MATRIX_RAM_BUDGET 12000
+    #define DEFAULT_MAX_ATTENUATIONS 128
+    #define DEFAULT_DELAY_ARENA_SIZE 1024
+    #define DEFAULT_TRACE_BLOCKS 16
+    #define DEFAULT_EEPROM_SIZE 1024
+#else
+    #define DEFAULT_MAX_OPERATIONS 20
+    #define DEFAULT_MAX_OPERANDS 64
+    #define DEFAULT_MAX_SH_OUTPUTS 8
+    #define DEFAULT_MAX_INPUTS 8
+    #define DEFAULT_MATRIX_RAM_BUDGET 1024
+    #define DEFAULT_MAX_ATTENUATIONS 16
+    #define DEFAULT_DELAY_ARENA_SIZE 64
+    #define DEFAULT_TRACE_BLOCKS 4
+    #define DEFAULT_EEPROM_SIZE 256
+#endif
+
+#ifndef MAX_OPERATIONS
+#define MAX_OPERATIONS DEFAULT_MAX_OPERATIONS
+#endif
+
+#ifndef MAX_OPERANDS
+#define MAX_OPERANDS DEFAULT_MAX_OPERANDS
+#endif
+
+#ifndef MAX_SH_OUTPUTS
+#define MAX_SH_OUTPUTS DEFAULT_MAX_SH_OUTPUTS
+#endif
+
+#ifndef MAX_INPUTS
+#define MAX_INPUTS DEFAULT_MAX_INPUTS
+#endif
+
+// params with a depth and offset, see attenuateParam()
+#ifndef MAX_ATTENUATIONS
+#define MAX_ATTENUATIONS DEFAULT_MAX_ATTENUATIONS
+#endif
+
+// samples shared by all delay buffer nodes, see allocateDelay()
+#ifndef DELAY_ARENA_SIZE
+#define DELAY_ARENA_SIZE DEFAULT_DELAY_ARENA_SIZE
+#endif
+
+// steps in a sequencer pattern, patterns are kept in flash, see patterns.c
+#ifndef SEQUENCER_MAX_STEPS
+#define SEQUENCER_MAX_STEPS 16
+#endif
+
+// bytes of data EEPROM, holds the output calibration
+#ifndef EEPROM_SIZE
+#define EEPROM_SIZE DEFAULT_EEPROM_SIZE
+#endif
+
+// gate outputs share a single 8 bit port
+#ifndef MAX_GATE_OUTPUTS
+#define MAX_GATE_OUTPUTS 8
+#endif
+
+// Node results recorded by the trace recorder, see trace.c. The trace is kept
+// in TRACE_BLOCKS blocks of TRACE_BLOCK_BYTES, the oldest block is dropped
+// when they are full.
+#ifndef TRACE_CHANNELS
+#define TRACE_CHANNELS 4
+#endif
+
+#ifndef TRACE_BLOCK_BYTES
+#define TRACE_BLOCK_BYTES 32
+#endif
+
+#ifndef TRACE_BLOCKS
+#define TRACE_BLOCKS DEFAULT_TRACE_BLOCKS
+#endif
+
+// Run the patch a slice of this many nodes at a time, so patches that take
+// longer than one S&H rotation update at a lower but steady rate instead of
+// missing dac cycles. 0 runs the whole patch at once. See runMatrixSlice().
+#ifndef MATRIX_SLICE_NODES
+#define MATRIX_SLICE_NODES 0
+#endif
+
+// Resolve every operand to a pointer to the value it reads when the patch is
+// linked, so reading a param is a single load instead of a flag test and a
+// node lookup. Costs a pointer and a byte per operand, so it is only on by
+// default on the host. See linkPatch().
+#if defined(TARGET_HOST) && !defined(MATRIX_NO_LINKED_OPERANDS)
+#define MATRIX_LINKED_OPERANDS
+#endif
+
+// number of bytes of RAM that nodes, operands and buffers may use in total
+#ifndef MATRIX_RAM_BUDGET
+#define MATRIX_RAM_BUDGET DEFAULT_MATRIX_RAM_BUDGET
+#endif
+
 #endif
\ No newline at end of file
@@ -1,18 +1,83 @@
-#ifndef _DEFINITIONS_H
-#define _DEFINITIONS_H
-
-// binary values. Anything from 0 and down is treated as false
-#define BINARY_TRUE 127
-#define BINARY_FALSE 0
-
-// ranges
-#define MAX_POSITIVE 127
-#define MAX_NEGATIVE -128
-
-// ramp etc
-#define UP 1
-#define DOWN 0
-#define RUNNING 1
-#define STOPPED 0
-
+#ifndef _DEFINITIONS_H
+#define _DEFINITIONS_H
+
+// binary values. Anything from 0 and down is treated as false
+#define BINARY_TRUE 127
+#define BINARY_FALSE 0
+
+// ranges
+#define MAX_POSITIVE 127
+#define MAX_NEGATIVE -128
+
+// longest delay buffer node, the length is set by an 8 bit constant
+#define DELAY_MAX_LENGTH 256
+
+// sequencer directions, param 2 of the sequencer node
+#define SEQUENCER_FORWARD 0
+#define SEQUENCER_BACKWARD 1
+#define SEQUENCER_PINGPONG 2
+#define SEQUENCER_RANDOM 3
+#define SEQUENCER_DIRECTIONS 4
+
+// sequencer step before the first trigger or after a reset
+#define SEQUENCER_NOT_STARTED -1
+
+// sequencer state flags
+#define SEQUENCER_TRIGGER_HIGH 0x01
+#define SEQUENCER_RESET_HIGH 0x02
+#define SEQUENCER_BACKWARDS 0x04
+#define SEQUENCER_GATE 0x08
+
+// start value of the random source of a matrix, see matrixRandom()
+#define MATRIX_RANDOM_SEED 0xACE1
+
+// number of entries in the reciprocal table, see divideMagnitude()
+#define RECIPROCAL_TABLE_SIZE 256
+
+// ramp etc
+#define UP 1
+#define DOWN 0
+#define RUNNING 1
+#define STOPPED 0
+
+// slew/glide modes
+#define SLEW_LINEAR 0
+#define SLEW_EXPONENTIAL 1
+#define SLEW_CONSTANT_TIME 2
+
+// extra bits of precision kept below the LSB by the slew node
+#define SLEW_FRACTION_BITS 7
+#define SLEW_ROUNDING 64
+
+// slowest rate a node can run at, every 2^MAX_RATE_SHIFT matrix runs
+#define MAX_RATE_SHIFT 7
+
+// time scale of a matrix run, TIME_SCALE_NOMINAL means the run lasted the
+// nominal time that time based nodes are tuned for.
+#define TIME_SCALE_SHIFT 8
+#define TIME_SCALE_NOMINAL 256
+
+// result of patch validation
+#define PATCH_OK 0
+#define PATCH_TOO_MANY_NODES 1
+#define PATCH_TOO_MANY_PARAMS 2
+#define PATCH_INVALID_NODE_INDEX 3
+#define PATCH_INVALID_INPUT 4
+#define PATCH_INVALID_OUTPUT 5
+#define PATCH_MISSING_PARAMS 6
+#define PATCH_INVALID_ROUTING 7
+#define PATCH_INVALID_DELAY 8
+#define PATCH_DELAY_ARENA_FULL 9
+#define PATCH_INVALID_SEQUENCER 10
+
+// patchLinked of a linked patch, without and with attenuated params
+#define PATCH_LINKED 1
+#define PATCH_LINKED_ATTENUATED 2
+
+// most params of a node created by fusePatch()
+#define FUSED_MAX_PARAMS 3
+
+// compile time check, fails with a negative array size if condition is false
+#define STATIC_ASSERT(condition, name) typedef char static_assert_##name[(condition) ? 1 : -1]
+
 #endif
\ No newline at end of file
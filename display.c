@@ -0,0 +1,182 @@
+#include "config.h"
+#include "display.h"
+
+// Character lcd driven from a framebuffer. Text is written to the buffer,
+// which only marks changed characters, and displayStep() sends at most one
+// byte to the lcd per call without waiting for it. The HD44780 needs about
+// 40us to take a byte, so displayStep() must not be called more often than
+// that, e.g. once per dac tick.
+
+// The lcd pins are only there on the PIC, the host build writes to the lcd
+// in test/host.c instead.
+#ifndef TARGET_HOST
+// lcd pins, connected to the lcd library in OMM.c
+extern sfr sbit LCD_RS;
+extern sfr sbit LCD_EN;
+extern sfr sbit LCD_D4;
+extern sfr sbit LCD_D5;
+extern sfr sbit LCD_D6;
+extern sfr sbit LCD_D7;
+#endif
+
+// lcd command setting the address of the next character
+#define DISPLAY_SET_ADDRESS 0x80
+
+// cursor position is unknown, the address must be set before writing
+#define DISPLAY_NO_CURSOR 0xFF
+
+// characters that should be on the lcd
+char displayBuffer[DISPLAY_ROWS][DISPLAY_COLUMNS];
+
+// one bit per character that differs from what the lcd shows
+unsigned int displayDirty[DISPLAY_ROWS];
+
+// state of the update, the character being written and its bit in displayDirty
+unsigned short displayState;
+unsigned short displayRow;
+unsigned short displayColumn;
+unsigned int displayMask;
+
+// address the lcd writes the next character to, it moves on by itself after
+// every character.
+unsigned short displayCursor;
+
+// lcd address of the first character of each row
+const unsigned short displayRowAddress[DISPLAY_ROWS] = {0x00, 0x40};
+
+#ifndef TARGET_HOST
+// send a command or a character to the lcd in 4 bit mode, without waiting
+// for the lcd to execute it.
+void displayWrite(unsigned short value, unsigned short isData){
+    LCD_RS = isData;
+
+    LCD_D4 = value.B4;
+    LCD_D5 = value.B5;
+    LCD_D6 = value.B6;
+    LCD_D7 = value.B7;
+    LCD_EN = 1;
+    Delay_us(1);
+    LCD_EN = 0;
+
+    LCD_D4 = value.B0;
+    LCD_D5 = value.B1;
+    LCD_D6 = value.B2;
+    LCD_D7 = value.B3;
+    LCD_EN = 1;
+    Delay_us(1);
+    LCD_EN = 0;
+}
+#endif
+
+// start from a cleared lcd, run after Lcd_Init() and _LCD_CLEAR
+void displayInit(){
+    unsigned short row, column;
+    for(row = 0; row < DISPLAY_ROWS; row++){
+        for(column = 0; column < DISPLAY_COLUMNS; column++){
+            displayBuffer[row][column] = ' ';
+        }
+        displayDirty[row] = 0;
+    }
+    displayState = DISPLAY_FIND;
+    displayCursor = DISPLAY_NO_CURSOR;
+}
+
+// put a character in the framebuffer, row and column start at 1 like the lcd
+// library.
+void displayChar(unsigned short row, unsigned short column, char character){
+    row--;
+    column--;
+    if(row >= DISPLAY_ROWS || column >= DISPLAY_COLUMNS){
+        return;
+    }
+    if(displayBuffer[row][column] != character){
+        displayBuffer[row][column] = character;
+        displayDirty[row] |= 1 << column;
+    }
+}
+
+// put a string in the framebuffer, cut off at the end of the row
+void displayText(unsigned short row, unsigned short column, char *text){
+    while(*text){
+        displayChar(row, column, *text);
+        column++;
+        text++;
+    }
+}
+
+// put a signed number in the framebuffer as sign and three digits
+void displaySignedShort(unsigned short row, unsigned short column, short value){
+    unsigned short inExpanded;
+    if(value < 0){
+        displayChar(row, column, '-');
+        inExpanded = -value;
+    } else {
+        displayChar(row, column, ' ');
+        inExpanded = value;
+    }
+
+    displayChar(row, column+3, 48 + inExpanded % 10);
+    displayChar(row, column+2, 48 + (inExpanded / 10) % 10);
+    displayChar(row, column+1, 48 + (inExpanded / 100) % 10);
+}
+
+// find the first changed character, returns 0 if the lcd is up to date
+unsigned short displayFindDirty(){
+    unsigned short row, column;
+    unsigned int mask;
+
+    for(row = 0; row < DISPLAY_ROWS; row++){
+        if(displayDirty[row]){
+            mask = 1;
+            column = 0;
+            while(!(displayDirty[row] & mask)){
+                mask = mask << 1;
+                column++;
+            }
+            displayRow = row;
+            displayColumn = column;
+            displayMask = mask;
+            if(displayRowAddress[row] + column == displayCursor){
+                displayState = DISPLAY_DATA;
+            } else {
+                displayState = DISPLAY_ADDRESS;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Move the lcd one step closer to the framebuffer: set the address of the next
+// changed character or write it. Takes a few microseconds.
+void displayStep(){
+    if(displayState == DISPLAY_FIND){
+        if(!displayFindDirty()){
+            return;
+        }
+    }
+
+    if(displayState == DISPLAY_ADDRESS){
+        displayCursor = displayRowAddress[displayRow] + displayColumn;
+        displayWrite(DISPLAY_SET_ADDRESS | displayCursor, 0);
+        displayState = DISPLAY_DATA;
+        return;
+    }
+
+    displayDirty[displayRow] &= ~displayMask;
+    displayWrite(displayBuffer[displayRow][displayColumn], 1);
+    displayCursor++;
+    displayState = DISPLAY_FIND;
+}
+
+// write the whole framebuffer to the lcd, waiting for it. Only for use before
+// the dacs are running.
+void displayFlush(){
+    unsigned short row;
+    for(row = 0; row < DISPLAY_ROWS; row++){
+        while(displayDirty[row] || displayState != DISPLAY_FIND){
+            displayStep();
+            Delay_us(50);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef _DISPLAY_H
+#define _DISPLAY_H
+
+// size of the character lcd
+#define DISPLAY_ROWS 2
+#define DISPLAY_COLUMNS 16
+
+// states of the lcd update state machine
+#define DISPLAY_FIND 0
+#define DISPLAY_ADDRESS 1
+#define DISPLAY_DATA 2
+
+void displayInit();
+void displayChar(unsigned short row, unsigned short column, char character);
+void displayText(unsigned short row, unsigned short column, char *text);
+void displaySignedShort(unsigned short row, unsigned short column, short value);
+void displayStep();
+void displayFlush();
+
+#endif
\ No newline at end of file
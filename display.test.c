@@ -0,0 +1,135 @@
+#include "test/munit.h"
+#include "test/asserts.h"
+#include "config.h"
+#include "display.h"
+
+// Runs on the host only, checks what is sent to the lcd in test/host.c.
+
+// start each test with a cleared lcd and framebuffer
+void resetDisplayTest(){
+    unsigned short i;
+    for(i=0; i<HOST_LCD_SIZE; i++){
+        hostLcd[i] = ' ';
+    }
+    displayInit();
+    hostLcdWrites = 0;
+}
+
+// the characters of a row on the lcd
+unsigned short lcdRowEquals(unsigned short address, char *text){
+    while(*text){
+        if(hostLcd[address] != *text){
+            return 0;
+        }
+        address++;
+        text++;
+    }
+    return 1;
+}
+
+void testDisplayText(){
+    displayText(1,1,"Patch");
+    displayText(2,3,"ok");
+    displayFlush();
+    assertEquals(1,lcdRowEquals(0x00,"Patch "),"Display first row");
+    assertEquals(1,lcdRowEquals(0x40,"  ok "),"Display second row");
+    // one address per row, the lcd moves on by itself
+    assertEquals(9,hostLcdWrites,"Display text writes");
+}
+
+void testDisplayUnchanged(){
+    displayText(1,1,"Patch");
+    displayFlush();
+    hostLcdWrites = 0;
+
+    displayText(1,1,"Patch");
+    displayStep();
+    displayFlush();
+    assertEquals(0,hostLcdWrites,"Display unchanged text");
+
+    // spaces are already on a cleared lcd
+    displayText(2,1,"   ");
+    displayFlush();
+    assertEquals(0,hostLcdWrites,"Display blank text");
+}
+
+void testDisplayOnlyChanged(){
+    displayText(1,1,"Patch error");
+    displayFlush();
+    hostLcdWrites = 0;
+
+    displayText(1,1,"Patch ERROR");
+    displayFlush();
+    assertEquals(1,lcdRowEquals(0x00,"Patch ERROR"),"Display changed text");
+    assertEquals(6,hostLcdWrites,"Display changed text writes");
+
+    // characters apart need an address each
+    hostLcdWrites = 0;
+    displayChar(1,1,'p');
+    displayChar(1,3,'T');
+    displayFlush();
+    assertEquals(1,lcdRowEquals(0x00,"paTch"),"Display apart");
+    assertEquals(4,hostLcdWrites,"Display apart writes");
+}
+
+void testDisplayStep(){
+    displayText(1,2,"ab");
+
+    // one byte per step
+    displayStep();
+    assertEquals(1,hostLcdWrites,"Display step address");
+    assertEquals(' ',hostLcd[0x01],"Display step before data");
+    displayStep();
+    assertEquals(2,hostLcdWrites,"Display step data");
+    assertEquals('a',hostLcd[0x01],"Display step first character");
+    displayStep();
+    assertEquals('b',hostLcd[0x02],"Display step second character");
+    displayStep();
+    assertEquals(3,hostLcdWrites,"Display step up to date");
+
+    // a character changed before it is written is sent once, as changed
+    hostLcdWrites = 0;
+    displayChar(1,1,'x');
+    displayStep();
+    displayChar(1,1,'y');
+    displayFlush();
+    assertEquals('y',hostLcd[0x00],"Display step changed before write");
+    assertEquals(2,hostLcdWrites,"Display step changed before write writes");
+
+    // and again when it changes after being written
+    displayChar(1,1,'z');
+    displayFlush();
+    assertEquals('z',hostLcd[0x00],"Display step changed after write");
+}
+
+void testDisplayCutOff(){
+    displayText(1,15,"abcd");
+    displayChar(3,1,'x');
+    displayChar(1,0,'x');
+    displayFlush();
+    assertEquals(1,lcdRowEquals(0x0E,"ab"),"Display cut off");
+    assertEquals(' ',hostLcd[0x10],"Display cut off end of row");
+    assertEquals(1,lcdRowEquals(0x40," "),"Display cut off next row");
+    assertEquals(3,hostLcdWrites,"Display cut off writes");
+}
+
+void testDisplaySignedShort(){
+    displaySignedShort(1,1,-42);
+    displaySignedShort(2,1,7);
+    displayFlush();
+    assertEquals(1,lcdRowEquals(0x00,"-042"),"Display negative number");
+    assertEquals(1,lcdRowEquals(0x40," 007"),"Display positive number");
+}
+
+// setup and run test suite
+void runDisplayTests(){
+    reset();
+    resetDisplayTest();
+    add(&testDisplayText);
+    add(&testDisplayUnchanged);
+    add(&testDisplayOnlyChanged);
+    add(&testDisplayStep);
+    add(&testDisplayCutOff);
+    add(&testDisplaySignedShort);
+    run(resetDisplayTest);
+}
\ No newline at end of file
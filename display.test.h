@@ -0,0 +1 @@
+extern void runDisplayTests();
\ No newline at end of file
@@ -1,8 +1,8 @@
-#ifndef _GLOBALS_H
-#define _GLOBALS_H
-
-#include "types.h"
-
-
-
+#ifndef _GLOBALS_H
+#define _GLOBALS_H
+
+#include "types.h"
+
+
+
 #endif
\ No newline at end of file
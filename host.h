@@ -0,0 +1,40 @@
+#ifndef _HOST_H
+#define _HOST_H
+
+// Stand-ins for the mikroC built-ins used by the code that also builds on the
+// host, included by config.h for TARGET_HOST. Code touching registers stays
+// PIC only, except for the few below. The tests are run on the host with
+// test/host.c, which defines them.
+
+#include <stdint.h>
+
+// byte access to an int, like built_in.h. The host is little endian too.
+#define Hi(param) ((unsigned char *)&param)[1]
+#define Lo(param) ((unsigned char *)&param)[0]
+
+#define Delay_us(time)
+
+// interrupt control, only the global enable is written
+typedef struct {
+    unsigned char GIE;
+} HostInterruptControl;
+
+extern HostInterruptControl INTCON;
+
+// gate output port
+extern unsigned char LATD;
+extern unsigned char TRISD;
+
+// EEPROM library, backed by EEPROM_SIZE bytes of RAM
+extern unsigned short EEPROM_Read(unsigned int address);
+extern void EEPROM_Write(unsigned int address, unsigned short data);
+
+// character lcd, the display data RAM of a HD44780 and its address counter.
+// Replaces displayWrite() in display.c.
+#define HOST_LCD_SIZE 0x80
+
+extern char hostLcd[HOST_LCD_SIZE];
+extern unsigned int hostLcdWrites;
+extern void displayWrite(unsigned short value, unsigned short isData);
+
+#endif
\ No newline at end of file
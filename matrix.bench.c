@@ -0,0 +1,529 @@
+#include "nodetypes.h"
+#include "matrix.private.h"
+#include "matrix.h"
+#include "definitions.h"
+#include "output.h"
+#include "wcet.h"
+
+#ifdef TARGET_HOST
+#include <time.h>
+#endif
+
+// Benchmarks for runMatrix() on random patches. Patches are generated from a
+// seeded LFSR so every run of the suite measures the same patches, and are
+// always valid: params only read earlier nodes, index params are in range and
+// values are in the 8 bit range of the PIC.
+// Results are written as CSV through a charSink. On target times are in
+// instruction cycles per matrix run, measured with the matrix timer. On the
+// host they are in nanoseconds per run, and every patch is measured both with
+// and without linkPatch() when linked operands are enabled.
+
+// matrix and nodes used by all benchmarks, a new patch is generated for each
+Matrix benchMatrix;
+Node benchNodes[MAX_OPERATIONS];
+matrixint benchOutputBuffer[MAX_SH_OUTPUTS];
+
+// pattern for sequencer nodes
+const SequencerPattern benchPatterns[1] = {
+    {SEQUENCER_MAX_STEPS, {{0, 0, 0}}}
+};
+
+// LFSR state, never 0
+unsigned int benchSeed;
+
+// delay arena taken by the delay buffer nodes generated so far
+unsigned int benchDelayInUse;
+
+#define BENCH_SEED 0xACE1
+
+// largest fan in of the sweep, also the most params a generated node gets
+#define BENCH_MAX_FANIN 8
+
+// runs per measurement, the host needs many to get past the clock resolution
+#ifdef TARGET_HOST
+#define BENCH_RUNS 2000
+#else
+#define BENCH_RUNS 16
+#endif
+
+// runs with random constants when measuring the cost of a single node
+#define BENCH_COST_RUNS 32
+
+// params added on top of the minimum to measure the cost per param
+#define BENCH_COST_EXTRA_PARAMS 4
+
+// share of params that are constants instead of reading a node, in 1/8
+#define BENCH_CONSTANT_EIGHTHS 2
+
+// node types used in generated patches, in two groups so the share of nodes
+// keeping state between runs can be set. Fused types are only made by
+// fusePatch().
+const unsigned short benchPureTypes[] = {
+    NODE_SUM, NODE_INVERT, NODE_INVERT_EACH_SIDE, NODE_INPUT, NODE_OUTPUT,
+    NODE_MULTIPLY, NODE_SWITCH, NODE_COMPARE, NODE_MAX, NODE_MIN, NODE_SCALE,
+    NODE_BINARY_AND, NODE_BINARY_OR, NODE_BINARY_XOR, NODE_BINARY_NOT,
+    NODE_QUANTIZE, NODE_TUNE, NODE_POSITIVE_EXP, NODE_GATE_OUTPUT,
+    NODE_DIVIDE, NODE_AVERAGE, NODE_CLAMP, NODE_CROSSFADE, NODE_ABS,
+    NODE_MOD_MATRIX
+};
+#define BENCH_PURE_TYPES 25
+
+// sequencers are generated with a sequencer gate node reading them, and mod
+// matrixes with the destination they write, see generatePatch()
+const unsigned short benchStatefulTypes[] = {
+    NODE_RAMP, NODE_DELAY_LINE, NODE_MEMORY, NODE_LFO_PULSE, NODE_TRIGGER,
+    NODE_GLIDE, NODE_SLEW, NODE_TRIGGER_OUTPUT, NODE_DELAY_BUFFER, NODE_SEQUENCER
+};
+#define BENCH_STATEFUL_TYPES 10
+
+// number of params each node type reads, indexed by node type
+const unsigned short benchParamCount[NODE_TYPES] = {
+    2, 1, 1, 4, 1, 1, 2, 2, 3, 6, // NODE_SUM - NODE_LFO_PULSE
+    2, 2, 2, 2, 2, 1, 2, 2, 2, 1, // NODE_SWITCH - NODE_BINARY_NOT
+    0, 0, 1, 4, 1, 1, 2, 3, 4, 3, // unused - NODE_FUSED_INPUT_SCALE_OUTPUT
+    3, 2, 0, 0, 2, 2, 3, 3, 1, 3, // NODE_FUSED_INPUT_OFFSET_SCALE - NODE_DELAY_BUFFER
+    4, 1                          // NODE_SEQUENCER - NODE_SEQUENCER_GATE
+};
+
+// 16 bit Galois LFSR
+unsigned int benchRandom(){
+    if(benchSeed & 1){
+        benchSeed = (benchSeed >> 1) ^ 0xB400;
+    } else {
+        benchSeed = benchSeed >> 1;
+    }
+    return benchSeed;
+}
+
+unsigned int benchRandomBelow(unsigned int limit){
+    return benchRandom() % limit;
+}
+
+// random value in the range of an 8 bit matrixint
+matrixint benchRandomValue(){
+    return (int)(benchRandom() & 0xFF) - 128;
+}
+
+// node types that read all their params, and take as many as the fan in
+unsigned short isVariadicType(unsigned short type){
+    return type == NODE_SUM || type == NODE_MULTIPLY || type == NODE_MAX
+        || type == NODE_MIN || type == NODE_BINARY_AND || type == NODE_BINARY_OR
+        || type == NODE_AVERAGE;
+}
+
+// Returns the size of the buffer a param indexes, or 0 if the param is a value
+unsigned int getIndexParamLimit(unsigned short type, unsigned short paramId){
+    if(paramId == 0){
+        switch(type){
+            case NODE_INPUT:
+            case NODE_FUSED_INPUT_SCALE_OUTPUT:
+            case NODE_FUSED_INPUT_OFFSET_SCALE:
+                return MAX_INPUTS;
+            case NODE_OUTPUT:
+                return MAX_SH_OUTPUTS;
+            case NODE_GATE_OUTPUT:
+            case NODE_TRIGGER_OUTPUT:
+                return MAX_GATE_OUTPUTS;
+            case NODE_SEQUENCER_GATE:
+                // reads node 0 when measuring its cost, generated patches
+                // read a sequencer, see addBenchSequencer()
+                return 1;
+        }
+    } else if(paramId == 2 && type == NODE_FUSED_INPUT_SCALE_OUTPUT){
+        return MAX_SH_OUTPUTS;
+    } else if(paramId == 1 && type == NODE_SEQUENCER){
+        // the bench has one pattern
+        return 1;
+    } else if(paramId == 2 && type == NODE_SEQUENCER){
+        return SEQUENCER_DIRECTIONS;
+    } else if(paramId == 1 && type == NODE_DELAY_BUFFER){
+        // buffer length - 1, the buffers must fit in the delay arena together
+        if(DELAY_ARENA_SIZE - benchDelayInUse < DELAY_MAX_LENGTH){
+            return DELAY_ARENA_SIZE - benchDelayInUse;
+        }
+        return DELAY_MAX_LENGTH;
+    }
+    return 0;
+}
+
+// start from an empty matrix with random inputs
+void resetBenchMatrix(){
+    paramindex i;
+    resetMatrix(&benchMatrix);
+    benchMatrix.outputBuffer = benchOutputBuffer;
+    benchMatrix.patterns = benchPatterns;
+    benchMatrix.patternsInUse = 1;
+    benchDelayInUse = 0;
+    for(i = 0; i<MAX_INPUTS; i++){
+        benchMatrix.inputBuffer[i] = benchRandomValue();
+    }
+}
+
+// Add a param to a node at index that reads a random earlier node, or is a
+// random constant
+void addBenchValueParam(Node *aNode, nodeindex index){
+    if(index == 0 || benchRandomBelow(8) < BENCH_CONSTANT_EIGHTHS){
+        addConstantParam(&benchMatrix, aNode, benchRandomValue());
+    } else {
+        addNodeParam(&benchMatrix, aNode, benchRandomBelow(index));
+    }
+}
+
+// Add a node of a type with paramCount params to the bench matrix. Params
+// read a random earlier node, or are random constants. Returns 0 if the node
+// does not fit.
+unsigned short addBenchNode(unsigned short type, unsigned short paramCount){
+    Node *aNode;
+    unsigned short param;
+    unsigned int limit, value;
+    nodeindex index;
+
+    index = benchMatrix.nodesInUse;
+    if(index == MAX_OPERATIONS || benchMatrix.paramsInPool + paramCount > MAX_OPERANDS){
+        return 0;
+    }
+
+    aNode = &benchNodes[index];
+    aNode->func = getFunctionPointer(type);
+    aNode->result = 0;
+    aNode->highResState = 0;
+    aNode->auxState = 0;
+    aNode->state = 0;
+    addNode(&benchMatrix, aNode);
+
+    for(param = 0; param<paramCount; param++){
+        limit = getIndexParamLimit(type, param);
+        if(limit){
+            value = benchRandomBelow(limit);
+            addConstantParam(&benchMatrix, aNode, value);
+            if(type == NODE_DELAY_BUFFER){
+                benchDelayInUse += value + 1;
+            }
+        } else {
+            addBenchValueParam(aNode, index);
+        }
+    }
+    return 1;
+}
+
+// Add a mod matrix node routing routes random sources to a destination node
+// added before it. If there are nodesLeft for it, half of them also get an
+// input scaled by the destination before the mod matrix and an output of it
+// after, so the destination is read before the mod matrix writes it, in a
+// chain fusePatch() must not fuse past the mod matrix. Returns 0 if they do
+// not fit.
+unsigned short addBenchModMatrix(unsigned short routes, nodeindex nodesLeft){
+    Node *aNode;
+    unsigned short route, isRead;
+    nodeindex destination, modMatrix;
+
+    destination = benchMatrix.nodesInUse;
+    isRead = nodesLeft >= 5 && benchRandomBelow(2);
+    if(destination + 2 + isRead * 3 > MAX_OPERATIONS || benchMatrix.paramsInPool + 2 + routes * 2 + isRead * 5 > MAX_OPERANDS){
+        return 0;
+    }
+
+    addBenchNode(NODE_MOD_DESTINATION, 0);
+    if(isRead){
+        addBenchNode(NODE_INPUT, 1);
+        addBenchNode(NODE_SCALE, 0);
+        aNode = &benchNodes[destination + 2];
+        addNodeParam(&benchMatrix, aNode, destination + 1);
+        addNodeParam(&benchMatrix, aNode, destination);
+    }
+
+    modMatrix = benchMatrix.nodesInUse;
+    addBenchNode(NODE_MOD_MATRIX, 0);
+    aNode = &benchNodes[modMatrix];
+    addNodeParam(&benchMatrix, aNode, destination);
+    addConstantParam(&benchMatrix, aNode, routes);
+    for(route = 0; route<routes; route++){
+        addBenchValueParam(aNode, modMatrix);
+        addConstantParam(&benchMatrix, aNode, benchRandomValue());
+    }
+
+    if(isRead){
+        addBenchNode(NODE_OUTPUT, 0);
+        aNode = &benchNodes[modMatrix + 1];
+        addConstantParam(&benchMatrix, aNode, benchRandomBelow(MAX_SH_OUTPUTS));
+        addNodeParam(&benchMatrix, aNode, destination + 2);
+    }
+    return 1;
+}
+
+// Add a sequencer node and a sequencer gate node reading it. Returns 0 if
+// they do not fit.
+unsigned short addBenchSequencer(){
+    nodeindex sequencer;
+
+    sequencer = benchMatrix.nodesInUse;
+    if(sequencer + 2 > MAX_OPERATIONS || benchMatrix.paramsInPool + benchParamCount[NODE_SEQUENCER] + 1 > MAX_OPERANDS){
+        return 0;
+    }
+
+    addBenchNode(NODE_SEQUENCER, benchParamCount[NODE_SEQUENCER]);
+    addBenchNode(NODE_SEQUENCER_GATE, 0);
+    addNodeParam(&benchMatrix, &benchNodes[sequencer + 1], sequencer);
+    return 1;
+}
+
+// Generate a random patch of up to nodeCount nodes. Variadic nodes and mod
+// matrixes get fanIn params or routes, statefulEighths/8 of the nodes keep
+// state between runs. The patch is validated, which gives delay buffers their
+// part of the delay arena. Returns the number of nodes generated, fewer if the
+// operand pool ran out.
+nodeindex generatePatch(nodeindex nodeCount, unsigned short fanIn, unsigned short statefulEighths){
+    unsigned short type, paramCount, added;
+
+    resetBenchMatrix();
+    while(benchMatrix.nodesInUse < nodeCount){
+        if(benchRandomBelow(8) < statefulEighths){
+            type = benchStatefulTypes[benchRandomBelow(BENCH_STATEFUL_TYPES)];
+        } else {
+            type = benchPureTypes[benchRandomBelow(BENCH_PURE_TYPES)];
+        }
+        if(type == NODE_DELAY_BUFFER && benchDelayInUse == DELAY_ARENA_SIZE){
+            type = NODE_DELAY_LINE;
+        }
+        // node pairs only when both fit
+        if((type == NODE_MOD_MATRIX || type == NODE_SEQUENCER) && benchMatrix.nodesInUse + 1 == nodeCount){
+            type = NODE_DELAY_LINE;
+        }
+
+        paramCount = benchParamCount[type];
+        if(isVariadicType(type)){
+            paramCount = fanIn;
+        }
+        if(type == NODE_MOD_MATRIX){
+            added = addBenchModMatrix(fanIn, nodeCount - benchMatrix.nodesInUse);
+        } else if(type == NODE_SEQUENCER){
+            added = addBenchSequencer();
+        } else {
+            added = addBenchNode(type, paramCount);
+        }
+        if(!added){
+            break;
+        }
+    }
+    validatePatch(&benchMatrix);
+    return benchMatrix.nodesInUse;
+}
+
+// copy the generated patch in benchMatrix into a matrix of its own
+void copyBenchPatch(Matrix *aMatrix, Node *nodes, matrixint *outputBuffer){
+    nodeindex i;
+    *aMatrix = benchMatrix;
+    for(i = 0; i<benchMatrix.nodesInUse; i++){
+        nodes[i] = *benchMatrix.nodes[i];
+        aMatrix->nodes[i] = &nodes[i];
+    }
+    aMatrix->outputBuffer = outputBuffer;
+    for(i = 0; i<MAX_SH_OUTPUTS; i++){
+        outputBuffer[i] = 0;
+    }
+}
+
+// Time of runs matrix runs, in instruction cycles on target and nanoseconds
+// on the host. The target timer is restarted for every run so it can not
+// overflow on large patches.
+unsigned long timeMatrixRuns(unsigned int runs){
+    unsigned long total;
+    unsigned int i;
+#ifdef TARGET_HOST
+    clock_t start;
+    start = clock();
+    for(i = 0; i<runs; i++){
+        runMatrix(&benchMatrix);
+    }
+    total = (unsigned long)((double)(clock() - start) * 1000000000.0 / CLOCKS_PER_SEC);
+#else
+    total = 0;
+    for(i = 0; i<runs; i++){
+        matrixTimerStart();
+        runMatrix(&benchMatrix);
+        total += matrixTimerRead();
+    }
+    total = total * DAC_TIMER_PRESCALER;
+#endif
+    return total;
+}
+
+// time of a single run of the patch in the bench matrix, averaged
+unsigned long timeMatrixRun(){
+    return timeMatrixRuns(BENCH_RUNS) / BENCH_RUNS;
+}
+
+void benchString(charSink sink, const char *text){
+    while(*text){
+        sink(*text);
+        text++;
+    }
+}
+
+void benchNumber(charSink sink, unsigned long number){
+    char digits[10];
+    unsigned short count;
+
+    count = 0;
+    do {
+        digits[count] = '0' + number % 10;
+        number = number / 10;
+        count++;
+    } while(number);
+
+    while(count){
+        count--;
+        sink(digits[count]);
+    }
+}
+
+void benchLine(charSink sink){
+    sink('\r');
+    sink('\n');
+}
+
+// Generate a patch, measure it and write a row:
+// nodes, fan in, stateful eighths, time per run and, with linked operands,
+// time per run after linkPatch().
+void benchPatch(charSink sink, nodeindex nodeCount, unsigned short fanIn, unsigned short statefulEighths){
+    nodeindex nodes;
+
+    nodes = generatePatch(nodeCount, fanIn, statefulEighths);
+    benchNumber(sink, nodes);
+    sink(',');
+    benchNumber(sink, fanIn);
+    sink(',');
+    benchNumber(sink, statefulEighths);
+    sink(',');
+    benchNumber(sink, timeMatrixRun());
+#ifdef MATRIX_LINKED_OPERANDS
+    sink(',');
+    linkPatch(&benchMatrix);
+    benchNumber(sink, timeMatrixRun());
+#endif
+    benchLine(sink);
+}
+
+void benchHeader(charSink sink, const char *name){
+    benchString(sink, name);
+    benchLine(sink);
+#ifdef TARGET_HOST
+    benchString(sink, "nodes,fanin,stateful8ths,ns");
+#else
+    benchString(sink, "nodes,fanin,stateful8ths,cycles");
+#endif
+#ifdef MATRIX_LINKED_OPERANDS
+    benchString(sink, ",linked");
+#endif
+    benchLine(sink);
+}
+
+// run time against number of nodes, doubling up to MAX_OPERATIONS
+void benchNodeCount(charSink sink){
+    nodeindex nodes;
+    benchHeader(sink, "# nodes");
+    nodes = 1;
+    while(nodes < MAX_OPERATIONS){
+        benchPatch(sink, nodes, 2, 2);
+        if(nodes > MAX_OPERATIONS / 2){
+            break;
+        }
+        nodes = nodes * 2;
+    }
+    benchPatch(sink, MAX_OPERATIONS, 2, 2);
+}
+
+// run time against fan in, with as many nodes as the operand pool allows at
+// the largest fan in so all rows have the same node count.
+void benchFanIn(charSink sink){
+    unsigned short fanIn;
+    nodeindex nodes;
+    benchHeader(sink, "# fan in");
+    nodes = MAX_OPERANDS / BENCH_MAX_FANIN;
+    if(nodes > MAX_OPERATIONS){
+        nodes = MAX_OPERATIONS;
+    }
+    for(fanIn = 1; fanIn <= BENCH_MAX_FANIN; fanIn++){
+        benchPatch(sink, nodes, fanIn, 2);
+    }
+}
+
+// run time against the share of nodes keeping state
+void benchStateful(charSink sink){
+    unsigned short eighths;
+    benchHeader(sink, "# stateful");
+    for(eighths = 0; eighths <= 8; eighths++){
+        benchPatch(sink, MAX_OPERATIONS, 2, eighths);
+    }
+}
+
+// Worst time of a patch with a single node over patches with random
+// constants, without the time of running an empty patch.
+unsigned long timeNode(unsigned short type, unsigned short paramCount, unsigned long emptyTime){
+    unsigned short i;
+    unsigned long time, worst;
+
+    worst = 0;
+    for(i = 0; i<BENCH_COST_RUNS; i++){
+        resetBenchMatrix();
+        addBenchNode(type, paramCount);
+        time = timeMatrixRun();
+        if(time > worst){
+            worst = time;
+        }
+    }
+    if(worst < emptyTime){
+        return 0;
+    }
+    return worst - emptyTime;
+}
+
+// Measured cost of every node type, in the layout of nodeBaseCycles and
+// nodeParamCycles in wcet.c. The base cost still includes the cycles the
+// matrix loop and the call take for the node, see NODE_LOOP_CYCLES and
+// NODE_CALL_CYCLES.
+void benchNodeCosts(charSink sink){
+    unsigned short type, paramCount;
+    unsigned long emptyTime, time, paramTime;
+
+    resetBenchMatrix();
+    emptyTime = timeMatrixRun();
+
+    benchString(sink, "# node costs");
+    benchLine(sink);
+#ifdef TARGET_HOST
+    benchString(sink, "type,ns,ns_per_param");
+#else
+    benchString(sink, "type,cycles,cycles_per_param");
+#endif
+    benchLine(sink);
+
+    for(type = 0; type<NODE_TYPES; type++){
+        paramCount = benchParamCount[type];
+        time = timeNode(type, paramCount, emptyTime);
+        paramTime = 0;
+        if(isVariadicType(type)){
+            paramTime = timeNode(type, paramCount + BENCH_COST_EXTRA_PARAMS, emptyTime);
+            if(paramTime > time){
+                paramTime = (paramTime - time) / BENCH_COST_EXTRA_PARAMS;
+            } else {
+                paramTime = 0;
+            }
+        }
+        benchNumber(sink, type);
+        sink(',');
+        benchNumber(sink, time);
+        sink(',');
+        benchNumber(sink, paramTime);
+        benchLine(sink);
+    }
+}
+
+// run all benchmarks, writing the results to sink
+void runMatrixBenchmarks(charSink sink){
+    benchSeed = BENCH_SEED;
+    benchNodeCosts(sink);
+    benchNodeCount(sink);
+    benchFanIn(sink);
+    benchStateful(sink);
+}
\ No newline at end of file
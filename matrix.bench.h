@@ -0,0 +1,8 @@
+extern Matrix benchMatrix;
+extern Node benchNodes[MAX_OPERATIONS];
+extern unsigned int benchSeed;
+extern unsigned int benchRandom();
+extern matrixint benchRandomValue();
+extern nodeindex generatePatch(nodeindex nodeCount, unsigned short fanIn, unsigned short statefulEighths);
+extern void copyBenchPatch(Matrix *aMatrix, Node *nodes, matrixint *outputBuffer);
+extern void runMatrixBenchmarks(charSink sink);
\ No newline at end of file
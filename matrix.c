@@ -1,493 +1,2014 @@
-#include "types.h"
-#include "config.h"
-#include "definitions.h"
-#include "nodetypes.h"
-#include "Output.h"
-
-// matrix nodes
-Node *nodes[MAX_OPERATIONS];
-unsigned short nodesInUse = 0;
-
-// place where matrix reads inputs from
-matrixint inputBuffer[8];
-
-// true if a matrix run has been completed and data is ready to be copied to
-// the dac buffer before the next dac cycle.
-unsigned short matrixCalculationCompleted;
-
-// lookup table for linear to exponential conversion that only converts positive
-// values (and eases of to 0 to allow maximum offness
-matrixint lookupTablePositiveExponential[matrixintrange];
-
-// params can be pointers to the result of the previous Node in the matrix or
-// they can be constants. This function figures out which one and returns its
-// value.
-matrixint getParam(Node *aNode, unsigned short paramId){
-    unsigned short type;
-
-    type = (aNode->paramIsConstant >> paramId) & 0b00000001;
-    if(type == 1){
-        return aNode->params[paramId];
-    } else {
-        //TODO will this work with a 16 bit param?
-        return nodes[aNode->params[paramId]]->result;
-    }
-}
-
-// sum an arbitrary number of inputs.
-void nodeFuncSum(Node *aNode){
-    unsigned short i;
-    aNode->result = 0;
-    for(i=0; i<aNode->paramsInUse; i++){
-        aNode->result += getParam(aNode, i);
-    }
-}
-
-// multiply an arbitrary number of inputs.
-void nodeFuncMultiply(Node *aNode){
-    unsigned short i;
-    aNode->result = getParam(aNode, 0);
-    for(i=1; i<aNode->paramsInUse; i++){
-        aNode->result *= getParam(aNode, i);
-    }
-}
-
-// accepts a single input and inverts it.
-void nodeFuncInvert(Node *aNode){
-    matrixint param;
-    param = getParam(aNode, 0);
-
-    //hack to allow whole range to be inverted. chops off top as 128 is not
-    //possible with an 8 bit signed variable.
-    if(param == MAX_NEGATIVE){
-        aNode->result = MAX_POSITIVE;
-    } else {
-        aNode->result = -param;
-    }
-}
-
-// accepts a single input and iverts it around the "center" (64 or -63) of the
-// side of 0 that the input is: 1 becomes 127 but -1 becomes -126.
-// usefull for inverting envelopes without turning them negative.
-void nodeFuncInvertEachSide(Node *aNode){
-    matrixint param;
-    param = getParam(aNode, 0);
-
-    if(param >= 0){
-        aNode->result = MAX_POSITIVE - param;
-    } else {
-        aNode->result = MAX_NEGATIVE - 1 - param;
-    }
-}
-
-// calculate increment necessary to get the requested ramp timing.
-int calculateRampIncrement(matrixint setting, short direction, short bipolar){
-    int highResSetting = setting;
-    if(direction == 0){
-        highResSetting = -highResSetting;
-    }
-    return highResSetting << 8;
-}
-
-// Ramp function, takes three parameters:
-// - param[0]: timing
-// - param[1]: trigger, ramp is reset when trigger != 0
-// - param[2]: start position (may be runtime input or config), depends on paramIsConstant setting
-// - param[3]: bitfield
-//   - B0=shoudResetWhenFinished
-//   - B1=direction, 0=down, 1=up
-//   - B2=bipolar, 0=false (only positive numbers are used), 1=true (full range)
-void nodeFuncRamp(Node *aNode){
-
-    int increment;
-    matrixint trigger, startPosition;
-    bit shouldResetWhenFinished, direction, bipolar;
-
-    trigger = getParam(aNode, 1);
-    startPosition = getParam(aNode, 2);
-    shouldResetWhenFinished = aNode->params[3].B0;
-
-    //TODO: Implement usage of these
-    direction = aNode->params[3].B1;
-    bipolar = aNode->params[3].B2;
-
-    if(trigger){
-        aNode->highResState = startPosition << 8;
-        aNode->state.B0 = RUNNING;
-    } else {
-        increment = calculateRampIncrement(getParam(aNode, 0), direction, bipolar);
-
-        //TODO: This may never reach max, is that a problem?
-        //      should possibly add max value before resetting
-        if(aNode->state.B0){ // RUNNING
-            if( direction == UP   && (aNode->highResState < 0 ||  32767 - aNode->highResState > increment) ||
-                direction == DOWN && (aNode->highResState > 0 || -32768 - aNode->highResState <= increment)){
-                aNode->highResState += increment;
-            } else {
-                aNode->state.B0 = STOPPED;
-                if(shouldResetWhenFinished){
-                    aNode->highResState = startPosition << 8;
-                }
-            }
-        }
-    }
-    aNode->result = (aNode->highResState >> 8);
-}
-
-// A square/pulse wave LFO with settable speed, pulse width, positive and
-// negative amplitude, retrigger and start position
-void nodeFuncLfoPulse(Node *aNode){
-    matrixint cyclelength = getParam(aNode, 0);
-    matrixint pulsewidth = getParam(aNode, 1);
-    matrixint trigger = getParam(aNode, 2);
-
-    //may be set to any value to limit amplitude and save using a scale shape.
-    matrixint positive = getParam(aNode, 3);
-    matrixint negative = getParam(aNode, 4);
-
-    bit startPosition;
-    startPosition = aNode->params[5].B0; // 0 = bottom, 1 = top;
-
-    if(trigger){
-        if(startPosition){
-            aNode->result = positive;
-        } else {
-            aNode->result = negative;
-        }
-        aNode->highResState = 0;
-    } else {
-        aNode->highResState++;
-        if(aNode->highResState == pulsewidth || aNode->highResState == cyclelength){
-           //flip
-           if(aNode->result > 0 ){
-               aNode->result = negative;
-           } else {
-               aNode->result = positive;
-           }
-        }
-        if(aNode->highResState == cyclelength){
-            aNode->highResState = 0;
-        }
-    }
-}
-
-// "delay line", stores the input for one cycle and uses it as feedback in the
-// next, makes it possible to make loops in the network (may not be necessary?
-// as one can use the value of any Node's previous result in the next run).
-//   NB: result should be set to 0 initially (or to whatever starting feedback
-//   one wants.
-void nodeFuncDelayLine(Node *aNode){
-    aNode->result = getParam(aNode, 0);
-}
-
-// memory with set and clear, may be used as sample and hold
-// Set if param 1 > 0,
-// Clear if param 2 > 0 (resets to 0)
-void nodeFuncMemory(Node *aNode){
-    if(getParam(aNode, 2)){
-        aNode->result = 0;
-    } else if(getParam(aNode, 1)){
-        aNode->result = getParam(aNode, 0);
-    }
-}
-
-// switch, passes value on input 0 when input 1 is true, reverts to 0 if not
-void nodeFuncSwitch(Node *aNode){
-    if(getParam(aNode, 1)){
-        aNode->result = getParam(aNode, 0);
-    } else {
-        aNode->result = 0;
-    }
-}
-
-// compares parameter 0 to parameter 1. If 0 is larger, output is BINARY_TRUE,
-// if, not it is BINARY_FALSE
-void nodeFuncCompare(Node *aNode){
-    if(getParam(aNode, 0) > getParam(aNode, 1)){
-        aNode->result = BINARY_TRUE;
-    } else {
-        aNode->result = BINARY_FALSE;
-    }
-}
-
-// returns the maximum of all inputs
-void nodeFuncMax(Node *aNode){
-    unsigned short i;
-    matrixint temp;
-
-    aNode->result = MAX_NEGATIVE;
-    for(i = 0; i<aNode->paramsInUse; i++){
-        temp = getParam(aNode, i);
-        if(temp > aNode->result){
-            aNode->result = temp;
-        }
-    }
-}
-
-// returns the minimum of all inputs
-void nodeFuncMin(Node *aNode){
-    unsigned short i;
-    matrixint temp;
-
-    aNode->result = MAX_POSITIVE;
-    for(i = 0; i<aNode->paramsInUse; i++){
-        temp = getParam(aNode, i);
-        if(temp < aNode->result){
-            aNode->result = temp;
-        }
-    }
-}
-
-// scales input 0 by input 1 / (MAX_POSITIVE + 1)
-void nodeFuncScale(Node *aNode){
-    matrixlongint temp;
-    matrixint param1, param2;
-
-    param1 = getParam(aNode, 0);
-    param2 = getParam(aNode, 1);
-
-    // special edge cases
-    if(param1 == MAX_POSITIVE && param2 == MAX_POSITIVE){
-        //prevents attenuation due to rounding error if both inputs are max positive
-        aNode->result = MAX_POSITIVE;
-        return;
-    } else if(param1 <= MAX_NEGATIVE+1 && param2 <= MAX_NEGATIVE+1 ){
-        //prevents overflow
-        aNode->result = MAX_POSITIVE;
-        return;
-    }
-
-    temp = param1 * param2;
-
-    //This leads to a slight error - the correct way to do it would be
-    //dividing the input by MAX_POSITIVE, but that is an expensive operation.
-    //Instead, we shift by 7, which is equal to dividing by MAX_POSITIV+1.
-    temp = temp >> 7;
-
-    aNode->result = temp;
-}
-
-// Generates a pulse (maximum output value) lasting for one iteration
-// after the input changes from negative to positive.
-void nodeFuncTrigger(Node *aNode){
-    if(getParam(aNode, 0) > 0 ){
-        if(aNode->state == 0){
-            aNode->result = MAX_POSITIVE;
-            aNode->state = MAX_POSITIVE;
-        } else {
-            aNode->result = 0;
-        }
-    } else {
-        aNode->state = 0;
-    }
-}
-
-// treat input as a binary values and binary AND them
-void nodeFuncBinaryAnd(Node *aNode){
-    unsigned short paramNum;
-    aNode->result = BINARY_TRUE;
-    for(paramNum = 0; paramNum < aNode->paramsInUse; paramNum++){
-        if(getParam(aNode, paramNum) <= 0){
-            aNode->result = BINARY_FALSE;
-            break;
-        }
-    }
-}
-
-// treat input as a binary values and binary OR them
-void nodeFuncBinaryOr(Node *aNode){
-    unsigned short paramNum;
-    aNode->result = BINARY_FALSE;
-    for(paramNum = 0; paramNum < aNode->paramsInUse; paramNum++){
-        if(getParam(aNode, paramNum) > 0){
-            aNode->result = BINARY_TRUE;
-            break;
-        }
-    }
-}
-
-// treat input as a binary values and binary XOR them
-void nodeFuncBinaryXor(Node *aNode){
-    unsigned short param0;
-    unsigned short param1;
-
-    param0 = getParam(aNode, 0) > 0;
-    param1 = getParam(aNode, 1) > 0;
-
-    if(param0 != param1){
-      aNode->result = BINARY_TRUE;
-    } else {
-      aNode->result = BINARY_FALSE;
-    }
-}
-
-// treat input as a binary value and binary INVERT it
-void nodeFuncBinaryNot(Node *aNode){
-    if(getParam(aNode,0) > 0){
-        aNode->result = BINARY_FALSE;
-    } else {
-        aNode->result = BINARY_TRUE;
-    }
-}
-
-// fetch  input from inputBuffer and add it as the result of a Node to be used
-// in the matrix
-void nodeFuncInput(Node *aNode){
-    aNode->result = inputBuffer[getParam(aNode, 0)];
-}
-
-// write output to outputBuffer
-void nodeFuncOutput(Node *aNode){
-    outputBuffer[getParam(aNode, 0)] = getParam(aNode, 1);
-}
-
-//glide any output. resists change.
-void nodeFuncGlide(Node *aNode){
-    matrixint input = getParam(aNode,0);
-    matrixint maxchange = getParam(aNode,1); // maximum rate of change - consider inverting this to get 0=no glide, max = max glide.
-    matrixint glideUp   = getParam(aNode,2); // should glide up?
-    matrixint glideDown = getParam(aNode,3); // should glide down?
-    
-    matrixint change = input - aNode->result;
-    if(change > 0 && glideUp){ // input is larger than current output
-        if(change > maxchange){
-            aNode->result += maxchange;
-        } else {
-            aNode->result += change;
-        }
-    } else if(change < 0 && glideDown) { // input is smaller than current output
-        if(change < maxchange * -1){
-            aNode->result -= maxchange;
-        } else {
-            aNode->result += change;
-        }
-    } else {
-        aNode->result = input;
-    }
-}
-
-void nodeFuncQuantize(Node *aNode){
-     //TODO
-}
-
-// Convert linear value to exponential. Only positive values are converted,
-// all others are 0, to allow maximum offness.
-void nodeFuncPositiveExp(Node *aNode){
-    matrixint input = getParam(aNode,0);
-    if(input > 0){
-        aNode->result = lookupTablePositiveExponential[input];
-    } else {
-        aNode->result = 0;
-    }
-}
-
-// do nothing
-void nodeFuncNoop(Node *aNode){}
-
-// precalculate a 70dB exponential curve for positive input values.
-void precalcPositiveExponentialLookup(){
-
-    // dB calculation
-    // The maximum attenuation is found like this:
-    //  * Change in dB = 20 * log(Output/Input)
-    //  * Output = Input * 10^(Change in dB / 20)
-    // For -70dB:
-    //  * Output = Input * 10^(-70 / 20) = Input * 0.000316
-    //
-    // To calculate the curve we have that:
-    // f(0) = 0.000316
-    // f(max) = 1;
-    //
-    unsigned matrixint i;
-    lookupTablePositiveExponential[0] = 0;
-    for(i=1; i<=matrixintmax; i++){
-        lookupTablePositiveExponential[i] = 0;
-    }
-}
-
-// add Node to the matrix.
-void addNode(Node *aNode){
-    nodes[nodesInUse] = aNode;
-    nodesInUse++;
-}
-
-// loop over the matrix array once and calculate all results
-void runMatrix(){
-    unsigned short i;
-    Node *aNode;
-    for(i = 0; i<nodesInUse; i++){
-      aNode = nodes[i];
-      aNode->func(aNode);
-    }
-
-    // all nodes have written their data to the output buffer, tell
-    // dac loop that new data can be loaded when dac cycle restarts
-    matrixCalculationCompleted = 1;
-}
-
-extern void resetMatrix(){
-    unsigned short i;
-    for(i=0; i<MAX_OPERATIONS; i++){
-        nodes[i] = 0;
-    }
-    nodesInUse = 0;
-}
-
-nodeFunction getFunctionPointer(unsigned short function){
-    switch(function){
-        case NODE_SUM:
-            return &nodeFuncSum;
-        case NODE_INVERT:
-            return &nodeFuncInvert;
-        case NODE_INVERT_EACH_SIDE:
-            return &nodeFuncInvertEachSide;
-        case NODE_RAMP:
-            return &nodeFuncRamp;
-        case NODE_DELAY_LINE:
-            return &nodeFuncDelayLine;
-        case NODE_INPUT:
-            return &nodeFuncInput;
-        case NODE_OUTPUT:
-            return &nodeFuncOutput;
-        case NODE_MULTIPLY:
-            return &nodeFuncMultiply;
-        case NODE_MEMORY:
-            return &nodeFuncMemory;
-        case NODE_LFO_PULSE:
-            return &nodeFuncLfoPulse;
-        case NODE_SWITCH:
-            return &nodeFuncSwitch;
-        case NODE_COMPARE:
-            return &nodeFuncCompare;
-        case NODE_MAX:
-            return &nodeFuncMax;
-        case NODE_MIN:
-            return &nodeFuncMin;
-        case NODE_SCALE:
-            return &nodeFuncScale;
-        case NODE_TRIGGER:
-            return &nodeFuncTrigger;
-        case NODE_BINARY_AND:
-            return &nodeFuncBinaryAnd;
-        case NODE_BINARY_OR:
-            return &nodeFuncBinaryOr;
-        case NODE_BINARY_XOR:
-            return &nodeFuncBinaryXor;
-        case NODE_BINARY_NOT:
-            return &nodeFuncBinaryNot;
-        case NODE_INPUT:
-            return &nodeFuncInput;
-        case NODE_OUTPUT:
-            return &nodeFuncOutput;
-        case NODE_GLIDE:
-            return &nodeFuncGlide;
-        case NODE_QUANTIZE:
-            return &nodeFuncNoop;
-        case NODE_TUNE:
-            return &nodeFuncNoop;
-        case NODE_POSITIVE_EXP:
-            return &nodeFuncPositiveExp;
-        default:
-            return &nodeFuncNoop;
-    }
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "nodetypes.h"
+
+// lookup table for linear to exponential conversion that only converts positive
+// values (and eases of to 0 to allow maximum offness
+matrixint lookupTablePositiveExponential[matrixintrange];
+
+// reciprocals of 1 - 255 scaled by 2^15 and rounded up, so nodes can divide
+// with a multiply and a shift instead of the software division routine.
+const unsigned int reciprocals[RECIPROCAL_TABLE_SIZE] = {
+        0, 32768, 16384, 10923,  8192,  6554,  5462,  4682,
+     4096,  3641,  3277,  2979,  2731,  2521,  2341,  2185,
+     2048,  1928,  1821,  1725,  1639,  1561,  1490,  1425,
+     1366,  1311,  1261,  1214,  1171,  1130,  1093,  1058,
+     1024,   993,   964,   937,   911,   886,   863,   841,
+      820,   800,   781,   763,   745,   729,   713,   698,
+      683,   669,   656,   643,   631,   619,   607,   596,
+      586,   575,   565,   556,   547,   538,   529,   521,
+      512,   505,   497,   490,   482,   475,   469,   462,
+      456,   449,   443,   437,   432,   426,   421,   415,
+      410,   405,   400,   395,   391,   386,   382,   377,
+      373,   369,   365,   361,   357,   353,   349,   345,
+      342,   338,   335,   331,   328,   325,   322,   319,
+      316,   313,   310,   307,   304,   301,   298,   296,
+      293,   290,   288,   285,   283,   281,   278,   276,
+      274,   271,   269,   267,   265,   263,   261,   259,
+      256,   255,   253,   251,   249,   247,   245,   243,
+      241,   240,   238,   236,   235,   233,   231,   230,
+      228,   226,   225,   223,   222,   220,   219,   218,
+      216,   215,   213,   212,   211,   209,   208,   207,
+      205,   204,   203,   202,   200,   199,   198,   197,
+      196,   194,   193,   192,   191,   190,   189,   188,
+      187,   186,   185,   184,   183,   182,   181,   180,
+      179,   178,   177,   176,   175,   174,   173,   172,
+      171,   170,   169,   169,   168,   167,   166,   165,
+      164,   164,   163,   162,   161,   160,   160,   159,
+      158,   157,   157,   156,   155,   154,   154,   153,
+      152,   152,   151,   150,   149,   149,   148,   147,
+      147,   146,   145,   145,   144,   144,   143,   142,
+      142,   141,   141,   140,   139,   139,   138,   138,
+      137,   136,   136,   135,   135,   134,   134,   133,
+      133,   132,   132,   131,   131,   130,   130,   129
+};
+
+// a matrix with all its nodes and output buffers must fit in the RAM set aside
+// for the matrix.
+STATIC_ASSERT(sizeof(Matrix) + MAX_OPERATIONS * sizeof(Node)
+              + MAX_SH_OUTPUTS * 2 * sizeof(matrixint) <= MATRIX_RAM_BUDGET, matrix_fits_in_ram);
+
+// gate output pins are stored as bits in a single byte
+STATIC_ASSERT(MAX_GATE_OUTPUTS <= 8, gate_outputs_fit_in_port);
+
+// an attenuated operand holds the index of its Attenuation
+STATIC_ASSERT(MAX_OPERATIONS > matrixintmax || MAX_ATTENUATIONS <= matrixintmax, attenuations_fit_operand);
+
+// scales param1 by param2 / (MAX_POSITIVE + 1)
+matrixint scaleValues(matrixint param1, matrixint param2){
+    matrixlongint temp;
+
+    // special edge cases
+    if(param1 == MAX_POSITIVE && param2 == MAX_POSITIVE){
+        //prevents attenuation due to rounding error if both inputs are max positive
+        return MAX_POSITIVE;
+    } else if(param1 <= MAX_NEGATIVE+1 && param2 <= MAX_NEGATIVE+1 ){
+        //prevents overflow
+        return MAX_POSITIVE;
+    }
+
+    temp = param1 * param2;
+
+    //This leads to a slight error - the correct way to do it would be
+    //dividing the input by MAX_POSITIVE, but that is an expensive operation.
+    //Instead, we shift by 7, which is equal to dividing by MAX_POSITIV+1.
+    temp = temp >> 7;
+
+    return temp;
+}
+
+// scales a value by gain / (MAX_POSITIVE + 1) and adds offset, saturating.
+// Applied to attenuated params as they are read.
+matrixint attenuateValue(matrixint value, matrixint gain, matrixint offset){
+    matrixlongint sum;
+    sum = scaleValues(value, gain);
+    sum += offset;
+    if(sum > MAX_POSITIVE){
+        return MAX_POSITIVE;
+    } else if(sum < MAX_NEGATIVE){
+        return MAX_NEGATIVE;
+    }
+    return sum;
+}
+
+// next value of the random source of a matrix, a 16 bit Galois LFSR
+unsigned int matrixRandom(Matrix *aMatrix){
+    if(aMatrix->randomState & 0x0001){
+        aMatrix->randomState = (aMatrix->randomState >> 1) ^ 0xB400;
+    } else {
+        aMatrix->randomState = aMatrix->randomState >> 1;
+    }
+    return aMatrix->randomState;
+}
+
+// params can be pointers to the result of the previous Node in the matrix or
+// they can be constants. This function figures out which one and returns its
+// value, with the depth and offset applied if the param is attenuated. The
+// attenuation flag is only tested when the patch has attenuations, so patches
+// without them read node params as before.
+matrixint getParam(Matrix *aMatrix, Node *aNode, paramindex paramId){
+    paramindex operand;
+    unsigned short type;
+    Attenuation *anAttenuation;
+
+    operand = aNode->firstParam + paramId;
+#ifdef MATRIX_LINKED_OPERANDS
+    if(aMatrix->patchLinked == PATCH_LINKED){
+        return *aMatrix->linkedParams[operand];
+    } else if(aMatrix->patchLinked){
+        if((aMatrix->paramIsAttenuated[operand >> 3] >> (operand & 0x07)) & 0b00000001){
+            anAttenuation = &aMatrix->attenuations[aMatrix->params[operand]];
+            return attenuateValue(*aMatrix->linkedParams[operand], anAttenuation->gain, anAttenuation->offset);
+        }
+        return *aMatrix->linkedParams[operand];
+    }
+#endif
+    type = (aMatrix->paramIsConstant[operand >> 3] >> (operand & 0x07)) & 0b00000001;
+    if(type == 1){
+        return aMatrix->params[operand];
+    } else if(aMatrix->attenuationsInUse && ((aMatrix->paramIsAttenuated[operand >> 3] >> (operand & 0x07)) & 0b00000001)){
+        anAttenuation = &aMatrix->attenuations[aMatrix->params[operand]];
+        return attenuateValue(aMatrix->nodes[anAttenuation->source]->result, anAttenuation->gain, anAttenuation->offset);
+    } else {
+        //TODO will this work with a 16 bit param?
+        return aMatrix->nodes[aMatrix->params[operand]]->result;
+    }
+}
+
+// sum an arbitrary number of inputs.
+void nodeFuncSum(Matrix *aMatrix, Node *aNode){
+    paramindex i;
+    aNode->result = 0;
+    for(i=0; i<aNode->paramsInUse; i++){
+        aNode->result += getParam(aMatrix, aNode, i);
+    }
+}
+
+// multiply an arbitrary number of inputs.
+void nodeFuncMultiply(Matrix *aMatrix, Node *aNode){
+    paramindex i;
+    aNode->result = getParam(aMatrix, aNode, 0);
+    for(i=1; i<aNode->paramsInUse; i++){
+        aNode->result *= getParam(aMatrix, aNode, i);
+    }
+}
+
+// accepts a single input and inverts it.
+void nodeFuncInvert(Matrix *aMatrix, Node *aNode){
+    matrixint param;
+    param = getParam(aMatrix, aNode, 0);
+
+    //hack to allow whole range to be inverted. chops off top as 128 is not
+    //possible with an 8 bit signed variable.
+    if(param == MAX_NEGATIVE){
+        aNode->result = MAX_POSITIVE;
+    } else {
+        aNode->result = -param;
+    }
+}
+
+// accepts a single input and iverts it around the "center" (64 or -63) of the
+// side of 0 that the input is: 1 becomes 127 but -1 becomes -126.
+// usefull for inverting envelopes without turning them negative.
+void nodeFuncInvertEachSide(Matrix *aMatrix, Node *aNode){
+    matrixint param;
+    param = getParam(aMatrix, aNode, 0);
+
+    if(param >= 0){
+        aNode->result = MAX_POSITIVE - param;
+    } else {
+        aNode->result = MAX_NEGATIVE - 1 - param;
+    }
+}
+
+// Scale the per run increment of a time based node by the time passed since
+// the node last ran: 2^rateShift matrix runs, each lasting timeScale/256 of
+// the nominal run time. Saturates instead of overflowing. From the nominal
+// time scale up the increment can only grow, so it is saturated before the
+// multiply, which keeps the product within a long. Below it the increment is
+// at most 2^22 and the time scale below 2^8.
+int scaleIncrement(Matrix *aMatrix, Node *aNode, int increment){
+    long scaled;
+    scaled = increment;
+    scaled = scaled << aNode->rateShift;
+    if(aMatrix->timeScale >= TIME_SCALE_NOMINAL){
+        if(scaled > matrixlongintmax){
+            return matrixlongintmax;
+        } else if(scaled < matrixlongintmin){
+            return matrixlongintmin;
+        }
+    }
+    scaled = (scaled * aMatrix->timeScale) >> TIME_SCALE_SHIFT;
+    if(scaled > matrixlongintmax){
+        return matrixlongintmax;
+    } else if(scaled < matrixlongintmin){
+        return matrixlongintmin;
+    }
+    return scaled;
+}
+
+// calculate increment necessary to get the requested ramp timing.
+int calculateRampIncrement(matrixint setting, short direction, short bipolar){
+    int highResSetting = setting;
+    if(direction == 0){
+        highResSetting = -highResSetting;
+    }
+    return highResSetting << 8;
+}
+
+// Ramp function, takes three parameters:
+// - param[0]: timing
+// - param[1]: trigger, ramp is reset when trigger != 0
+// - param[2]: start position (may be runtime input or config), depends on paramIsConstant setting
+// - param[3]: bitfield
+//   - B0=shoudResetWhenFinished
+//   - B1=direction, 0=down, 1=up
+//   - B2=bipolar, 0=false (only positive numbers are used), 1=true (full range)
+void nodeFuncRamp(Matrix *aMatrix, Node *aNode){
+
+    int increment;
+    matrixint trigger, startPosition, settings;
+    unsigned short shouldResetWhenFinished, direction, bipolar;
+
+    trigger = getParam(aMatrix, aNode, 1);
+    startPosition = getParam(aMatrix, aNode, 2);
+    settings = getParam(aMatrix, aNode, 3);
+    shouldResetWhenFinished = settings & 0b00000001;
+
+    //TODO: Implement usage of these
+    direction = (settings >> 1) & 0b00000001;
+    bipolar = (settings >> 2) & 0b00000001;
+
+    if(trigger){
+        aNode->highResState = startPosition << 8;
+        aNode->state |= RUNNING;
+    } else {
+        increment = calculateRampIncrement(getParam(aMatrix, aNode, 0), direction, bipolar);
+        increment = scaleIncrement(aMatrix, aNode, increment);
+
+        //TODO: This may never reach max, is that a problem?
+        //      should possibly add max value before resetting
+        if(aNode->state & RUNNING){
+            if( direction == UP   && (aNode->highResState < 0 ||  32767 - aNode->highResState > increment) ||
+                direction == DOWN && (aNode->highResState > 0 || -32768 - aNode->highResState <= increment)){
+                aNode->highResState += increment;
+            } else {
+                aNode->state &= ~RUNNING;
+                if(shouldResetWhenFinished){
+                    aNode->highResState = startPosition << 8;
+                }
+            }
+        }
+    }
+    aNode->result = (aNode->highResState >> 8);
+}
+
+// A square/pulse wave LFO with settable speed, pulse width, positive and
+// negative amplitude, retrigger and start position
+void nodeFuncLfoPulse(Matrix *aMatrix, Node *aNode){
+    int step;
+    matrixint cyclelength = getParam(aMatrix, aNode, 0);
+    matrixint pulsewidth = getParam(aMatrix, aNode, 1);
+    matrixint trigger = getParam(aMatrix, aNode, 2);
+
+    //may be set to any value to limit amplitude and save using a scale shape.
+    matrixint positive = getParam(aMatrix, aNode, 3);
+    matrixint negative = getParam(aMatrix, aNode, 4);
+
+    matrixint settings = getParam(aMatrix, aNode, 5);
+
+    unsigned short startPosition;
+    startPosition = settings & 0b00000001; // 0 = bottom, 1 = top;
+
+    if(trigger){
+        if(startPosition){
+            aNode->result = positive;
+        } else {
+            aNode->result = negative;
+        }
+        aNode->highResState = 0;
+        aNode->auxState = 0;
+    } else {
+        // nodes running at a lower rate or at a slower dac rate step more than
+        // one at a time, the fraction of a step is kept in auxState. Check if
+        // the pulse width was passed and not just reached.
+        aNode->auxState += scaleIncrement(aMatrix, aNode, TIME_SCALE_NOMINAL);
+        step = aNode->auxState >> TIME_SCALE_SHIFT;
+        aNode->auxState &= TIME_SCALE_NOMINAL - 1;
+        aNode->highResState += step;
+        if(aNode->highResState >= cyclelength ||
+           aNode->highResState >= pulsewidth && aNode->highResState - step < pulsewidth){
+           //flip
+           if(aNode->result > 0 ){
+               aNode->result = negative;
+           } else {
+               aNode->result = positive;
+           }
+        }
+        if(aNode->highResState >= cyclelength){
+            aNode->highResState = 0;
+        }
+    }
+}
+
+// "delay line", stores the input for one cycle and uses it as feedback in the
+// next, makes it possible to make loops in the network (may not be necessary?
+// as one can use the value of any Node's previous result in the next run).
+//   NB: result should be set to 0 initially (or to whatever starting feedback
+//   one wants.
+void nodeFuncDelayLine(Matrix *aMatrix, Node *aNode){
+    aNode->result = getParam(aMatrix, aNode, 0);
+}
+
+// length in ticks of a delay buffer node. Its constant param 1 is read as
+// unsigned and holds the length - 1, so every value is a valid length.
+unsigned int getDelayLength(Matrix *aMatrix, Node *aNode){
+    return (aMatrix->params[aNode->firstParam + 1] & 0xFF) + 1;
+}
+
+// read the sample written age ticks ago, 1 - length
+matrixint readDelay(Matrix *aMatrix, Node *aNode, unsigned int length, unsigned int age){
+    int index;
+    index = aNode->auxState - age;
+    if(index < 0){
+        index += length;
+    }
+    return aMatrix->delayArena[aNode->highResState + index];
+}
+
+// delays input 0 by up to DELAY_MAX_LENGTH ticks.
+// Param 1 is the length of the buffer - 1, a constant.
+// Param 2 is optional and sets the delay from 1 tick at 0 to the length of
+// the buffer at MAX_POSITIVE, reading between samples with linear
+// interpolation. Without it the delay is the length of the buffer.
+// The samples are kept in the delay arena of the matrix from highResState
+// on, auxState is where the next sample is written, i.e. the oldest sample.
+void nodeFuncDelayBuffer(Matrix *aMatrix, Node *aNode){
+    unsigned int length, age, position;
+    matrixint position0, sample;
+    int difference;
+
+    length = getDelayLength(aMatrix, aNode);
+    if(aNode->paramsInUse < 3){
+        aNode->result = aMatrix->delayArena[aNode->highResState + aNode->auxState];
+    } else {
+        position0 = getParam(aMatrix, aNode, 2);
+        if(position0 < 0){
+            position0 = 0;
+        }
+
+        // delay in 1/128 ticks after the first tick
+        position = position0;
+        position = position * (length - 1);
+        age = (position >> 7) + 1;
+        sample = readDelay(aMatrix, aNode, length, age);
+        if(position & 0x7F){
+            difference = readDelay(aMatrix, aNode, length, age + 1) - sample;
+            difference = difference * (position & 0x7F);
+            sample += difference >> 7;
+        }
+        aNode->result = sample;
+    }
+
+    aMatrix->delayArena[aNode->highResState + aNode->auxState] = getParam(aMatrix, aNode, 0);
+    aNode->auxState++;
+    if(aNode->auxState == length){
+        aNode->auxState = 0;
+    }
+}
+
+// memory with set and clear, may be used as sample and hold
+// Set if param 1 > 0,
+// Clear if param 2 > 0 (resets to 0)
+void nodeFuncMemory(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode, 2)){
+        aNode->result = 0;
+    } else if(getParam(aMatrix, aNode, 1)){
+        aNode->result = getParam(aMatrix, aNode, 0);
+    }
+}
+
+// switch, passes value on input 0 when input 1 is true, reverts to 0 if not
+void nodeFuncSwitch(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode, 1)){
+        aNode->result = getParam(aMatrix, aNode, 0);
+    } else {
+        aNode->result = 0;
+    }
+}
+
+// compares parameter 0 to parameter 1. If 0 is larger, output is BINARY_TRUE,
+// if, not it is BINARY_FALSE
+void nodeFuncCompare(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode, 0) > getParam(aMatrix, aNode, 1)){
+        aNode->result = BINARY_TRUE;
+    } else {
+        aNode->result = BINARY_FALSE;
+    }
+}
+
+// returns the maximum of all inputs
+void nodeFuncMax(Matrix *aMatrix, Node *aNode){
+    paramindex i;
+    matrixint temp;
+
+    aNode->result = MAX_NEGATIVE;
+    for(i = 0; i<aNode->paramsInUse; i++){
+        temp = getParam(aMatrix, aNode, i);
+        if(temp > aNode->result){
+            aNode->result = temp;
+        }
+    }
+}
+
+// returns the minimum of all inputs
+void nodeFuncMin(Matrix *aMatrix, Node *aNode){
+    paramindex i;
+    matrixint temp;
+
+    aNode->result = MAX_POSITIVE;
+    for(i = 0; i<aNode->paramsInUse; i++){
+        temp = getParam(aMatrix, aNode, i);
+        if(temp < aNode->result){
+            aNode->result = temp;
+        }
+    }
+}
+
+// scales input 0 by input 1 / (MAX_POSITIVE + 1)
+void nodeFuncScale(Matrix *aMatrix, Node *aNode){
+    aNode->result = scaleValues(getParam(aMatrix, aNode, 0), getParam(aMatrix, aNode, 1));
+}
+
+// Divides a dividend up to 32767 by a divisor of 1 - 255 using the reciprocal
+// table. The product is at most one too large, which is checked with a
+// multiply so the result is the same as integer division. Larger divisors are
+// saturated to 255 to stay within the table.
+unsigned int divideMagnitude(unsigned int dividend, unsigned int divisor){
+    unsigned int quotient;
+    if(divisor >= RECIPROCAL_TABLE_SIZE){
+        divisor = RECIPROCAL_TABLE_SIZE - 1;
+    }
+    quotient = ((unsigned long)dividend * reciprocals[divisor]) >> 15;
+    if(quotient * divisor > dividend){
+        quotient--;
+    }
+    return quotient;
+}
+
+// Divides a signed sum by a count of 1 - 255, rounding towards 0 and
+// saturating to the matrix range.
+matrixint divideSaturated(matrixlongint sum, unsigned int divisor){
+    unsigned int quotient;
+    if(sum < 0){
+        quotient = divideMagnitude(-sum, divisor);
+        if(quotient > -MAX_NEGATIVE){
+            return MAX_NEGATIVE;
+        }
+        return -(int)quotient;
+    }
+    quotient = divideMagnitude(sum, divisor);
+    if(quotient > MAX_POSITIVE){
+        return MAX_POSITIVE;
+    }
+    return quotient;
+}
+
+// divides input 0 by input 1, rounding towards 0. Dividing by 0 saturates
+// in the direction of input 0.
+void nodeFuncDivide(Matrix *aMatrix, Node *aNode){
+    matrixint dividend, divisor;
+
+    dividend = getParam(aMatrix, aNode, 0);
+    divisor = getParam(aMatrix, aNode, 1);
+    if(divisor == 0){
+        if(dividend < 0){
+            aNode->result = MAX_NEGATIVE;
+        } else {
+            aNode->result = MAX_POSITIVE;
+        }
+    } else if(divisor < 0){
+        aNode->result = divideSaturated(-(matrixlongint)dividend, -divisor);
+    } else {
+        aNode->result = divideSaturated(dividend, divisor);
+    }
+}
+
+// returns the average of all inputs, rounding towards 0
+void nodeFuncAverage(Matrix *aMatrix, Node *aNode){
+    paramindex i;
+    matrixlongint sum;
+
+    if(aNode->paramsInUse == 0){
+        aNode->result = 0;
+        return;
+    }
+    sum = 0;
+    for(i = 0; i<aNode->paramsInUse; i++){
+        sum += getParam(aMatrix, aNode, i);
+    }
+    aNode->result = divideSaturated(sum, aNode->paramsInUse);
+}
+
+// limits input 0 to the range from input 1 to input 2. If the lower limit is
+// above the upper limit, the lower limit wins.
+void nodeFuncClamp(Matrix *aMatrix, Node *aNode){
+    matrixint value, limit;
+
+    value = getParam(aMatrix, aNode, 0);
+    limit = getParam(aMatrix, aNode, 2);
+    if(value > limit){
+        value = limit;
+    }
+    limit = getParam(aMatrix, aNode, 1);
+    if(value < limit){
+        value = limit;
+    }
+    aNode->result = value;
+}
+
+// fades from input 0 to input 1 as input 2 goes from MAX_NEGATIVE to
+// MAX_POSITIVE. The result always lies between the two inputs.
+void nodeFuncCrossfade(Matrix *aMatrix, Node *aNode){
+    matrixint from, to, position;
+    matrixlongint distance;
+
+    from = getParam(aMatrix, aNode, 0);
+    to = getParam(aMatrix, aNode, 1);
+    position = getParam(aMatrix, aNode, 2);
+    if(position == MAX_POSITIVE){
+        aNode->result = to;
+        return;
+    }
+
+    // position as 0 - 127, so the product fits in a matrixlongint
+    distance = to - from;
+    distance = distance * ((position >> 1) + 64);
+    aNode->result = from + (distance >> 7);
+}
+
+// returns the absolute value of input 0, MAX_NEGATIVE saturates to
+// MAX_POSITIVE.
+void nodeFuncAbs(Matrix *aMatrix, Node *aNode){
+    matrixint value;
+
+    value = getParam(aMatrix, aNode, 0);
+    if(value == MAX_NEGATIVE){
+        aNode->result = MAX_POSITIVE;
+    } else if(value < 0){
+        aNode->result = -value;
+    } else {
+        aNode->result = value;
+    }
+}
+
+// Generates a pulse (maximum output value) lasting for one iteration
+// after the input changes from negative to positive.
+void nodeFuncTrigger(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode, 0) > 0 ){
+        if(aNode->state == 0){
+            aNode->result = MAX_POSITIVE;
+            aNode->state = MAX_POSITIVE;
+        } else {
+            aNode->result = 0;
+        }
+    } else {
+        aNode->state = 0;
+    }
+}
+
+// pattern played by a sequencer node, param 1 limited to the patterns in use
+const SequencerPattern *getSequencerPattern(Matrix *aMatrix, Node *aNode){
+    matrixint pattern;
+    pattern = getParam(aMatrix, aNode, 1);
+    if(pattern < 0){
+        pattern = 0;
+    } else if((unsigned short)pattern >= aMatrix->patternsInUse){
+        pattern = aMatrix->patternsInUse - 1;
+    }
+    return &aMatrix->patterns[pattern];
+}
+
+// step a sequencer node moves to, in the direction set by param 2
+int getNextStep(Matrix *aMatrix, Node *aNode, unsigned short stepsInUse){
+    int step;
+
+    step = aNode->highResState;
+    switch(getParam(aMatrix, aNode, 2)){
+        case SEQUENCER_BACKWARD:
+            if(step <= 0){
+                return stepsInUse - 1;
+            }
+            return step - 1;
+        case SEQUENCER_PINGPONG:
+            // the first and last steps are not repeated when turning
+            if(stepsInUse == 1){
+                return 0;
+            }
+            if(aNode->state & SEQUENCER_BACKWARDS){
+                if(step > 0){
+                    return step - 1;
+                }
+                aNode->state &= ~SEQUENCER_BACKWARDS;
+                return 1;
+            }
+            if(step < stepsInUse - 1){
+                return step + 1;
+            }
+            aNode->state |= SEQUENCER_BACKWARDS;
+            return step - 1;
+        case SEQUENCER_RANDOM:
+            return ((matrixRandom(aMatrix) & 0xFF) * stepsInUse) >> 8;
+        default:
+            step++;
+            if(step >= stepsInUse){
+                return 0;
+            }
+            return step;
+    }
+}
+
+// Step sequencer playing a pattern from the patterns of the matrix. The
+// patterns stay in flash, steps are read in place.
+// Param 0 is the trigger, the sequencer moves on at a rising edge once the
+// current step has lasted its length.
+// Param 1 is the pattern, may be changed while running.
+// Param 2 is the direction, a constant, see SEQUENCER_FORWARD etc.
+// Param 3 is optional, a rising edge resets to before the first step.
+// Result is the value of the step, 0 before the first trigger. highResState
+// holds the step, auxState the triggers left of it and state the
+// SEQUENCER_ flags, the gate is read by sequencer gate nodes.
+void nodeFuncSequencer(Matrix *aMatrix, Node *aNode){
+    const SequencerPattern *pattern;
+    const SequencerStep *step;
+    unsigned short stepsInUse;
+
+    pattern = getSequencerPattern(aMatrix, aNode);
+    stepsInUse = pattern->stepsInUse;
+    if(aNode->highResState >= stepsInUse){
+        // the pattern changed to a shorter one
+        aNode->highResState = stepsInUse - 1;
+    }
+
+    if(aNode->paramsInUse > 3){
+        if(getParam(aMatrix, aNode, 3) > 0){
+            if(!(aNode->state & SEQUENCER_RESET_HIGH)){
+                aNode->state = (aNode->state | SEQUENCER_RESET_HIGH) & ~SEQUENCER_BACKWARDS;
+                aNode->highResState = SEQUENCER_NOT_STARTED;
+                aNode->auxState = 0;
+            }
+        } else {
+            aNode->state &= ~SEQUENCER_RESET_HIGH;
+        }
+    }
+
+    if(getParam(aMatrix, aNode, 0) > 0){
+        if(!(aNode->state & SEQUENCER_TRIGGER_HIGH)){
+            aNode->state |= SEQUENCER_TRIGGER_HIGH;
+            if(aNode->auxState > 1){
+                aNode->auxState--;
+            } else {
+                aNode->highResState = getNextStep(aMatrix, aNode, stepsInUse);
+                aNode->auxState = pattern->steps[aNode->highResState].length;
+            }
+        }
+    } else {
+        aNode->state &= ~SEQUENCER_TRIGGER_HIGH;
+    }
+
+    if(aNode->highResState == SEQUENCER_NOT_STARTED){
+        aNode->result = 0;
+        aNode->state &= ~SEQUENCER_GATE;
+        return;
+    }
+    step = &pattern->steps[aNode->highResState];
+    aNode->result = step->value;
+    if(step->gate){
+        aNode->state |= SEQUENCER_GATE;
+    } else {
+        aNode->state &= ~SEQUENCER_GATE;
+    }
+}
+
+// BINARY_TRUE while the current step of the sequencer node param 0 reads has
+// its gate set. Reads the state of the sequencer directly, like the mod
+// matrix reads its destinations, so the param must be a plain node param.
+void nodeFuncSequencerGate(Matrix *aMatrix, Node *aNode){
+    if(aMatrix->nodes[aMatrix->params[aNode->firstParam]]->state & SEQUENCER_GATE){
+        aNode->result = BINARY_TRUE;
+    } else {
+        aNode->result = BINARY_FALSE;
+    }
+}
+
+// treat input as a binary values and binary AND them
+void nodeFuncBinaryAnd(Matrix *aMatrix, Node *aNode){
+    paramindex paramNum;
+    aNode->result = BINARY_TRUE;
+    for(paramNum = 0; paramNum < aNode->paramsInUse; paramNum++){
+        if(getParam(aMatrix, aNode, paramNum) <= 0){
+            aNode->result = BINARY_FALSE;
+            break;
+        }
+    }
+}
+
+// treat input as a binary values and binary OR them
+void nodeFuncBinaryOr(Matrix *aMatrix, Node *aNode){
+    paramindex paramNum;
+    aNode->result = BINARY_FALSE;
+    for(paramNum = 0; paramNum < aNode->paramsInUse; paramNum++){
+        if(getParam(aMatrix, aNode, paramNum) > 0){
+            aNode->result = BINARY_TRUE;
+            break;
+        }
+    }
+}
+
+// treat input as a binary values and binary XOR them
+void nodeFuncBinaryXor(Matrix *aMatrix, Node *aNode){
+    unsigned short param0;
+    unsigned short param1;
+
+    param0 = getParam(aMatrix, aNode, 0) > 0;
+    param1 = getParam(aMatrix, aNode, 1) > 0;
+
+    if(param0 != param1){
+      aNode->result = BINARY_TRUE;
+    } else {
+      aNode->result = BINARY_FALSE;
+    }
+}
+
+// treat input as a binary value and binary INVERT it
+void nodeFuncBinaryNot(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode,0) > 0){
+        aNode->result = BINARY_FALSE;
+    } else {
+        aNode->result = BINARY_TRUE;
+    }
+}
+
+// fetch  input from inputBuffer and add it as the result of a Node to be used
+// in the matrix
+void nodeFuncInput(Matrix *aMatrix, Node *aNode){
+    aNode->result = aMatrix->inputBuffer[getParam(aMatrix, aNode, 0)];
+}
+
+// write output to outputBuffer
+void nodeFuncOutput(Matrix *aMatrix, Node *aNode){
+    aMatrix->outputBuffer[getParam(aMatrix, aNode, 0)] = getParam(aMatrix, aNode, 1);
+}
+
+// write a gate to a digital output pin. Pins are flushed to the port on every
+// dac tick instead of waiting for the S&H rotation.
+// - param[0]: pin
+// - param[1]: gate, pin is high when gate > 0
+void nodeFuncGateOutput(Matrix *aMatrix, Node *aNode){
+    unsigned short pinMask;
+    pinMask = 1 << getParam(aMatrix, aNode, 0);
+
+    if(getParam(aMatrix, aNode, 1) > 0){
+        aMatrix->gateBuffer |= pinMask;
+    } else {
+        aMatrix->gateBuffer &= ~pinMask;
+    }
+}
+
+// start a trigger pulse on a digital output pin after the input changes from
+// negative to positive. Pulse width is counted down by the dac interrupt.
+// - param[0]: pin
+// - param[1]: input
+// - param[2]: pulse width in dac ticks
+void nodeFuncTriggerOutput(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode, 1) > 0 ){
+        if(aNode->state == 0){
+            aMatrix->triggerCountdown[getParam(aMatrix, aNode, 0)] = getParam(aMatrix, aNode, 2);
+            aNode->state = MAX_POSITIVE;
+        }
+    } else {
+        aNode->state = 0;
+    }
+}
+
+//glide any output. resists change.
+void nodeFuncGlide(Matrix *aMatrix, Node *aNode){
+    matrixint input = getParam(aMatrix, aNode,0);
+    matrixlongint maxchange = getParam(aMatrix, aNode,1); // maximum rate of change - consider inverting this to get 0=no glide, max = max glide.
+    matrixint glideUp   = getParam(aMatrix, aNode,2); // should glide up?
+    matrixint glideDown = getParam(aMatrix, aNode,3); // should glide down?
+    matrixint change;
+
+    maxchange = scaleIncrement(aMatrix, aNode, maxchange);
+
+    change = input - aNode->result;
+    if(change > 0 && glideUp){ // input is larger than current output
+        if(change > maxchange){
+            aNode->result += maxchange;
+        } else {
+            aNode->result += change;
+        }
+    } else if(change < 0 && glideDown) { // input is smaller than current output
+        if(change < maxchange * -1){
+            aNode->result -= maxchange;
+        } else {
+            aNode->result += change;
+        }
+    } else {
+        aNode->result = input;
+    }
+}
+
+// calculate the linear slew step for a rate setting, in 1/128 LSB. The upper
+// three bits of the rate select an octave and the lower four bits divide it
+// linearly, so glide time roughly doubles for every 16 steps of rate.
+int calculateSlewStep(matrixint rate){
+    int step;
+    step = 32 - (rate & 0x0F);
+    step = step << 8;
+    return step >> (rate >> 4);
+}
+
+// calculate the change of a one pole (exponential) slew for a given positive
+// distance to the target, in 1/128 LSB. The upper three bits of the rate
+// select the shift, the lower bits shave off up to 7/16 of the change to get
+// settings in between two shifts. Only shifts and subtractions are used.
+int calculateSlewExponential(int distance, matrixint rate){
+    unsigned short shift;
+    int change;
+
+    shift = 1 + (rate >> 4);
+    change = distance >> shift;
+    if(rate & 0x08){
+        change -= distance >> (shift + 2);
+    }
+    if(rate & 0x04){
+        change -= distance >> (shift + 3);
+    }
+    if(rate & 0x02){
+        change -= distance >> (shift + 4);
+    }
+
+    // creep the last bit to make sure we actually reach the target
+    if(change == 0){
+        change = 1;
+    }
+    return change;
+}
+
+// slew limiter/glide with separate rise and fall rates, takes four parameters:
+// - param[0]: input
+// - param[1]: rise rate, 0 = no glide, 127 = slowest glide
+// - param[2]: fall rate, 0 = no glide, 127 = slowest glide
+// - param[3]: mode, SLEW_LINEAR, SLEW_EXPONENTIAL or SLEW_CONSTANT_TIME
+// The output is kept in highResState with SLEW_FRACTION_BITS bits below the
+// LSB so slow glides do not stair step. In constant time mode the glide always
+// takes 2^(rate/16) iterations: state holds the input we are gliding towards
+// and auxState the step size needed to get there. Steps are scaled by the time
+// since the last run, so glide time does not depend on node or dac rate.
+void nodeFuncSlew(Matrix *aMatrix, Node *aNode){
+    matrixint input, rate;
+    int target, distance, change;
+
+    input = getParam(aMatrix, aNode, 0);
+    target = input << SLEW_FRACTION_BITS;
+    distance = target - aNode->highResState;
+
+    if(distance > 0){
+        rate = getParam(aMatrix, aNode, 1);
+    } else {
+        rate = getParam(aMatrix, aNode, 2);
+        distance = -distance;
+    }
+
+    if(distance == 0 || rate <= 0){
+        aNode->highResState = target;
+    } else {
+        switch(getParam(aMatrix, aNode, 3)){
+            case SLEW_EXPONENTIAL:
+                change = calculateSlewExponential(distance, rate);
+                break;
+            case SLEW_CONSTANT_TIME:
+                if(aNode->state != input || aNode->auxState == 0){
+                    aNode->state = input;
+                    aNode->auxState = distance >> (rate >> 4);
+                    if(aNode->auxState == 0){
+                        aNode->auxState = 1;
+                    }
+                }
+                change = aNode->auxState;
+                break;
+            default:
+                change = calculateSlewStep(rate);
+        }
+        change = scaleIncrement(aMatrix, aNode, change);
+        if(change == 0){
+            change = 1;
+        }
+
+        if(change >= distance){
+            aNode->highResState = target;
+        } else if(target > aNode->highResState){
+            aNode->highResState += change;
+        } else {
+            aNode->highResState -= change;
+        }
+    }
+    aNode->result = (aNode->highResState + SLEW_ROUNDING) >> SLEW_FRACTION_BITS;
+}
+
+void nodeFuncQuantize(Matrix *aMatrix, Node *aNode){
+     //TODO
+}
+
+// Convert linear value to exponential. Only positive values are converted,
+// all others are 0, to allow maximum offness.
+void nodeFuncPositiveExp(Matrix *aMatrix, Node *aNode){
+    matrixint input = getParam(aMatrix, aNode,0);
+    if(input > 0){
+        aNode->result = lookupTablePositiveExponential[input];
+    } else {
+        aNode->result = 0;
+    }
+}
+
+// Modulation matrix, routes any number of sources to any number of
+// destinations in one node. Only routes in use are stored, as rows of params:
+// - param[n]: destination, the NODE_MOD_DESTINATION node to write to
+// - param[n+1]: number of routes to the destination, constant
+// - param[n+2], param[n+3]: source and amount of the first route, the source
+//   is scaled by amount / (MAX_POSITIVE + 1)
+// - ... more routes, then the next row
+// The scaled sources are summed without overflow, as a row can hold at most
+// MAX_POSITIVE routes, and the sum is saturated when it is written.
+void nodeFuncModMatrix(Matrix *aMatrix, Node *aNode){
+    paramindex param;
+    matrixint routes;
+    matrixlongint sum;
+    Node *destination;
+
+    param = 0;
+    while(param < aNode->paramsInUse){
+        destination = aMatrix->nodes[aMatrix->params[aNode->firstParam + param]];
+        routes = getParam(aMatrix, aNode, param + 1);
+        param += 2;
+
+        sum = 0;
+        while(routes > 0){
+            sum += scaleValues(getParam(aMatrix, aNode, param), getParam(aMatrix, aNode, param + 1));
+            param += 2;
+            routes--;
+        }
+
+        if(sum > MAX_POSITIVE){
+            destination->result = MAX_POSITIVE;
+        } else if(sum < MAX_NEGATIVE){
+            destination->result = MAX_NEGATIVE;
+        } else {
+            destination->result = sum;
+        }
+    }
+}
+
+// Holds one destination of a modulation matrix. The result is written by the
+// NODE_MOD_MATRIX node routing to it, so other nodes can read it like any
+// other result.
+void nodeFuncModDestination(Matrix *aMatrix, Node *aNode){}
+
+// Fused input -> scale -> output, created by fusePatch(). Does not set a result
+// as output nodes don't have one.
+// - param[0]: input index
+// - param[1]: scale factor
+// - param[2]: output index
+void nodeFuncFusedInputScaleOutput(Matrix *aMatrix, Node *aNode){
+    matrixint input;
+    input = aMatrix->inputBuffer[getParam(aMatrix, aNode, 0)];
+    aMatrix->outputBuffer[getParam(aMatrix, aNode, 2)] = scaleValues(input, getParam(aMatrix, aNode, 1));
+}
+
+// Fused input -> sum with offset -> scale, created by fusePatch().
+// - param[0]: input index
+// - param[1]: offset
+// - param[2]: scale factor
+void nodeFuncFusedInputOffsetScale(Matrix *aMatrix, Node *aNode){
+    matrixint sum;
+    sum = aMatrix->inputBuffer[getParam(aMatrix, aNode, 0)];
+    sum += getParam(aMatrix, aNode, 1);
+    aNode->result = scaleValues(sum, getParam(aMatrix, aNode, 2));
+}
+
+// Fused compare -> trigger, created by fusePatch(). Generates a trigger pulse
+// when param 0 becomes larger than param 1.
+void nodeFuncFusedCompareTrigger(Matrix *aMatrix, Node *aNode){
+    if(getParam(aMatrix, aNode, 0) > getParam(aMatrix, aNode, 1)){
+        if(aNode->state == 0){
+            aNode->result = MAX_POSITIVE;
+            aNode->state = MAX_POSITIVE;
+        } else {
+            aNode->result = 0;
+        }
+    } else {
+        aNode->state = 0;
+    }
+}
+
+// do nothing
+void nodeFuncNoop(Matrix *aMatrix, Node *aNode){}
+
+// precalculate a 70dB exponential curve for positive input values.
+void precalcPositiveExponentialLookup(){
+
+    // dB calculation
+    // The maximum attenuation is found like this:
+    //  * Change in dB = 20 * log(Output/Input)
+    //  * Output = Input * 10^(Change in dB / 20)
+    // For -70dB:
+    //  * Output = Input * 10^(-70 / 20) = Input * 0.000316
+    //
+    // To calculate the curve we have that:
+    // f(0) = 0.000316
+    // f(max) = 1;
+    //
+    unsigned short i;
+    lookupTablePositiveExponential[0] = 0;
+    for(i=1; i<=matrixintmax; i++){
+        lookupTablePositiveExponential[i] = 0;
+    }
+}
+
+// add Node to the matrix. The params of the node are added to the operand pool
+// afterwards, using addConstantParam/addNodeParam, and must all be added before
+// the next node is added.
+void addNode(Matrix *aMatrix, Node *aNode){
+    aMatrix->patchLinked = 0;
+    aNode->firstParam = aMatrix->paramsInPool;
+    aNode->paramsInUse = 0;
+    aNode->rateShift = 0;
+    aNode->rateCountdown = 0;
+    if(aMatrix->nodesInUse == MAX_OPERATIONS){
+        aMatrix->patchStatus = PATCH_TOO_MANY_NODES;
+        return;
+    }
+    aMatrix->nodes[aMatrix->nodesInUse] = aNode;
+    aMatrix->nodesInUse++;
+}
+
+// append a param to the operand pool and mark whether it is a constant or the
+// index of the node to get the result from.
+void addParam(Matrix *aMatrix, Node *aNode, operandint value, unsigned short isConstant){
+    unsigned short mask;
+    aMatrix->patchLinked = 0;
+    if(aMatrix->paramsInPool == MAX_OPERANDS){
+        aMatrix->patchStatus = PATCH_TOO_MANY_PARAMS;
+        return;
+    }
+    mask = 1 << (aMatrix->paramsInPool & 0x07);
+
+    aMatrix->params[aMatrix->paramsInPool] = value;
+    if(isConstant){
+        aMatrix->paramIsConstant[aMatrix->paramsInPool >> 3] |= mask;
+    } else {
+        aMatrix->paramIsConstant[aMatrix->paramsInPool >> 3] &= ~mask;
+    }
+    aMatrix->paramIsAttenuated[aMatrix->paramsInPool >> 3] &= ~mask;
+    aMatrix->paramsInPool++;
+    aNode->paramsInUse++;
+}
+
+// add a constant param to the last node added
+void addConstantParam(Matrix *aMatrix, Node *aNode, matrixint value){
+    addParam(aMatrix, aNode, value, 1);
+}
+
+// add a param that reads the result of the node at nodeIndex
+void addNodeParam(Matrix *aMatrix, Node *aNode, nodeindex nodeIndex){
+    addParam(aMatrix, aNode, nodeIndex, 0);
+}
+
+// Returns 1 if a param of a mod matrix holds the destination or the number of
+// routes of a row, see nodeFuncModMatrix().
+unsigned short isModMatrixRowParam(Matrix *aMatrix, Node *aNode, paramindex paramId){
+    paramindex param;
+    param = 0;
+    while(param < aNode->paramsInUse){
+        if(paramId == param || paramId == param + 1){
+            return 1;
+        }
+        param += 2 + aMatrix->params[aNode->firstParam + param + 1] * 2;
+    }
+    return 0;
+}
+
+// Check a new value of a param before setParam() writes it, so a running
+// patch stays as valid as checkPatch() left it: node indexes must be in the
+// matrix, a sequencer gate must read a sequencer, and input, output, pattern
+// and direction indexes must be in range. The length of a delay buffer and the
+// destinations and route counts of a mod matrix cannot be changed, the patch
+// has to be built again. Returns PATCH_OK or the error checkPatch() would give.
+unsigned short checkParamChange(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint value){
+    paramindex operand;
+    unsigned short size;
+    unsigned short error;
+
+    if(paramId >= aNode->paramsInUse){
+        return PATCH_MISSING_PARAMS;
+    }
+    operand = aNode->firstParam + paramId;
+    if(!((aMatrix->paramIsConstant[operand >> 3] >> (operand & 0x07)) & 0b00000001)){
+        if(value < 0 || value >= aMatrix->nodesInUse){
+            return PATCH_INVALID_NODE_INDEX;
+        }
+        if(aNode->func == &nodeFuncSequencerGate && aMatrix->nodes[value]->func != &nodeFuncSequencer){
+            return PATCH_INVALID_SEQUENCER;
+        }
+        if(aNode->func == &nodeFuncModMatrix && isModMatrixRowParam(aMatrix, aNode, paramId)){
+            return PATCH_INVALID_ROUTING;
+        }
+        return PATCH_OK;
+    }
+
+    size = 0;
+    error = PATCH_INVALID_OUTPUT;
+    if(aNode->func == &nodeFuncInput || aNode->func == &nodeFuncFusedInputOffsetScale){
+        if(paramId == 0){
+            size = MAX_INPUTS;
+            error = PATCH_INVALID_INPUT;
+        }
+    } else if(aNode->func == &nodeFuncOutput){
+        if(paramId == 0){
+            size = MAX_SH_OUTPUTS;
+        }
+    } else if(aNode->func == &nodeFuncFusedInputScaleOutput){
+        if(paramId == 0){
+            size = MAX_INPUTS;
+            error = PATCH_INVALID_INPUT;
+        } else if(paramId == 2){
+            size = MAX_SH_OUTPUTS;
+        }
+    } else if(aNode->func == &nodeFuncGateOutput || aNode->func == &nodeFuncTriggerOutput){
+        if(paramId == 0){
+            size = MAX_GATE_OUTPUTS;
+        }
+    } else if(aNode->func == &nodeFuncSequencer){
+        if(paramId == 1 && (value < 0 || value >= aMatrix->patternsInUse)){
+            return PATCH_INVALID_SEQUENCER;
+        }
+        if(paramId == 2 && (value < 0 || value >= SEQUENCER_DIRECTIONS)){
+            return PATCH_INVALID_SEQUENCER;
+        }
+    } else if(aNode->func == &nodeFuncDelayBuffer){
+        if(paramId == 1 && value != aMatrix->params[aNode->firstParam + 1]){
+            return PATCH_INVALID_DELAY;
+        }
+    } else if(aNode->func == &nodeFuncModMatrix){
+        if(isModMatrixRowParam(aMatrix, aNode, paramId)){
+            return PATCH_INVALID_ROUTING;
+        }
+    }
+
+    if(size && (value < 0 || value >= size)){
+        return error;
+    }
+    return PATCH_OK;
+}
+
+// Change the value of a param, e.g. when a knob is turned. Returns PATCH_OK,
+// or the error found by checkParamChange() and leaves the param unchanged.
+unsigned short setParam(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint value){
+    paramindex operand;
+    unsigned short status;
+
+    status = checkParamChange(aMatrix, aNode, paramId, value);
+    if(status != PATCH_OK){
+        return status;
+    }
+
+    operand = aNode->firstParam + paramId;
+    if((aMatrix->paramIsAttenuated[operand >> 3] >> (operand & 0x07)) & 0b00000001){
+        // the operand holds the attenuation, the node index is kept there
+        aMatrix->attenuations[aMatrix->params[operand]].source = value;
+        aMatrix->patchLinked = 0;
+        return PATCH_OK;
+    }
+    aMatrix->params[operand] = value;
+#ifdef MATRIX_LINKED_OPERANDS
+    // constants can be changed in place, a new node index must be checked
+    // before it is linked again.
+    if((aMatrix->paramIsConstant[operand >> 3] >> (operand & 0x07)) & 0b00000001){
+        aMatrix->linkedConstants[operand] = value;
+    } else {
+        aMatrix->patchLinked = 0;
+    }
+#endif
+    return PATCH_OK;
+}
+
+// Run a node every 2^rateShift matrix runs instead of on every run. Used for
+// nodes that only change slowly, such as LFOs, knobs and logic, while pitch and
+// envelope paths keep running at full rate. Time based nodes scale their
+// increments by the same amount. Call staggerNodeRates() when the patch is
+// complete.
+void setNodeRate(Node *aNode, unsigned short rateShift){
+    if(rateShift > MAX_RATE_SHIFT){
+        rateShift = MAX_RATE_SHIFT;
+    }
+    aNode->rateShift = rateShift;
+}
+
+// Spread the nodes that run at the same lower rate evenly over the matrix runs
+// in between, so the cost of running them is the same on every matrix run
+// instead of everything running at once.
+void staggerNodeRates(Matrix *aMatrix){
+    nodeindex i;
+    Node *aNode;
+    unsigned short nodesAtRate[MAX_RATE_SHIFT + 1];
+
+    for(i = 0; i<=MAX_RATE_SHIFT; i++){
+        nodesAtRate[i] = 0;
+    }
+
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        aNode->rateCountdown = nodesAtRate[aNode->rateShift] & ((1 << aNode->rateShift) - 1);
+        nodesAtRate[aNode->rateShift]++;
+    }
+}
+
+// returns 1 if param is a constant, 0 if it is the index of a node
+unsigned short isConstantParam(Matrix *aMatrix, Node *aNode, paramindex paramId){
+    paramindex operand;
+    operand = aNode->firstParam + paramId;
+    return (aMatrix->paramIsConstant[operand >> 3] >> (operand & 0x07)) & 0b00000001;
+}
+
+// returns 1 if param reads a node through an Attenuation
+unsigned short isAttenuatedParam(Matrix *aMatrix, Node *aNode, paramindex paramId){
+    paramindex operand;
+    operand = aNode->firstParam + paramId;
+    return (aMatrix->paramIsAttenuated[operand >> 3] >> (operand & 0x07)) & 0b00000001;
+}
+
+// Give a param reading a node a depth and offset: the result it reads is
+// scaled by gain / (MAX_POSITIVE + 1), inverted if gain is negative, and
+// offset is added. Calling it again on the same param changes the depth in
+// place, e.g. when a knob is turned. Returns 0 if the param is a constant or
+// not in use, or if all MAX_ATTENUATIONS are used.
+unsigned short attenuateParam(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint gain, matrixint offset){
+    paramindex operand;
+    Attenuation *anAttenuation;
+
+    operand = aNode->firstParam + paramId;
+    if(paramId >= aNode->paramsInUse || isConstantParam(aMatrix, aNode, paramId)){
+        return 0;
+    }
+    if(isAttenuatedParam(aMatrix, aNode, paramId)){
+        anAttenuation = &aMatrix->attenuations[aMatrix->params[operand]];
+    } else {
+        if(aMatrix->attenuationsInUse == MAX_ATTENUATIONS){
+            return 0;
+        }
+        anAttenuation = &aMatrix->attenuations[aMatrix->attenuationsInUse];
+        anAttenuation->source = aMatrix->params[operand];
+        aMatrix->params[operand] = aMatrix->attenuationsInUse;
+        aMatrix->paramIsAttenuated[operand >> 3] |= 1 << (operand & 0x07);
+        aMatrix->attenuationsInUse++;
+        aMatrix->patchLinked = 0;
+    }
+    anAttenuation->gain = gain;
+    anAttenuation->offset = offset;
+    return 1;
+}
+
+// Give a delay buffer node its part of the delay arena, cleared to 0.
+// checkPatch() has made sure the length is a constant and that it fits.
+void allocateDelay(Matrix *aMatrix, Node *aNode){
+    unsigned int length, i;
+
+    length = getDelayLength(aMatrix, aNode);
+    aNode->highResState = aMatrix->delayArenaInUse;
+    aNode->auxState = 0;
+    for(i = 0; i<length; i++){
+        aMatrix->delayArena[aMatrix->delayArenaInUse + i] = 0;
+    }
+    aMatrix->delayArenaInUse += length;
+}
+
+// checks that a param used as an index into a buffer is a constant within
+// range, so the node never has to check the index while the matrix runs.
+unsigned short isValidIndexParam(Matrix *aMatrix, Node *aNode, paramindex paramId, unsigned short size){
+    operandint index;
+    if(aNode->paramsInUse <= paramId || !isConstantParam(aMatrix, aNode, paramId)){
+        return 0;
+    }
+    index = aMatrix->params[aNode->firstParam + paramId];
+    return index >= 0 && index < size;
+}
+
+// Check the params of a sequencer node. Every pattern must have 1 -
+// SEQUENCER_MAX_STEPS steps. Returns PATCH_OK or PATCH_INVALID_SEQUENCER.
+unsigned short validateSequencer(Matrix *aMatrix, Node *aNode){
+    unsigned short pattern, stepsInUse;
+
+    if(aNode->paramsInUse < 3 || aMatrix->patternsInUse == 0){
+        return PATCH_INVALID_SEQUENCER;
+    }
+    if(isConstantParam(aMatrix, aNode, 1) && !isValidIndexParam(aMatrix, aNode, 1, aMatrix->patternsInUse)){
+        return PATCH_INVALID_SEQUENCER;
+    }
+    if(!isValidIndexParam(aMatrix, aNode, 2, SEQUENCER_DIRECTIONS)){
+        return PATCH_INVALID_SEQUENCER;
+    }
+    for(pattern = 0; pattern<aMatrix->patternsInUse; pattern++){
+        stepsInUse = aMatrix->patterns[pattern].stepsInUse;
+        if(stepsInUse == 0 || stepsInUse > SEQUENCER_MAX_STEPS){
+            return PATCH_INVALID_SEQUENCER;
+        }
+    }
+
+    return PATCH_OK;
+}
+
+// start a sequencer node from before the first step
+void startSequencer(Node *aNode){
+    aNode->highResState = SEQUENCER_NOT_STARTED;
+    aNode->auxState = 0;
+    aNode->state = 0;
+}
+
+// The sequencer gate param must be a plain node param reading a sequencer
+// node. Returns PATCH_OK or PATCH_INVALID_SEQUENCER.
+unsigned short validateSequencerGate(Matrix *aMatrix, Node *aNode){
+    if(aNode->paramsInUse < 1 || isConstantParam(aMatrix, aNode, 0) || isAttenuatedParam(aMatrix, aNode, 0)){
+        return PATCH_INVALID_SEQUENCER;
+    }
+    if(aMatrix->nodes[aMatrix->params[aNode->firstParam]]->func != &nodeFuncSequencer){
+        return PATCH_INVALID_SEQUENCER;
+    }
+    return PATCH_OK;
+}
+
+// Check the rows of a modulation matrix, see nodeFuncModMatrix(). Returns
+// PATCH_OK or PATCH_INVALID_ROUTING.
+unsigned short validateModMatrix(Matrix *aMatrix, Node *aNode){
+    paramindex param;
+    operandint destination;
+    matrixint routes;
+
+    // params are read with an unsigned short param id
+    if(aNode->paramsInUse > 255){
+        return PATCH_INVALID_ROUTING;
+    }
+
+    param = 0;
+    while(param < aNode->paramsInUse){
+        if(param + 2 > aNode->paramsInUse || isConstantParam(aMatrix, aNode, param)
+           || isAttenuatedParam(aMatrix, aNode, param) || !isConstantParam(aMatrix, aNode, param + 1)){
+            return PATCH_INVALID_ROUTING;
+        }
+        destination = aMatrix->params[aNode->firstParam + param];
+        if(aMatrix->nodes[destination]->func != &nodeFuncModDestination){
+            return PATCH_INVALID_ROUTING;
+        }
+        routes = aMatrix->params[aNode->firstParam + param + 1];
+        if(routes < 0 || aNode->paramsInUse - param - 2 < routes * 2){
+            return PATCH_INVALID_ROUTING;
+        }
+        param += 2 + routes * 2;
+    }
+    return PATCH_OK;
+}
+
+// Check the patch once it has been built, without changing it. Verifies that
+// it fits in the matrix, that every param that reads another node points to a
+// node in the matrix, and that inputs and outputs only use constant indexes
+// within the buffers. This makes bounds checks while running the matrix
+// unnecessary. Returns PATCH_OK or the error found, patchErrorNode holds the
+// index of the offending node.
+unsigned short checkPatch(Matrix *aMatrix){
+    nodeindex i;
+    paramindex param;
+    Node *aNode;
+    operandint index;
+    unsigned int delayArenaNeeded;
+
+    if(aMatrix->patchStatus != PATCH_OK){
+        aMatrix->patchErrorNode = aMatrix->nodesInUse;
+        return aMatrix->patchStatus;
+    }
+    delayArenaNeeded = 0;
+
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        aMatrix->patchErrorNode = i;
+
+        for(param = 0; param < aNode->paramsInUse; param++){
+            if(!isConstantParam(aMatrix, aNode, param)){
+                index = aMatrix->params[aNode->firstParam + param];
+                if(isAttenuatedParam(aMatrix, aNode, param)){
+                    if(index < 0 || index >= aMatrix->attenuationsInUse){
+                        return PATCH_INVALID_NODE_INDEX;
+                    }
+                    index = aMatrix->attenuations[index].source;
+                }
+                if(index < 0 || index >= aMatrix->nodesInUse){
+                    return PATCH_INVALID_NODE_INDEX;
+                }
+            }
+        }
+
+        if(aNode->func == &nodeFuncInput){
+            if(!isValidIndexParam(aMatrix, aNode, 0, MAX_INPUTS)){
+                return PATCH_INVALID_INPUT;
+            }
+        } else if(aNode->func == &nodeFuncOutput){
+            if(!isValidIndexParam(aMatrix, aNode, 0, MAX_SH_OUTPUTS)){
+                return PATCH_INVALID_OUTPUT;
+            }
+            if(aNode->paramsInUse < 2){
+                return PATCH_MISSING_PARAMS;
+            }
+        } else if(aNode->func == &nodeFuncFusedInputScaleOutput){
+            if(!isValidIndexParam(aMatrix, aNode, 0, MAX_INPUTS)){
+                return PATCH_INVALID_INPUT;
+            }
+            if(!isValidIndexParam(aMatrix, aNode, 2, MAX_SH_OUTPUTS)){
+                return PATCH_INVALID_OUTPUT;
+            }
+        } else if(aNode->func == &nodeFuncFusedInputOffsetScale){
+            if(!isValidIndexParam(aMatrix, aNode, 0, MAX_INPUTS)){
+                return PATCH_INVALID_INPUT;
+            }
+        } else if(aNode->func == &nodeFuncGateOutput){
+            if(!isValidIndexParam(aMatrix, aNode, 0, MAX_GATE_OUTPUTS)){
+                return PATCH_INVALID_OUTPUT;
+            }
+            if(aNode->paramsInUse < 2){
+                return PATCH_MISSING_PARAMS;
+            }
+        } else if(aNode->func == &nodeFuncTriggerOutput){
+            if(!isValidIndexParam(aMatrix, aNode, 0, MAX_GATE_OUTPUTS)){
+                return PATCH_INVALID_OUTPUT;
+            }
+            if(aNode->paramsInUse < 3){
+                return PATCH_MISSING_PARAMS;
+            }
+        } else if(aNode->func == &nodeFuncAverage){
+            if(aNode->paramsInUse >= RECIPROCAL_TABLE_SIZE){
+                return PATCH_TOO_MANY_PARAMS;
+            }
+        } else if(aNode->func == &nodeFuncModMatrix){
+            if(validateModMatrix(aMatrix, aNode) != PATCH_OK){
+                return PATCH_INVALID_ROUTING;
+            }
+        } else if(aNode->func == &nodeFuncSequencer){
+            if(validateSequencer(aMatrix, aNode) != PATCH_OK){
+                return PATCH_INVALID_SEQUENCER;
+            }
+        } else if(aNode->func == &nodeFuncSequencerGate){
+            if(validateSequencerGate(aMatrix, aNode) != PATCH_OK){
+                return PATCH_INVALID_SEQUENCER;
+            }
+        } else if(aNode->func == &nodeFuncDelayBuffer){
+            if(aNode->paramsInUse < 2 || !isConstantParam(aMatrix, aNode, 1)){
+                return PATCH_INVALID_DELAY;
+            }
+            delayArenaNeeded += getDelayLength(aMatrix, aNode);
+            if(delayArenaNeeded > DELAY_ARENA_SIZE){
+                return PATCH_DELAY_ARENA_FULL;
+            }
+        }
+    }
+    return PATCH_OK;
+}
+
+// Check the patch with checkPatch() and get it ready to run: delay buffer
+// nodes are given their part of the delay arena and sequencers start from
+// before their first step, so validating again clears all delays and
+// sequencers. Returns the result of checkPatch().
+unsigned short validatePatch(Matrix *aMatrix){
+    nodeindex i;
+    Node *aNode;
+    unsigned short status;
+
+    status = checkPatch(aMatrix);
+    if(status != PATCH_OK){
+        return status;
+    }
+
+    aMatrix->delayArenaInUse = 0;
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        if(aNode->func == &nodeFuncDelayBuffer){
+            allocateDelay(aMatrix, aNode);
+        } else if(aNode->func == &nodeFuncSequencer){
+            startSequencer(aNode);
+        }
+    }
+    return PATCH_OK;
+}
+
+// Returns the index of the node a param reads from, or MAX_OPERATIONS if the
+// param is a constant or not in use.
+nodeindex getParamNode(Matrix *aMatrix, Node *aNode, paramindex paramId){
+    if(paramId >= aNode->paramsInUse || isConstantParam(aMatrix, aNode, paramId)){
+        return MAX_OPERATIONS;
+    }
+    if(isAttenuatedParam(aMatrix, aNode, paramId)){
+        return aMatrix->attenuations[aMatrix->params[aNode->firstParam + paramId]].source;
+    }
+    return aMatrix->params[aNode->firstParam + paramId];
+}
+
+// Returns the node at index if it is still in the matrix and runs the given
+// node function, 0 if not.
+Node *getNodeOfType(Matrix *aMatrix, nodeindex index, nodeFunction func){
+    if(index >= aMatrix->nodesInUse || aMatrix->nodes[index] == 0){
+        return 0;
+    }
+    if(aMatrix->nodes[index]->func != func){
+        return 0;
+    }
+    return aMatrix->nodes[index];
+}
+
+// Returns 1 if a mod matrix between positions "from" and "to" in the node list
+// writes the result of the node at index, see nodeFuncModMatrix().
+unsigned short isModDestinationWritten(Matrix *aMatrix, nodeindex index, nodeindex from, nodeindex to){
+    nodeindex i;
+    paramindex param;
+    Node *aNode;
+
+    for(i = from + 1; i < to; i++){
+        aNode = aMatrix->nodes[i];
+        if(aNode == 0 || aNode->func != &nodeFuncModMatrix){
+            continue;
+        }
+        param = 0;
+        while(param < aNode->paramsInUse){
+            if(aMatrix->params[aNode->firstParam + param] == index){
+                return 1;
+            }
+            param += 2 + aMatrix->params[aNode->firstParam + param + 1] * 2;
+        }
+    }
+    return 0;
+}
+
+// Returns 1 if moving a param read from position "from" in the node list to
+// position "to" changes what it reads, which is the case if it reads a node
+// that runs in between, or a mod destination written by a mod matrix that
+// runs in between.
+unsigned short isParamReadMoved(Matrix *aMatrix, Node *aNode, paramindex paramId, nodeindex from, nodeindex to){
+    nodeindex index;
+    index = getParamNode(aMatrix, aNode, paramId);
+    if(index == MAX_OPERATIONS){
+        return 0;
+    }
+    if(index > from && index < to){
+        return 1;
+    }
+    return aMatrix->nodes[index] != 0 && aMatrix->nodes[index]->func == &nodeFuncModDestination
+        && isModDestinationWritten(aMatrix, index, from, to);
+}
+
+// Returns 1 if two nodes run on the same matrix runs
+unsigned short isSameRate(Node *aNode, Node *anotherNode){
+    return aNode->rateShift == anotherNode->rateShift && aNode->rateCountdown == anotherNode->rateCountdown;
+}
+
+// Replace the params of a node with params copied from other nodes. Source
+// params are given as pairs of node and param id. The new params are added at
+// the end of the operand pool and moved in place by compactPatch().
+unsigned short replaceParams(Matrix *aMatrix, Node *aNode, unsigned short paramCount, Node **sourceNodes, unsigned short *sourceParams){
+    unsigned short i;
+    paramindex operand;
+    operandint values[FUSED_MAX_PARAMS];
+    unsigned short isConstant[FUSED_MAX_PARAMS];
+    unsigned short isAttenuated[FUSED_MAX_PARAMS];
+
+    if(aMatrix->paramsInPool + paramCount > MAX_OPERANDS){
+        return 0;
+    }
+
+    for(i = 0; i<paramCount; i++){
+        values[i] = aMatrix->params[sourceNodes[i]->firstParam + sourceParams[i]];
+        isConstant[i] = isConstantParam(aMatrix, sourceNodes[i], sourceParams[i]);
+        isAttenuated[i] = isAttenuatedParam(aMatrix, sourceNodes[i], sourceParams[i]);
+    }
+
+    aNode->firstParam = aMatrix->paramsInPool;
+    aNode->paramsInUse = 0;
+    for(i = 0; i<paramCount; i++){
+        // attenuated params keep their attenuation
+        operand = aMatrix->paramsInPool;
+        addParam(aMatrix, aNode, values[i], isConstant[i]);
+        if(isAttenuated[i]){
+            aMatrix->paramIsAttenuated[operand >> 3] |= 1 << (operand & 0x07);
+        }
+    }
+    return 1;
+}
+
+// Remove nodes taken out by fusePatch() from the node list and the operand
+// pool, and point params that read nodes to their new index.
+void compactPatch(Matrix *aMatrix){
+    nodeindex i, nodeCount;
+    nodeindex newIndex[MAX_OPERATIONS];
+    paramindex param, from, to;
+    unsigned short isConstant, isAttenuated;
+    Attenuation *anAttenuation;
+    Node *aNode;
+
+    nodeCount = 0;
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        newIndex[i] = nodeCount;
+        if(aMatrix->nodes[i] != 0){
+            aMatrix->nodes[nodeCount] = aMatrix->nodes[i];
+            nodeCount++;
+        }
+    }
+    for(i = nodeCount; i<aMatrix->nodesInUse; i++){
+        aMatrix->nodes[i] = 0;
+    }
+    aMatrix->nodesInUse = nodeCount;
+
+    // params only ever move towards the start of the pool, so they can be
+    // copied in place. Attenuations stay where they are, those of removed
+    // params are left unused.
+    to = 0;
+    for(i = 0; i<nodeCount; i++){
+        aNode = aMatrix->nodes[i];
+        from = aNode->firstParam;
+        aNode->firstParam = to;
+        for(param = 0; param < aNode->paramsInUse; param++){
+            isConstant = (aMatrix->paramIsConstant[from >> 3] >> (from & 0x07)) & 0b00000001;
+            isAttenuated = (aMatrix->paramIsAttenuated[from >> 3] >> (from & 0x07)) & 0b00000001;
+            aMatrix->params[to] = aMatrix->params[from];
+            if(isAttenuated){
+                aMatrix->paramIsAttenuated[to >> 3] |= 1 << (to & 0x07);
+            } else {
+                aMatrix->paramIsAttenuated[to >> 3] &= ~(1 << (to & 0x07));
+            }
+            if(isConstant){
+                aMatrix->paramIsConstant[to >> 3] |= 1 << (to & 0x07);
+            } else if(isAttenuated){
+                aMatrix->paramIsConstant[to >> 3] &= ~(1 << (to & 0x07));
+                anAttenuation = &aMatrix->attenuations[aMatrix->params[to]];
+                anAttenuation->source = newIndex[anAttenuation->source];
+            } else {
+                aMatrix->paramIsConstant[to >> 3] &= ~(1 << (to & 0x07));
+                aMatrix->params[to] = newIndex[aMatrix->params[to]];
+            }
+            from++;
+            to++;
+        }
+    }
+    aMatrix->paramsInPool = to;
+    aMatrix->patchLinked = 0;
+    aMatrix->nextNode = 0;
+}
+
+// Replace common chains of nodes with a single fused node that does the same
+// work without dispatching and fetching params for every step:
+// - input -> scale -> output
+// - input -> sum with one offset -> scale
+// - compare -> trigger
+// Chains are only fused if the results of the removed nodes are not read by
+// any other node, all nodes run at the same rate and moving the reads of the
+// removed nodes to the position of the last node does not change what they
+// read. The last node of the chain is turned into the fused node, so its result
+// and state stay where other nodes expect them. Run after validatePatch() and
+// before staggerNodeRates(). Removed nodes must not be changed with setParam()
+// afterwards. Returns the number of nodes removed.
+nodeindex fusePatch(Matrix *aMatrix){
+    nodeindex i, first, second, removed;
+    paramindex param;
+    unsigned short reads[MAX_OPERATIONS];
+    unsigned short secondParam;
+    Node *aNode, *firstNode, *secondNode;
+    Node *sourceNodes[FUSED_MAX_PARAMS];
+    unsigned short sourceParams[FUSED_MAX_PARAMS];
+
+    // count how many times each node result is read. Fused nodes read their
+    // chain directly, so attenuated reads count twice to keep them out of it.
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        reads[i] = 0;
+    }
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        for(param = 0; param < aNode->paramsInUse; param++){
+            first = getParamNode(aMatrix, aNode, param);
+            if(first != MAX_OPERATIONS){
+                reads[first]++;
+                if(isAttenuatedParam(aMatrix, aNode, param)){
+                    reads[first]++;
+                }
+            }
+        }
+    }
+
+    removed = 0;
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+
+        if(aNode->func == &nodeFuncOutput){
+            // input -> scale -> output
+            second = getParamNode(aMatrix, aNode, 1);
+            secondNode = getNodeOfType(aMatrix, second, &nodeFuncScale);
+            if(secondNode == 0 || reads[second] != 1 || !isSameRate(aNode, secondNode)){
+                continue;
+            }
+            secondParam = 1;
+            first = getParamNode(aMatrix, secondNode, 0);
+            firstNode = getNodeOfType(aMatrix, first, &nodeFuncInput);
+            if(firstNode == 0){
+                secondParam = 0;
+                first = getParamNode(aMatrix, secondNode, 1);
+                firstNode = getNodeOfType(aMatrix, first, &nodeFuncInput);
+            }
+            if(firstNode == 0 || reads[first] != 1 || !isSameRate(aNode, firstNode) ||
+               isParamReadMoved(aMatrix, secondNode, secondParam, second, i)){
+                continue;
+            }
+            sourceNodes[0] = firstNode;  sourceParams[0] = 0;
+            sourceNodes[1] = secondNode; sourceParams[1] = secondParam;
+            sourceNodes[2] = aNode;      sourceParams[2] = 0;
+            if(!replaceParams(aMatrix, aNode, 3, sourceNodes, sourceParams)){
+                continue;
+            }
+            aNode->func = &nodeFuncFusedInputScaleOutput;
+
+        } else if(aNode->func == &nodeFuncScale){
+            // input -> sum with offset -> scale
+            secondParam = 1;
+            second = getParamNode(aMatrix, aNode, 0);
+            secondNode = getNodeOfType(aMatrix, second, &nodeFuncSum);
+            if(secondNode == 0){
+                secondParam = 0;
+                second = getParamNode(aMatrix, aNode, 1);
+                secondNode = getNodeOfType(aMatrix, second, &nodeFuncSum);
+            }
+            if(secondNode == 0 || reads[second] != 1 || secondNode->paramsInUse != 2 || !isSameRate(aNode, secondNode)){
+                continue;
+            }
+            first = getParamNode(aMatrix, secondNode, 0);
+            firstNode = getNodeOfType(aMatrix, first, &nodeFuncInput);
+            param = 1;
+            if(firstNode == 0){
+                first = getParamNode(aMatrix, secondNode, 1);
+                firstNode = getNodeOfType(aMatrix, first, &nodeFuncInput);
+                param = 0;
+            }
+            if(firstNode == 0 || reads[first] != 1 || !isSameRate(aNode, firstNode) ||
+               isParamReadMoved(aMatrix, secondNode, param, second, i)){
+                continue;
+            }
+            sourceNodes[0] = firstNode;  sourceParams[0] = 0;
+            sourceNodes[1] = secondNode; sourceParams[1] = param;
+            sourceNodes[2] = aNode;      sourceParams[2] = secondParam;
+            if(!replaceParams(aMatrix, aNode, 3, sourceNodes, sourceParams)){
+                continue;
+            }
+            aNode->func = &nodeFuncFusedInputOffsetScale;
+
+        } else if(aNode->func == &nodeFuncTrigger){
+            // compare -> trigger
+            first = getParamNode(aMatrix, aNode, 0);
+            firstNode = getNodeOfType(aMatrix, first, &nodeFuncCompare);
+            if(firstNode == 0 || reads[first] != 1 || !isSameRate(aNode, firstNode) ||
+               isParamReadMoved(aMatrix, firstNode, 0, first, i) ||
+               isParamReadMoved(aMatrix, firstNode, 1, first, i)){
+                continue;
+            }
+            sourceNodes[0] = firstNode; sourceParams[0] = 0;
+            sourceNodes[1] = firstNode; sourceParams[1] = 1;
+            if(!replaceParams(aMatrix, aNode, 2, sourceNodes, sourceParams)){
+                continue;
+            }
+            aNode->func = &nodeFuncFusedCompareTrigger;
+            second = first; // only one node removed
+        } else {
+            continue;
+        }
+
+        // take the fused nodes out of the matrix
+        aMatrix->nodes[first] = 0;
+        removed++;
+        if(second != first){
+            aMatrix->nodes[second] = 0;
+            removed++;
+        }
+    }
+
+    if(removed){
+        compactPatch(aMatrix);
+    }
+    return removed;
+}
+
+// Resolve all operands of a valid patch to pointers, so getParam() does not
+// have to look up constants and node results on every read. Only links when
+// MATRIX_LINKED_OPERANDS is set, otherwise params are looked up as before.
+// Must be called again after the patch is changed, until then params are
+// looked up. Attenuated params point to the node they read and are attenuated
+// as they are read, patches without them skip that check. The patch keeps its
+// state, so a running patch can be linked. Returns the result of checkPatch().
+unsigned short linkPatch(Matrix *aMatrix){
+    unsigned short status;
+#ifdef MATRIX_LINKED_OPERANDS
+    nodeindex i;
+    paramindex param, operand;
+    Node *aNode;
+    unsigned short linked;
+#endif
+
+    aMatrix->patchLinked = 0;
+    status = checkPatch(aMatrix);
+    if(status != PATCH_OK){
+        return status;
+    }
+
+#ifdef MATRIX_LINKED_OPERANDS
+    linked = PATCH_LINKED;
+    for(i = 0; i<aMatrix->nodesInUse; i++){
+        aNode = aMatrix->nodes[i];
+        for(param = 0; param < aNode->paramsInUse; param++){
+            operand = aNode->firstParam + param;
+            if(isConstantParam(aMatrix, aNode, param)){
+                aMatrix->linkedConstants[operand] = aMatrix->params[operand];
+                aMatrix->linkedParams[operand] = &aMatrix->linkedConstants[operand];
+            } else {
+                aMatrix->linkedParams[operand] = &aMatrix->nodes[getParamNode(aMatrix, aNode, param)]->result;
+                if(isAttenuatedParam(aMatrix, aNode, param)){
+                    linked = PATCH_LINKED_ATTENUATED;
+                }
+            }
+        }
+    }
+    aMatrix->patchLinked = linked;
+#endif
+    return PATCH_OK;
+}
+
+// Run the next sliceNodes nodes of the patch, continuing where the previous
+// slice stopped. When the last node has run the results are published like
+// at the end of runMatrix() and the next slice starts a new run. Returns 1 if
+// the run was completed by this slice, 0 if there are nodes left.
+// timeScale must stay the same for all slices of a run.
+unsigned short runMatrixSlice(Matrix *aMatrix, nodeindex sliceNodes){
+    nodeindex i, end;
+    Node *aNode;
+
+    end = aMatrix->nodesInUse;
+    if(end - aMatrix->nextNode > sliceNodes){
+        end = aMatrix->nextNode + sliceNodes;
+    }
+
+    for(i = aMatrix->nextNode; i<end; i++){
+      aNode = aMatrix->nodes[i];
+      if(aNode->rateCountdown){
+          // node runs at a lower rate and is not due yet, keep previous result
+          aNode->rateCountdown--;
+      } else {
+          aNode->func(aMatrix, aNode);
+          aNode->rateCountdown = (1 << aNode->rateShift) - 1;
+      }
+    }
+
+    if(end < aMatrix->nodesInUse){
+        aMatrix->nextNode = end;
+        return 0;
+    }
+
+    // all nodes have written their data to the output buffer, tell
+    // dac loop that new data can be loaded when dac cycle restarts
+    aMatrix->nextNode = 0;
+    aMatrix->matrixCalculationCompleted = 1;
+    return 1;
+}
+
+// loop over the matrix array once and calculate all results
+void runMatrix(Matrix *aMatrix){
+    aMatrix->nextNode = 0;
+    runMatrixSlice(aMatrix, aMatrix->nodesInUse);
+}
+
+extern void resetMatrix(Matrix *aMatrix){
+    nodeindex i;
+    for(i=0; i<MAX_OPERATIONS; i++){
+        aMatrix->nodes[i] = 0;
+    }
+    aMatrix->nodesInUse = 0;
+    aMatrix->paramsInPool = 0;
+    aMatrix->attenuationsInUse = 0;
+    aMatrix->delayArenaInUse = 0;
+    aMatrix->patterns = 0;
+    aMatrix->patternsInUse = 0;
+    aMatrix->randomState = MATRIX_RANDOM_SEED;
+    aMatrix->patchStatus = PATCH_OK;
+    aMatrix->patchLinked = 0;
+    aMatrix->nextNode = 0;
+    aMatrix->matrixCalculationCompleted = 0;
+    aMatrix->timeScale = TIME_SCALE_NOMINAL;
+}
+
+nodeFunction getFunctionPointer(unsigned short function){
+    switch(function){
+        case NODE_SUM:
+            return &nodeFuncSum;
+        case NODE_INVERT:
+            return &nodeFuncInvert;
+        case NODE_INVERT_EACH_SIDE:
+            return &nodeFuncInvertEachSide;
+        case NODE_RAMP:
+            return &nodeFuncRamp;
+        case NODE_DELAY_LINE:
+            return &nodeFuncDelayLine;
+        case NODE_INPUT:
+            return &nodeFuncInput;
+        case NODE_OUTPUT:
+            return &nodeFuncOutput;
+        case NODE_MULTIPLY:
+            return &nodeFuncMultiply;
+        case NODE_MEMORY:
+            return &nodeFuncMemory;
+        case NODE_LFO_PULSE:
+            return &nodeFuncLfoPulse;
+        case NODE_SWITCH:
+            return &nodeFuncSwitch;
+        case NODE_COMPARE:
+            return &nodeFuncCompare;
+        case NODE_MAX:
+            return &nodeFuncMax;
+        case NODE_MIN:
+            return &nodeFuncMin;
+        case NODE_SCALE:
+            return &nodeFuncScale;
+        case NODE_TRIGGER:
+            return &nodeFuncTrigger;
+        case NODE_BINARY_AND:
+            return &nodeFuncBinaryAnd;
+        case NODE_BINARY_OR:
+            return &nodeFuncBinaryOr;
+        case NODE_BINARY_XOR:
+            return &nodeFuncBinaryXor;
+        case NODE_BINARY_NOT:
+            return &nodeFuncBinaryNot;
+        case NODE_GLIDE:
+            return &nodeFuncGlide;
+        case NODE_QUANTIZE:
+            return &nodeFuncNoop;
+        case NODE_TUNE:
+            return &nodeFuncNoop;
+        case NODE_POSITIVE_EXP:
+            return &nodeFuncPositiveExp;
+        case NODE_GATE_OUTPUT:
+            return &nodeFuncGateOutput;
+        case NODE_TRIGGER_OUTPUT:
+            return &nodeFuncTriggerOutput;
+        case NODE_SLEW:
+            return &nodeFuncSlew;
+        case NODE_FUSED_INPUT_SCALE_OUTPUT:
+            return &nodeFuncFusedInputScaleOutput;
+        case NODE_FUSED_INPUT_OFFSET_SCALE:
+            return &nodeFuncFusedInputOffsetScale;
+        case NODE_FUSED_COMPARE_TRIGGER:
+            return &nodeFuncFusedCompareTrigger;
+        case NODE_MOD_MATRIX:
+            return &nodeFuncModMatrix;
+        case NODE_MOD_DESTINATION:
+            return &nodeFuncModDestination;
+        case NODE_DIVIDE:
+            return &nodeFuncDivide;
+        case NODE_AVERAGE:
+            return &nodeFuncAverage;
+        case NODE_CLAMP:
+            return &nodeFuncClamp;
+        case NODE_CROSSFADE:
+            return &nodeFuncCrossfade;
+        case NODE_ABS:
+            return &nodeFuncAbs;
+        case NODE_DELAY_BUFFER:
+            return &nodeFuncDelayBuffer;
+        case NODE_SEQUENCER:
+            return &nodeFuncSequencer;
+        case NODE_SEQUENCER_GATE:
+            return &nodeFuncSequencerGate;
+        default:
+            return &nodeFuncNoop;
+    }
+}
+
+// find the node type of a node function, the reverse of getFunctionPointer().
+// Slow, only meant for analysing a patch when it is loaded. Returns NODE_TYPES
+// if the function is unknown.
+unsigned short getFunctionType(nodeFunction func){
+    unsigned short type;
+    for(type = 0; type < NODE_TYPES; type++){
+        if(getFunctionPointer(type) == func){
+            return type;
+        }
+    }
+    return NODE_TYPES;
 }
\ No newline at end of file
@@ -1,13 +1,24 @@
-#ifndef _MATRIX_H
-#define _MATRIX_H
-
-#include "types.h"
-
-extern matrixint inputBuffer[8];
-extern unsigned short matrixCalculationCompleted;
-extern void addNode(Node *aNode);
-extern void runMatrix();
-extern void resetMatrix();
-nodeFunction getFunctionPointer(unsigned short function);
-
+#ifndef _MATRIX_H
+#define _MATRIX_H
+
+#include "types.h"
+
+extern void addNode(Matrix *aMatrix, Node *aNode);
+extern void addConstantParam(Matrix *aMatrix, Node *aNode, matrixint value);
+extern void addNodeParam(Matrix *aMatrix, Node *aNode, nodeindex nodeIndex);
+extern unsigned short setParam(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint value);
+extern unsigned short attenuateParam(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint gain, matrixint offset);
+extern unsigned short checkPatch(Matrix *aMatrix);
+extern unsigned short validatePatch(Matrix *aMatrix);
+extern nodeindex fusePatch(Matrix *aMatrix);
+extern unsigned short linkPatch(Matrix *aMatrix);
+extern void setNodeRate(Node *aNode, unsigned short rateShift);
+extern void staggerNodeRates(Matrix *aMatrix);
+extern void runMatrix(Matrix *aMatrix);
+extern unsigned short runMatrixSlice(Matrix *aMatrix, nodeindex sliceNodes);
+extern void resetMatrix(Matrix *aMatrix);
+nodeFunction getFunctionPointer(unsigned short function);
+unsigned short getFunctionType(nodeFunction func);
+unsigned short isAttenuatedParam(Matrix *aMatrix, Node *aNode, paramindex paramId);
+
 #endif
\ No newline at end of file
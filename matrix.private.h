@@ -1,32 +1,88 @@
-#ifndef _MATRIX_PRIVATE_H
-#define _MATRIX_PRIVATE_H
-
-#include "types.h"
-
-matrixint getParam(Node *aNode, unsigned short paramId);
-void nodeFuncSum(Node *aNode);
-void nodeFuncMultiply(Node *aNode);
-void nodeFuncInvert(Node *aNode);
-void nodeFuncInvertEachSide(Node *aNode);
-int calculateRampIncrement(matrixint setting, short direction, short bipolar);
-void nodeFuncRamp(Node *aNode);
-void nodeFuncLfoPulse(Node *aNode);
-void nodeFuncDelayLine(Node *aNode);
-void nodeFuncMemory(Node *aNode);
-void nodeFuncSwitch(Node *aNode);
-void nodeFuncCompare(Node *aNode);
-void nodeFuncMax(Node *aNode);
-void nodeFuncMin(Node *aNode);
-void nodeFuncScale(Node *aNode);
-void nodeFuncTrigger(Node *aNode);
-void nodeFuncBinaryAnd(Node *aNode);
-void nodeFuncBinaryOr(Node *aNode);
-void nodeFuncBinaryXor(Node *aNode);
-void nodeFuncBinaryNot(Node *aNode);
-void nodeFuncInput(Node *aNode);
-void nodeFuncOutput(Node *aNode);
-void nodeFuncNoop(Node *aNode);
-void addNode(Node *aNode);
-void runMatrix();
-
+#ifndef _MATRIX_PRIVATE_H
+#define _MATRIX_PRIVATE_H
+
+#include "types.h"
+
+unsigned int matrixRandom(Matrix *aMatrix);
+matrixint getParam(Matrix *aMatrix, Node *aNode, paramindex paramId);
+void nodeFuncSum(Matrix *aMatrix, Node *aNode);
+void nodeFuncMultiply(Matrix *aMatrix, Node *aNode);
+void nodeFuncInvert(Matrix *aMatrix, Node *aNode);
+void nodeFuncInvertEachSide(Matrix *aMatrix, Node *aNode);
+int scaleIncrement(Matrix *aMatrix, Node *aNode, int increment);
+int calculateRampIncrement(matrixint setting, short direction, short bipolar);
+void nodeFuncRamp(Matrix *aMatrix, Node *aNode);
+void nodeFuncLfoPulse(Matrix *aMatrix, Node *aNode);
+void nodeFuncDelayLine(Matrix *aMatrix, Node *aNode);
+unsigned int getDelayLength(Matrix *aMatrix, Node *aNode);
+matrixint readDelay(Matrix *aMatrix, Node *aNode, unsigned int length, unsigned int age);
+void nodeFuncDelayBuffer(Matrix *aMatrix, Node *aNode);
+void nodeFuncMemory(Matrix *aMatrix, Node *aNode);
+void nodeFuncSwitch(Matrix *aMatrix, Node *aNode);
+void nodeFuncCompare(Matrix *aMatrix, Node *aNode);
+void nodeFuncMax(Matrix *aMatrix, Node *aNode);
+void nodeFuncMin(Matrix *aMatrix, Node *aNode);
+void nodeFuncScale(Matrix *aMatrix, Node *aNode);
+unsigned int divideMagnitude(unsigned int dividend, unsigned int divisor);
+matrixint divideSaturated(matrixlongint sum, unsigned int divisor);
+void nodeFuncDivide(Matrix *aMatrix, Node *aNode);
+void nodeFuncAverage(Matrix *aMatrix, Node *aNode);
+void nodeFuncClamp(Matrix *aMatrix, Node *aNode);
+void nodeFuncCrossfade(Matrix *aMatrix, Node *aNode);
+void nodeFuncAbs(Matrix *aMatrix, Node *aNode);
+void nodeFuncTrigger(Matrix *aMatrix, Node *aNode);
+const SequencerPattern *getSequencerPattern(Matrix *aMatrix, Node *aNode);
+int getNextStep(Matrix *aMatrix, Node *aNode, unsigned short stepsInUse);
+void nodeFuncSequencer(Matrix *aMatrix, Node *aNode);
+void nodeFuncSequencerGate(Matrix *aMatrix, Node *aNode);
+void nodeFuncBinaryAnd(Matrix *aMatrix, Node *aNode);
+void nodeFuncBinaryOr(Matrix *aMatrix, Node *aNode);
+void nodeFuncBinaryXor(Matrix *aMatrix, Node *aNode);
+void nodeFuncBinaryNot(Matrix *aMatrix, Node *aNode);
+void nodeFuncInput(Matrix *aMatrix, Node *aNode);
+void nodeFuncOutput(Matrix *aMatrix, Node *aNode);
+void nodeFuncGateOutput(Matrix *aMatrix, Node *aNode);
+void nodeFuncTriggerOutput(Matrix *aMatrix, Node *aNode);
+int calculateSlewStep(matrixint rate);
+int calculateSlewExponential(int distance, matrixint rate);
+void nodeFuncSlew(Matrix *aMatrix, Node *aNode);
+matrixint scaleValues(matrixint param1, matrixint param2);
+matrixint attenuateValue(matrixint value, matrixint gain, matrixint offset);
+void nodeFuncFusedInputScaleOutput(Matrix *aMatrix, Node *aNode);
+void nodeFuncFusedInputOffsetScale(Matrix *aMatrix, Node *aNode);
+void nodeFuncFusedCompareTrigger(Matrix *aMatrix, Node *aNode);
+void nodeFuncModMatrix(Matrix *aMatrix, Node *aNode);
+void nodeFuncModDestination(Matrix *aMatrix, Node *aNode);
+unsigned short validateModMatrix(Matrix *aMatrix, Node *aNode);
+void nodeFuncNoop(Matrix *aMatrix, Node *aNode);
+void addNode(Matrix *aMatrix, Node *aNode);
+void addParam(Matrix *aMatrix, Node *aNode, operandint value, unsigned short isConstant);
+void addConstantParam(Matrix *aMatrix, Node *aNode, matrixint value);
+void addNodeParam(Matrix *aMatrix, Node *aNode, nodeindex nodeIndex);
+unsigned short isModMatrixRowParam(Matrix *aMatrix, Node *aNode, paramindex paramId);
+unsigned short checkParamChange(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint value);
+unsigned short setParam(Matrix *aMatrix, Node *aNode, paramindex paramId, matrixint value);
+nodeindex getParamNode(Matrix *aMatrix, Node *aNode, paramindex paramId);
+Node *getNodeOfType(Matrix *aMatrix, nodeindex index, nodeFunction func);
+unsigned short isModDestinationWritten(Matrix *aMatrix, nodeindex index, nodeindex from, nodeindex to);
+unsigned short isParamReadMoved(Matrix *aMatrix, Node *aNode, paramindex paramId, nodeindex from, nodeindex to);
+unsigned short isSameRate(Node *aNode, Node *anotherNode);
+unsigned short replaceParams(Matrix *aMatrix, Node *aNode, unsigned short paramCount, Node **sourceNodes, unsigned short *sourceParams);
+void compactPatch(Matrix *aMatrix);
+nodeindex fusePatch(Matrix *aMatrix);
+unsigned short linkPatch(Matrix *aMatrix);
+unsigned short isConstantParam(Matrix *aMatrix, Node *aNode, paramindex paramId);
+unsigned short isAttenuatedParam(Matrix *aMatrix, Node *aNode, paramindex paramId);
+void allocateDelay(Matrix *aMatrix, Node *aNode);
+unsigned short validateSequencer(Matrix *aMatrix, Node *aNode);
+void startSequencer(Node *aNode);
+unsigned short validateSequencerGate(Matrix *aMatrix, Node *aNode);
+unsigned short isValidIndexParam(Matrix *aMatrix, Node *aNode, paramindex paramId, unsigned short size);
+unsigned short checkPatch(Matrix *aMatrix);
+unsigned short validatePatch(Matrix *aMatrix);
+void setNodeRate(Node *aNode, unsigned short rateShift);
+void staggerNodeRates(Matrix *aMatrix);
+unsigned short runMatrixSlice(Matrix *aMatrix, nodeindex sliceNodes);
+void runMatrix(Matrix *aMatrix);
+
 #endif
\ No newline at end of file
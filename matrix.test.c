@@ -1,568 +1,1747 @@
-#include "test/munit.h"
-#include "test/asserts.h"
-#include "nodetypes.h"
-#include "matrix.private.h"
-#include "matrix.h"
-#include "definitions.h"
-
-void testSum(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_SUM);
-    aNode.params[0] = 1;
-    aNode.params[1] = 2;
-    aNode.params[2] = 4;
-    aNode.paramsInUse = 3;
-    aNode.paramIsConstant = 0b00000111;
-    addNode(&aNode);
-    
-    runMatrix();
-    
-    assertEquals(7,aNode.result,"sum");
-}
-
-void testMultiply(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_MULTIPLY);
-    aNode.params[0] = 2;
-    aNode.params[1] = 4;
-    aNode.params[2] = 8;
-    aNode.paramsInUse = 3;
-    aNode.paramIsConstant = 0b00000111;
-    addNode(&aNode);
-    
-    runMatrix();
-
-    assertEquals(64,aNode.result,"product");
-}
-
-void testInvertPositive(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT);
-    aNode.params[0] = 10;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(-10,aNode.result,"invert positive");
-}
-
-void testInvertNegative(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT);
-    aNode.params[0] = -10;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(10,aNode.result,"invert negative");
-}
-
-// special case as max positive is 1 less than max negative
-void testInvertMaxNegative(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT);
-    aNode.params[0] = MAX_NEGATIVE;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(MAX_POSITIVE,aNode.result,"invert max negative");
-}
-
-void testInvertZero(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT);
-    aNode.params[0] = 0;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(0,aNode.result,"invert zero");
-}
-
-void testInvertEachSideZero(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT_EACH_SIDE);
-    aNode.params[0] = 0;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(MAX_POSITIVE,aNode.result,"invert each side zero");
-}
-
-void testInvertEachSidePositive(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT_EACH_SIDE);
-    aNode.params[0] = MAX_POSITIVE;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(0,aNode.result,"invert each side positive");
-}
-
-void testInvertEachSideNegative(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_INVERT_EACH_SIDE);
-    aNode.params[0] = MAX_NEGATIVE;
-    aNode.paramIsConstant = 0b00000001;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(-1,aNode.result,"invert each side negative");
-}
-
-void testDelayLine(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_DELAY_LINE);
-    aNode.params[0] = 10;
-    aNode.paramIsConstant = 0b00000001;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    assertEquals(0,aNode.result,"delay line precondition");
-    
-    runMatrix();
-
-    assertEquals(10,aNode.result,"delay line");
-}
-
-void testMemorySet(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_MEMORY);
-    aNode.params[0] = 10;
-    aNode.params[1] = 1; // should set
-    aNode.params[2] = 0; // should not clear
-    aNode.paramIsConstant = 0b00000111;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(10,aNode.result,"memory set");
-}
-
-void testMemoryHold(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_MEMORY);
-    aNode.result = 5; //value to hold - leave unchanged
-    aNode.params[0] = 10;
-    aNode.params[1] = 0; // should not set
-    aNode.params[2] = 0; // should not clear
-    aNode.paramIsConstant = 0b00000111;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(5,aNode.result,"memory hold");
-}
-
-void testMemoryClear(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_MEMORY);
-    aNode.result = 7; //initial value
-    aNode.params[0] = 10;
-    aNode.params[1] = 0; // should not set
-    aNode.params[2] = 1; // should clear
-    aNode.paramIsConstant = 0b00000111;
-    addNode(&aNode);
-
-    runMatrix();
-
-    assertEquals(0,aNode.result,"memory hold");
-}
-
-void testLfoPulse(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
-    aNode.params[0] = 3; // cycle width = 3
-    aNode.params[1] = 2; // pulse width = 2
-    aNode.params[2] = 1; // trigger pulse start (not necessary though)
-    aNode.params[3] = 10; // max positive
-    aNode.params[4] = -5; // max negative
-    aNode.params[5] = 0b00000001; // start on top
-    aNode.paramIsConstant = 0b00111111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix(); // on the first run, trigger should cause the output to go high and reset the iteration counter
-
-    assertEquals(10,aNode.result,"LFO Pulse trigger");
-    assertEquals(0,aNode.highResState,"LFO Pulse init iterator");
-    
-    aNode.params[2] = 0; // remove trigger
-
-    runMatrix();
-
-    // after one cycle, nothing should have changed except the counter
-    assertEquals(10,aNode.result,"LFO Pulse step 2");
-    assertEquals(1,aNode.highResState,"LFO Pulse iterator increment");
-
-    runMatrix();
-    
-    // after two cycles we should have reached the pulse length and the lfo should drop to its minimum value
-    assertEquals(-5,aNode.result,"LFO Pulse step 3");
-
-    runMatrix();
-
-    // after three cycles, we should be back to start:
-    assertEquals(10,aNode.result,"LFO Pulse step 4");
-    assertEquals(0,aNode.highResState,"LFO Pulse iterator reset");
-
-}
-
-void testLfoPulseRetrigger(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
-    aNode.params[0] = 3; // cycle width = 3
-    aNode.params[1] = 2; // pulse width = 2
-    aNode.params[2] = 1; // trigger pulse start (not necessary though)
-    aNode.params[3] = 10; // max positive
-    aNode.params[4] = -5; // max negative
-    aNode.params[5] = 0b00000001; // start on top
-    aNode.paramIsConstant = 0b00111111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix();
-
-    // on the first run, trigger should cause the output to go high and reset 
-    // the iteration counter
-    assertEquals(10,aNode.result,"LFO Pulse trigger");
-    assertEquals(0,aNode.highResState,"LFO Pulse init iterator");
-
-    runMatrix();
-
-    // running again with the trigger high should reset state
-    assertEquals(10,aNode.result,"LFO Pulse retrigger");
-    assertEquals(0,aNode.highResState,"LFO Pulse reset iterator");
-}
-
-void testLfoPulseStartOnBottom(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
-    aNode.params[0] = 3; // cycle width = 3
-    aNode.params[1] = 2; // pulse width = 2
-    aNode.params[2] = 1; // trigger pulse start (not necessary though)
-    aNode.params[3] = 10; // max positive
-    aNode.params[4] = -5; // max negative
-    aNode.params[5] = 0b00000000; // start on bottom
-    aNode.paramIsConstant = 0b00111111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix();
-
-    // on the first run, trigger should cause the output to go low
-    assertEquals(-5,aNode.result,"LFO Pulse start low");
-}
-
-void testSwitch(){
-
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_SWITCH);
-    aNode.params[0] = 10; // input
-    aNode.params[1] = 0; // switch is initially off
-    aNode.paramIsConstant = 0b00000011;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix();
-
-    // switch is off so output should be 0
-    assertEquals(0,aNode.result,"Switch off");
-
-    //turn on switch
-    aNode.params[1] = 1;
-    runMatrix();
-
-    // switch is on so output should be equal to input
-    assertEquals(10,aNode.result,"Switch on");
-
-    //turn off switch
-    aNode.params[1] = 0;
-    runMatrix();
-
-    // switch is off so output should revert to 0
-    assertEquals(0,aNode.result,"Switch off again");
-}
-
-void testCompare(){
-
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_COMPARE);
-    aNode.params[0] = 10; // input 0 is larger than input 1
-    aNode.params[1] = -10;
-    aNode.paramIsConstant = 0b00000011;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix();
-    assertEquals(BINARY_TRUE,aNode.result,"Compare true");
-
-    aNode.params[0] = -10; // input 0 is smaller than input 1
-    aNode.params[1] = 10;
-
-    runMatrix();
-    assertEquals(BINARY_FALSE,aNode.result,"Compare false");
-
-    aNode.params[0] = 10; // inputs are equal
-    aNode.params[1] = 10;
-
-    runMatrix();
-    assertEquals(BINARY_FALSE,aNode.result,"Compare false");
-}
-
-void testMax(){
-
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_MAX);
-    aNode.params[0] = -5;
-    aNode.params[1] = 7;
-    aNode.params[1] = 0;
-    aNode.paramIsConstant = 0b00000111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix();
-    assertEquals(7,aNode.result,"Max");
-}
-
-void testMin(){
-
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_MIN);
-    aNode.params[0] = -5;
-    aNode.params[1] = 7;
-    aNode.params[1] = 0;
-    aNode.paramIsConstant = 0b00000111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    runMatrix();
-    assertEquals(-5,aNode.result,"Min");
-}
-
-void testScale(){
-
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_SCALE);
-    aNode.paramIsConstant = 0b00000111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    // Full scale, no reduction
-    aNode.params[0] = MAX_POSITIVE;
-    aNode.params[1] = MAX_POSITIVE;
-
-    runMatrix();
-    assertEquals(MAX_POSITIVE,aNode.result,"Scale max positive");
-    
-    // Full scale, no reduction
-    aNode.params[0] = MAX_POSITIVE;
-    aNode.params[1] = MAX_POSITIVE - 1;
-
-    runMatrix();
-    assertEquals(MAX_POSITIVE-2,aNode.result,"Scale almost max positive"); //-2 since we get a rounding error.
-
-    // scaling by zero should always be zero
-    aNode.params[0] = MAX_POSITIVE;
-    aNode.params[1] = 0;
-
-    runMatrix();
-    assertEquals(0,aNode.result,"Scale zero");
-
-    aNode.params[0] = 0;
-    aNode.params[1] = 0;
-
-    runMatrix();
-    assertEquals(0,aNode.result,"Scale two zero");
-
-    // scaling by a negative number should be negative
-    aNode.params[0] = MAX_POSITIVE;
-    aNode.params[1] = -1;
-
-    runMatrix();
-    assertEquals(-1,aNode.result,"Scale minus 1");
-    
-    // edge cases for multiplying maximum values - will not reach max negative
-    // as the positive scale factor is less than the negative.
-    aNode.params[0] = MAX_NEGATIVE;
-    aNode.params[1] = MAX_POSITIVE;
-
-    runMatrix();
-    assertEquals(MAX_NEGATIVE+1,aNode.result,"Scale max negative");
-
-    //Edge case, as it is possible to get more negative than positive
-    aNode.params[0] = MAX_NEGATIVE;
-    aNode.params[1] = MAX_NEGATIVE;
-
-    runMatrix();
-    assertEquals(MAX_POSITIVE,aNode.result,"Scale max negative");
-
-    //Edge case, as it is possible to get more negative than positive
-    aNode.params[0] = MAX_NEGATIVE+1;
-    aNode.params[1] = MAX_NEGATIVE;
-
-    runMatrix();
-    assertEquals(MAX_POSITIVE,aNode.result,"Scale max negative on param0");
-
-    //Edge case, as it is possible to get more negative than positive
-    aNode.params[0] = MAX_NEGATIVE;
-    aNode.params[1] = MAX_NEGATIVE+1;
-
-    runMatrix();
-    assertEquals(MAX_POSITIVE,aNode.result,"Scale max negative on param1");
-
-    //Normal cases, positive
-    aNode.params[0] = 64;
-    aNode.params[1] = 64;
-
-    runMatrix();
-    assertEquals(32,aNode.result,"Scale normal");
-
-    //Normal cases, negative
-    aNode.params[0] = -64;
-    aNode.params[1] = -64;
-
-    runMatrix();
-    assertEquals(32,aNode.result,"Scale normal negative");
-
-    //Normal cases, mixed
-    aNode.params[0] = -64;
-    aNode.params[1] = 64;
-
-    runMatrix();
-    assertEquals(-32,aNode.result,"Scale normal mixed");
-}
-
-void testTrigger(){
-
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_TRIGGER);
-    aNode.params[0] = 1; //trigger input
-    aNode.paramIsConstant = 0b00000001;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    //output should trigger on first high input
-    runMatrix();
-    assertEquals(MAX_POSITIVE,aNode.result,"Trigger high");
-
-    //output should go low after one cycle
-    runMatrix();
-    assertEquals(0, aNode.result,"Trigger low");
-
-    //output should go stay low when input is removed
-    aNode.params[0] = 0; //trigger input removed
-    runMatrix();
-    assertEquals(0, aNode.result,"Trigger stays low");
-
-    //output should retrigger if input goes high again
-    aNode.params[0] = 1; //trigger input removed
-    runMatrix();
-    assertEquals(MAX_POSITIVE, aNode.result,"Trigger retrigger");
-}
-
-void testBinaryAnd(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_BINARY_AND);
-    aNode.params[0] = 1;
-    aNode.params[1] = 1;
-    aNode.params[2] = 0;
-    aNode.paramIsConstant = 0b00000111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    //should be false if at least one is false
-    runMatrix();
-    assertEquals(BINARY_FALSE,aNode.result,"Binary and false");
-
-    //should be true if all are true
-    runMatrix();
-    aNode.params[2] = 1;
-    assertEquals(BINARY_TRUE,aNode.result,"Binary and true");
-}
-
-void testBinaryOr(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_BINARY_OR);
-    aNode.params[0] = 0;
-    aNode.params[1] = 1;
-    aNode.params[2] = 0;
-    aNode.paramIsConstant = 0b00000111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    //should be true if at least one is true
-    runMatrix();
-    assertEquals(BINARY_TRUE,aNode.result,"Binary or true");
-
-    //should be false if all are false
-    runMatrix();
-    aNode.params[1] = 0;
-    assertEquals(BINARY_FALSE,aNode.result,"Binary or false");
-}
-
-void testBinaryXor(){
-    Node aNode;
-    aNode.func = getFunctionPointer(NODE_BINARY_OR);
-    aNode.params[0] = 0;
-    aNode.params[1] = 0;
-    aNode.paramIsConstant = 0b00000111;
-    aNode.result = 0;
-    addNode(&aNode);
-
-    //should be false if both are 0
-    runMatrix();
-    assertEquals(BINARY_FALSE,aNode.result,"Binary xor 0 false");
-
-}
-
-// setup and run test suite
-void runMatrixTests(){
-    reset();
-    /*
-    add(&testSum);
-    add(&testMultiply);
-    
-    add(&testInvertPositive);
-    add(&testInvertNegative);
-    add(&testInvertMaxNegative);
-    add(&testInvertZero);
-
-    add(&testInvertEachSideZero);
-    add(&testInvertEachSidePositive);
-    add(&testInvertEachSideNegative);
-    
-    add(&testDelayLine);
-
-    add(&testMemorySet);
-    add(&testMemoryHold);
-    add(&testMemoryClear);
-    
-    add(&testLfoPulse);
-    add(&testLfoPulseRetrigger);
-    add(&testLfoPulseStartOnBottom);
-    add(&testSwitch);
-    add(&testCompare);
-    add(&testMax);
-    add(&testMin);
-    add(&testScale);
-    add(&testTrigger);
-    add(&testBinaryAnd);
-    add(&testBinaryOr);
-
-    
-    run(resetMatrix); */
-}
-
-// TODO void nodeFuncRamp(Node *aNode){
+#include "test/munit.h"
+#include "test/asserts.h"
+#include "nodetypes.h"
+#include "matrix.private.h"
+#include "matrix.h"
+#include "definitions.h"
+#include "codegen.h"
+#ifdef TARGET_HOST
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include "matrix.bench.h"
+#endif
+
+// matrix used by all tests, reset between each test
+Matrix testMatrix;
+matrixint testOutputBuffer[MAX_SH_OUTPUTS];
+
+// patterns for the sequencer tests
+const SequencerPattern testPatterns[3] = {
+    {4, {{10, 1, 1}, {20, 0, 1}, {30, 1, 2}, {40, 1, 1}}},
+    {2, {{-10, 1, 1}, {-20, 1, 1}}},
+    {3, {{1, 1, 1}, {2, 1, 1}, {3, 1, 1}}}
+};
+
+void resetTestMatrix(){
+    resetMatrix(&testMatrix);
+}
+
+// write a param without the checks of setParam(), to build invalid patches
+void forceParam(Node *aNode, paramindex paramId, operandint value){
+    testMatrix.params[aNode->firstParam + paramId] = value;
+}
+
+void testSum(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 1);
+    addConstantParam(&testMatrix, &aNode, 2);
+    addConstantParam(&testMatrix, &aNode, 4);
+    
+    runMatrix(&testMatrix);
+    
+    assertEquals(7,aNode.result,"sum");
+}
+
+void testMultiply(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_MULTIPLY);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 2);
+    addConstantParam(&testMatrix, &aNode, 4);
+    addConstantParam(&testMatrix, &aNode, 8);
+    
+    runMatrix(&testMatrix);
+
+    assertEquals(64,aNode.result,"product");
+}
+
+void testInvertPositive(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(-10,aNode.result,"invert positive");
+}
+
+void testInvertNegative(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, -10);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(10,aNode.result,"invert negative");
+}
+
+// special case as max positive is 1 less than max negative
+void testInvertMaxNegative(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, MAX_NEGATIVE);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(MAX_POSITIVE,aNode.result,"invert max negative");
+}
+
+void testInvertZero(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(0,aNode.result,"invert zero");
+}
+
+void testInvertEachSideZero(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT_EACH_SIDE);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(MAX_POSITIVE,aNode.result,"invert each side zero");
+}
+
+void testInvertEachSidePositive(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT_EACH_SIDE);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, MAX_POSITIVE);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(0,aNode.result,"invert each side positive");
+}
+
+void testInvertEachSideNegative(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_INVERT_EACH_SIDE);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, MAX_NEGATIVE);
+
+    runMatrix(&testMatrix);
+
+    assertEquals(-1,aNode.result,"invert each side negative");
+}
+
+void testDelayLine(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_DELAY_LINE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10);
+
+    assertEquals(0,aNode.result,"delay line precondition");
+    
+    runMatrix(&testMatrix);
+
+    assertEquals(10,aNode.result,"delay line");
+}
+
+void testDelayBuffer(){
+    Node aNode0, aNode1, aNode2, aNode3;
+    unsigned short i;
+
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 0);
+
+    aNode1.func = getFunctionPointer(NODE_DELAY_BUFFER);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 2);  // 3 ticks
+
+    aNode2.func = getFunctionPointer(NODE_DELAY_BUFFER);
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 0);
+    addConstantParam(&testMatrix, &aNode2, 4);  // 5 ticks
+    addConstantParam(&testMatrix, &aNode2, 64); // read 3 ticks back
+
+    aNode3.func = getFunctionPointer(NODE_DELAY_BUFFER);
+    addNode(&testMatrix, &aNode3);
+    addNodeParam(&testMatrix, &aNode3, 0);
+    addConstantParam(&testMatrix, &aNode3, 1);  // 2 ticks
+    addConstantParam(&testMatrix, &aNode3, 64); // read 1.5 ticks back
+
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Delay buffer valid");
+    assertEquals(10,testMatrix.delayArenaInUse,"Delay buffer allocated");
+
+    for(i = 1; i<=6; i++){
+        testMatrix.inputBuffer[0] = i * 10;
+        runMatrix(&testMatrix);
+        if(i == 3){
+            assertEquals(0,aNode1.result,"Delay buffer empty");
+        }
+    }
+    assertEquals(30,aNode1.result,"Delay buffer length");
+    assertEquals(30,aNode2.result,"Delay buffer position");
+    assertEquals(45,aNode3.result,"Delay buffer fraction");
+
+    // validating again starts from empty buffers
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Delay buffer valid again");
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode1.result,"Delay buffer cleared");
+}
+
+void testDelayBufferInvalid(){
+    Node aNode0, nodes[DELAY_ARENA_SIZE / DELAY_MAX_LENGTH + 1];
+    unsigned short i;
+
+    aNode0.func = getFunctionPointer(NODE_DELAY_BUFFER);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 10);
+    addNodeParam(&testMatrix, &aNode0, 0);
+    assertEquals(PATCH_INVALID_DELAY,validatePatch(&testMatrix),"Delay buffer length not constant");
+
+    resetTestMatrix();
+    for(i = 0; i < DELAY_ARENA_SIZE / DELAY_MAX_LENGTH + 1; i++){
+        nodes[i].func = getFunctionPointer(NODE_DELAY_BUFFER);
+        addNode(&testMatrix, &nodes[i]);
+        addConstantParam(&testMatrix, &nodes[i], 10);
+        addConstantParam(&testMatrix, &nodes[i], DELAY_MAX_LENGTH - 1);
+    }
+    assertEquals(PATCH_DELAY_ARENA_FULL,validatePatch(&testMatrix),"Delay buffer arena full");
+}
+
+void nullSink(char character){}
+
+// emitting and linking a running patch only checks it, the delay keeps the
+// samples written before
+void testEmitPatchKeepsState(){
+    Node aNode0;
+    aNode0.func = getFunctionPointer(NODE_DELAY_BUFFER);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 10);
+    addConstantParam(&testMatrix, &aNode0, 3); // 4 ticks
+    validatePatch(&testMatrix);
+
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    assertEquals(PATCH_OK,emitPatch(&testMatrix, nullSink),"Emit running patch");
+    assertEquals(PATCH_OK,linkPatch(&testMatrix),"Link running patch");
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    assertEquals(10,aNode0.result,"Emit patch keeps delay");
+}
+
+// send a trigger to the sequencer node with its trigger on param 0
+void triggerSequencer(Node *aNode){
+    setParam(&testMatrix, aNode, 0, BINARY_TRUE);
+    runMatrix(&testMatrix);
+    setParam(&testMatrix, aNode, 0, BINARY_FALSE);
+    runMatrix(&testMatrix);
+}
+
+void testSequencer(){
+    Node aNode0, aNode1;
+    testMatrix.patterns = testPatterns;
+    testMatrix.patternsInUse = 3;
+
+    aNode0.func = getFunctionPointer(NODE_SEQUENCER);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, BINARY_FALSE);
+    addConstantParam(&testMatrix, &aNode0, 0);
+    addConstantParam(&testMatrix, &aNode0, SEQUENCER_FORWARD);
+    addConstantParam(&testMatrix, &aNode0, BINARY_FALSE);
+
+    aNode1.func = getFunctionPointer(NODE_SEQUENCER_GATE);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Sequencer valid");
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode0.result,"Sequencer not started");
+    assertEquals(BINARY_FALSE,aNode1.result,"Sequencer gate not started");
+
+    triggerSequencer(&aNode0);
+    assertEquals(10,aNode0.result,"Sequencer first step");
+    assertEquals(BINARY_TRUE,aNode1.result,"Sequencer gate on");
+    triggerSequencer(&aNode0);
+    assertEquals(20,aNode0.result,"Sequencer second step");
+    assertEquals(BINARY_FALSE,aNode1.result,"Sequencer gate off");
+    triggerSequencer(&aNode0);
+    triggerSequencer(&aNode0);
+    assertEquals(30,aNode0.result,"Sequencer step length");
+    triggerSequencer(&aNode0);
+    triggerSequencer(&aNode0);
+    assertEquals(10,aNode0.result,"Sequencer wrap");
+
+    setParam(&testMatrix, &aNode0, 1, 1);
+    runMatrix(&testMatrix);
+    assertEquals(-10,aNode0.result,"Sequencer pattern change");
+
+    setParam(&testMatrix, &aNode0, 3, BINARY_TRUE);
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode0.result,"Sequencer reset");
+    triggerSequencer(&aNode0);
+    assertEquals(-10,aNode0.result,"Sequencer reset first step");
+}
+
+void testSequencerDirections(){
+    Node aNode0, aNode1, aNode2, aNode3;
+    unsigned short i, inRange;
+    testMatrix.patterns = testPatterns;
+    testMatrix.patternsInUse = 3;
+
+    // trigger for all sequencers
+    aNode0.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, BINARY_FALSE);
+
+    aNode1.func = getFunctionPointer(NODE_SEQUENCER);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 2);
+    addConstantParam(&testMatrix, &aNode1, SEQUENCER_BACKWARD);
+
+    aNode2.func = getFunctionPointer(NODE_SEQUENCER);
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 0);
+    addConstantParam(&testMatrix, &aNode2, 2);
+    addConstantParam(&testMatrix, &aNode2, SEQUENCER_PINGPONG);
+
+    aNode3.func = getFunctionPointer(NODE_SEQUENCER);
+    addNode(&testMatrix, &aNode3);
+    addNodeParam(&testMatrix, &aNode3, 0);
+    addConstantParam(&testMatrix, &aNode3, 2);
+    addConstantParam(&testMatrix, &aNode3, SEQUENCER_RANDOM);
+
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Sequencer directions valid");
+    triggerSequencer(&aNode0);
+    assertEquals(3,aNode1.result,"Sequencer backward start");
+    assertEquals(1,aNode2.result,"Sequencer pingpong start");
+    triggerSequencer(&aNode0);
+    triggerSequencer(&aNode0);
+    triggerSequencer(&aNode0);
+    assertEquals(3,aNode1.result,"Sequencer backward wrap");
+    assertEquals(2,aNode2.result,"Sequencer pingpong turn");
+    triggerSequencer(&aNode0);
+    assertEquals(1,aNode2.result,"Sequencer pingpong back");
+    triggerSequencer(&aNode0);
+    assertEquals(2,aNode2.result,"Sequencer pingpong forward");
+
+    inRange = 1;
+    for(i = 0; i<32; i++){
+        triggerSequencer(&aNode0);
+        if(aNode3.result < 1 || aNode3.result > 3){
+            inRange = 0;
+        }
+    }
+    assertEquals(1,inRange,"Sequencer random steps");
+}
+
+void testSequencerInvalid(){
+    Node aNode0, aNode1, aNode2;
+
+    aNode0.func = getFunctionPointer(NODE_SEQUENCER);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, BINARY_FALSE);
+    addConstantParam(&testMatrix, &aNode0, 0);
+    addConstantParam(&testMatrix, &aNode0, SEQUENCER_FORWARD);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, 0);
+
+    aNode2.func = getFunctionPointer(NODE_SEQUENCER_GATE);
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 0);
+
+    assertEquals(PATCH_INVALID_SEQUENCER,validatePatch(&testMatrix),"Sequencer without patterns");
+    testMatrix.patterns = testPatterns;
+    testMatrix.patternsInUse = 3;
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Sequencer with patterns");
+
+    assertEquals(PATCH_INVALID_SEQUENCER,setParam(&testMatrix, &aNode0, 1, 3),"Sequencer set pattern out of range");
+    assertEquals(PATCH_INVALID_SEQUENCER,setParam(&testMatrix, &aNode0, 2, SEQUENCER_DIRECTIONS),"Sequencer set direction out of range");
+    assertEquals(PATCH_INVALID_SEQUENCER,setParam(&testMatrix, &aNode2, 0, 1),"Sequencer gate set other node");
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Sequencer unchanged after rejected set");
+    assertEquals(PATCH_OK,setParam(&testMatrix, &aNode0, 1, 2),"Sequencer set pattern");
+
+    forceParam(&aNode0, 1, 3);
+    assertEquals(PATCH_INVALID_SEQUENCER,validatePatch(&testMatrix),"Sequencer pattern out of range");
+    forceParam(&aNode0, 1, 0);
+    forceParam(&aNode0, 2, SEQUENCER_DIRECTIONS);
+    assertEquals(PATCH_INVALID_SEQUENCER,validatePatch(&testMatrix),"Sequencer direction out of range");
+    forceParam(&aNode0, 2, SEQUENCER_FORWARD);
+    forceParam(&aNode2, 0, 1);
+    assertEquals(PATCH_INVALID_SEQUENCER,validatePatch(&testMatrix),"Sequencer gate reads other node");
+}
+
+void testMemorySet(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_MEMORY);
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10);
+    addConstantParam(&testMatrix, &aNode, 1); // should set
+    addConstantParam(&testMatrix, &aNode, 0); // should not clear
+
+    runMatrix(&testMatrix);
+
+    assertEquals(10,aNode.result,"memory set");
+}
+
+void testMemoryHold(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_MEMORY);
+    aNode.result = 5; //value to hold - leave unchanged
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10);
+    addConstantParam(&testMatrix, &aNode, 0); // should not set
+    addConstantParam(&testMatrix, &aNode, 0); // should not clear
+
+    runMatrix(&testMatrix);
+
+    assertEquals(5,aNode.result,"memory hold");
+}
+
+void testMemoryClear(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_MEMORY);
+    aNode.result = 7; //initial value
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10);
+    addConstantParam(&testMatrix, &aNode, 0); // should not set
+    addConstantParam(&testMatrix, &aNode, 1); // should clear
+
+    runMatrix(&testMatrix);
+
+    assertEquals(0,aNode.result,"memory hold");
+}
+
+void testLfoPulse(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 3); // cycle width = 3
+    addConstantParam(&testMatrix, &aNode, 2); // pulse width = 2
+    addConstantParam(&testMatrix, &aNode, 1); // trigger pulse start (not necessary though)
+    addConstantParam(&testMatrix, &aNode, 10); // max positive
+    addConstantParam(&testMatrix, &aNode, -5); // max negative
+    addConstantParam(&testMatrix, &aNode, 0b00000001); // start on top
+
+    runMatrix(&testMatrix); // on the first run, trigger should cause the output to go high and reset the iteration counter
+
+    assertEquals(10,aNode.result,"LFO Pulse trigger");
+    assertEquals(0,aNode.highResState,"LFO Pulse init iterator");
+    
+    setParam(&testMatrix, &aNode, 2, 0); // remove trigger
+
+    runMatrix(&testMatrix);
+
+    // after one cycle, nothing should have changed except the counter
+    assertEquals(10,aNode.result,"LFO Pulse step 2");
+    assertEquals(1,aNode.highResState,"LFO Pulse iterator increment");
+
+    runMatrix(&testMatrix);
+    
+    // after two cycles we should have reached the pulse length and the lfo should drop to its minimum value
+    assertEquals(-5,aNode.result,"LFO Pulse step 3");
+
+    runMatrix(&testMatrix);
+
+    // after three cycles, we should be back to start:
+    assertEquals(10,aNode.result,"LFO Pulse step 4");
+    assertEquals(0,aNode.highResState,"LFO Pulse iterator reset");
+
+}
+
+void testLfoPulseRetrigger(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 3); // cycle width = 3
+    addConstantParam(&testMatrix, &aNode, 2); // pulse width = 2
+    addConstantParam(&testMatrix, &aNode, 1); // trigger pulse start (not necessary though)
+    addConstantParam(&testMatrix, &aNode, 10); // max positive
+    addConstantParam(&testMatrix, &aNode, -5); // max negative
+    addConstantParam(&testMatrix, &aNode, 0b00000001); // start on top
+
+    runMatrix(&testMatrix);
+
+    // on the first run, trigger should cause the output to go high and reset 
+    // the iteration counter
+    assertEquals(10,aNode.result,"LFO Pulse trigger");
+    assertEquals(0,aNode.highResState,"LFO Pulse init iterator");
+
+    runMatrix(&testMatrix);
+
+    // running again with the trigger high should reset state
+    assertEquals(10,aNode.result,"LFO Pulse retrigger");
+    assertEquals(0,aNode.highResState,"LFO Pulse reset iterator");
+}
+
+void testLfoPulseStartOnBottom(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 3); // cycle width = 3
+    addConstantParam(&testMatrix, &aNode, 2); // pulse width = 2
+    addConstantParam(&testMatrix, &aNode, 1); // trigger pulse start (not necessary though)
+    addConstantParam(&testMatrix, &aNode, 10); // max positive
+    addConstantParam(&testMatrix, &aNode, -5); // max negative
+    addConstantParam(&testMatrix, &aNode, 0b00000000); // start on bottom
+
+    runMatrix(&testMatrix);
+
+    // on the first run, trigger should cause the output to go low
+    assertEquals(-5,aNode.result,"LFO Pulse start low");
+}
+
+void testSwitch(){
+
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_SWITCH);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10); // input
+    addConstantParam(&testMatrix, &aNode, 0); // switch is initially off
+
+    runMatrix(&testMatrix);
+
+    // switch is off so output should be 0
+    assertEquals(0,aNode.result,"Switch off");
+
+    //turn on switch
+    setParam(&testMatrix, &aNode, 1, 1);
+    runMatrix(&testMatrix);
+
+    // switch is on so output should be equal to input
+    assertEquals(10,aNode.result,"Switch on");
+
+    //turn off switch
+    setParam(&testMatrix, &aNode, 1, 0);
+    runMatrix(&testMatrix);
+
+    // switch is off so output should revert to 0
+    assertEquals(0,aNode.result,"Switch off again");
+}
+
+void testCompare(){
+
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_COMPARE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 10); // input 0 is larger than input 1
+    addConstantParam(&testMatrix, &aNode, -10);
+
+    runMatrix(&testMatrix);
+    assertEquals(BINARY_TRUE,aNode.result,"Compare true");
+
+    setParam(&testMatrix, &aNode, 0, -10); // input 0 is smaller than input 1
+    setParam(&testMatrix, &aNode, 1, 10);
+
+    runMatrix(&testMatrix);
+    assertEquals(BINARY_FALSE,aNode.result,"Compare false");
+
+    setParam(&testMatrix, &aNode, 0, 10); // inputs are equal
+    setParam(&testMatrix, &aNode, 1, 10);
+
+    runMatrix(&testMatrix);
+    assertEquals(BINARY_FALSE,aNode.result,"Compare false");
+}
+
+void testMax(){
+
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_MAX);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, -5);
+    addConstantParam(&testMatrix, &aNode, 7);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    runMatrix(&testMatrix);
+    assertEquals(7,aNode.result,"Max");
+}
+
+void testMin(){
+
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_MIN);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, -5);
+    addConstantParam(&testMatrix, &aNode, 7);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    runMatrix(&testMatrix);
+    assertEquals(-5,aNode.result,"Min");
+}
+
+void testScale(){
+
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_SCALE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 0);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    // Full scale, no reduction
+    setParam(&testMatrix, &aNode, 0, MAX_POSITIVE);
+    setParam(&testMatrix, &aNode, 1, MAX_POSITIVE);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode.result,"Scale max positive");
+    
+    // Full scale, no reduction
+    setParam(&testMatrix, &aNode, 0, MAX_POSITIVE);
+    setParam(&testMatrix, &aNode, 1, MAX_POSITIVE - 1);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE-2,aNode.result,"Scale almost max positive"); //-2 since we get a rounding error.
+
+    // scaling by zero should always be zero
+    setParam(&testMatrix, &aNode, 0, MAX_POSITIVE);
+    setParam(&testMatrix, &aNode, 1, 0);
+
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode.result,"Scale zero");
+
+    setParam(&testMatrix, &aNode, 0, 0);
+    setParam(&testMatrix, &aNode, 1, 0);
+
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode.result,"Scale two zero");
+
+    // scaling by a negative number should be negative
+    setParam(&testMatrix, &aNode, 0, MAX_POSITIVE);
+    setParam(&testMatrix, &aNode, 1, -1);
+
+    runMatrix(&testMatrix);
+    assertEquals(-1,aNode.result,"Scale minus 1");
+    
+    // edge cases for multiplying maximum values - will not reach max negative
+    // as the positive scale factor is less than the negative.
+    setParam(&testMatrix, &aNode, 0, MAX_NEGATIVE);
+    setParam(&testMatrix, &aNode, 1, MAX_POSITIVE);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_NEGATIVE+1,aNode.result,"Scale max negative");
+
+    //Edge case, as it is possible to get more negative than positive
+    setParam(&testMatrix, &aNode, 0, MAX_NEGATIVE);
+    setParam(&testMatrix, &aNode, 1, MAX_NEGATIVE);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode.result,"Scale max negative");
+
+    //Edge case, as it is possible to get more negative than positive
+    setParam(&testMatrix, &aNode, 0, MAX_NEGATIVE+1);
+    setParam(&testMatrix, &aNode, 1, MAX_NEGATIVE);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode.result,"Scale max negative on param0");
+
+    //Edge case, as it is possible to get more negative than positive
+    setParam(&testMatrix, &aNode, 0, MAX_NEGATIVE);
+    setParam(&testMatrix, &aNode, 1, MAX_NEGATIVE+1);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode.result,"Scale max negative on param1");
+
+    //Normal cases, positive
+    setParam(&testMatrix, &aNode, 0, 64);
+    setParam(&testMatrix, &aNode, 1, 64);
+
+    runMatrix(&testMatrix);
+    assertEquals(32,aNode.result,"Scale normal");
+
+    //Normal cases, negative
+    setParam(&testMatrix, &aNode, 0, -64);
+    setParam(&testMatrix, &aNode, 1, -64);
+
+    runMatrix(&testMatrix);
+    assertEquals(32,aNode.result,"Scale normal negative");
+
+    //Normal cases, mixed
+    setParam(&testMatrix, &aNode, 0, -64);
+    setParam(&testMatrix, &aNode, 1, 64);
+
+    runMatrix(&testMatrix);
+    assertEquals(-32,aNode.result,"Scale normal mixed");
+}
+
+void testDivide(){
+    Node aNode0, aNode1, aNode2, aNode3;
+    aNode0.func = getFunctionPointer(NODE_DIVIDE);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 100);
+    addConstantParam(&testMatrix, &aNode0, 7);
+
+    aNode1.func = getFunctionPointer(NODE_DIVIDE);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, -100);
+    addConstantParam(&testMatrix, &aNode1, 7);
+
+    aNode2.func = getFunctionPointer(NODE_DIVIDE);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, MAX_NEGATIVE);
+    addConstantParam(&testMatrix, &aNode2, -1);
+
+    aNode3.func = getFunctionPointer(NODE_DIVIDE);
+    addNode(&testMatrix, &aNode3);
+    addConstantParam(&testMatrix, &aNode3, -5);
+    addConstantParam(&testMatrix, &aNode3, 0);
+
+    runMatrix(&testMatrix);
+    assertEquals(14,aNode0.result,"Divide");
+    assertEquals(-14,aNode1.result,"Divide negative");
+    assertEquals(MAX_POSITIVE,aNode2.result,"Divide saturate");
+    assertEquals(MAX_NEGATIVE,aNode3.result,"Divide by zero");
+}
+
+void testDivideMagnitude(){
+    unsigned int dividend, divisor;
+    unsigned short failed;
+
+    // the reciprocals round up, so the results most likely to be off are just
+    // below a multiple of the divisor
+    failed = 0;
+    for(divisor = 1; divisor < RECIPROCAL_TABLE_SIZE; divisor++){
+        for(dividend = divisor; dividend <= divisor * 128; dividend += divisor){
+            if(divideMagnitude(dividend, divisor) != dividend / divisor
+               || divideMagnitude(dividend - 1, divisor) != (dividend - 1) / divisor){
+                failed = 1;
+            }
+        }
+    }
+    assertEquals(0,failed,"Divide magnitude");
+    assertEquals(32767 / (RECIPROCAL_TABLE_SIZE - 1),divideMagnitude(32767, RECIPROCAL_TABLE_SIZE),"Divide magnitude saturates divisor");
+}
+
+void testAverage(){
+    Node aNode0, aNode1;
+    aNode0.func = getFunctionPointer(NODE_AVERAGE);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 100);
+    addConstantParam(&testMatrix, &aNode0, 120);
+    addConstantParam(&testMatrix, &aNode0, 127);
+
+    aNode1.func = getFunctionPointer(NODE_AVERAGE);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, MAX_NEGATIVE);
+    addConstantParam(&testMatrix, &aNode1, -3);
+
+    runMatrix(&testMatrix);
+    assertEquals(115,aNode0.result,"Average");
+    assertEquals(-65,aNode1.result,"Average negative");
+}
+
+void testClamp(){
+    Node aNode0, aNode1, aNode2;
+    aNode0.func = getFunctionPointer(NODE_CLAMP);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 100);
+    addConstantParam(&testMatrix, &aNode0, -20);
+    addConstantParam(&testMatrix, &aNode0, 50);
+
+    aNode1.func = getFunctionPointer(NODE_CLAMP);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, -100);
+    addConstantParam(&testMatrix, &aNode1, -20);
+    addConstantParam(&testMatrix, &aNode1, 50);
+
+    aNode2.func = getFunctionPointer(NODE_CLAMP);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, 10);
+    addConstantParam(&testMatrix, &aNode2, -20);
+    addConstantParam(&testMatrix, &aNode2, 50);
+
+    runMatrix(&testMatrix);
+    assertEquals(50,aNode0.result,"Clamp high");
+    assertEquals(-20,aNode1.result,"Clamp low");
+    assertEquals(10,aNode2.result,"Clamp inside");
+}
+
+void testCrossfade(){
+    Node aNode0;
+    aNode0.func = getFunctionPointer(NODE_CROSSFADE);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, MAX_NEGATIVE);
+    addConstantParam(&testMatrix, &aNode0, MAX_POSITIVE);
+    addConstantParam(&testMatrix, &aNode0, MAX_NEGATIVE);
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_NEGATIVE,aNode0.result,"Crossfade start");
+
+    setParam(&testMatrix, &aNode0, 2, 0);
+    runMatrix(&testMatrix);
+    assertEquals(-1,aNode0.result,"Crossfade middle");
+
+    setParam(&testMatrix, &aNode0, 2, MAX_POSITIVE);
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode0.result,"Crossfade end");
+}
+
+void testAbs(){
+    Node aNode0, aNode1;
+    aNode0.func = getFunctionPointer(NODE_ABS);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, -42);
+
+    aNode1.func = getFunctionPointer(NODE_ABS);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, MAX_NEGATIVE);
+
+    runMatrix(&testMatrix);
+    assertEquals(42,aNode0.result,"Abs");
+    assertEquals(MAX_POSITIVE,aNode1.result,"Abs saturate");
+}
+
+void testTrigger(){
+
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_TRIGGER);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 1); //trigger input
+
+    //output should trigger on first high input
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode.result,"Trigger high");
+
+    //output should go low after one cycle
+    runMatrix(&testMatrix);
+    assertEquals(0, aNode.result,"Trigger low");
+
+    //output should go stay low when input is removed
+    setParam(&testMatrix, &aNode, 0, 0); //trigger input removed
+    runMatrix(&testMatrix);
+    assertEquals(0, aNode.result,"Trigger stays low");
+
+    //output should retrigger if input goes high again
+    setParam(&testMatrix, &aNode, 0, 1); //trigger input removed
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE, aNode.result,"Trigger retrigger");
+}
+
+void testBinaryAnd(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_BINARY_AND);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 1);
+    addConstantParam(&testMatrix, &aNode, 1);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    //should be false if at least one is false
+    runMatrix(&testMatrix);
+    assertEquals(BINARY_FALSE,aNode.result,"Binary and false");
+
+    //should be true if all are true
+    runMatrix(&testMatrix);
+    setParam(&testMatrix, &aNode, 2, 1);
+    assertEquals(BINARY_TRUE,aNode.result,"Binary and true");
+}
+
+void testBinaryOr(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_BINARY_OR);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 0);
+    addConstantParam(&testMatrix, &aNode, 1);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    //should be true if at least one is true
+    runMatrix(&testMatrix);
+    assertEquals(BINARY_TRUE,aNode.result,"Binary or true");
+
+    //should be false if all are false
+    runMatrix(&testMatrix);
+    setParam(&testMatrix, &aNode, 1, 0);
+    assertEquals(BINARY_FALSE,aNode.result,"Binary or false");
+}
+
+void testBinaryXor(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_BINARY_OR);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 0);
+    addConstantParam(&testMatrix, &aNode, 0);
+
+    //should be false if both are 0
+    runMatrix(&testMatrix);
+    assertEquals(BINARY_FALSE,aNode.result,"Binary xor 0 false");
+
+}
+
+void testGateOutput(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_GATE_OUTPUT);
+    testMatrix.gateBuffer = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 2); // pin
+    addConstantParam(&testMatrix, &aNode, 1); // gate on
+
+    runMatrix(&testMatrix);
+    assertEquals(0b00000100,testMatrix.gateBuffer,"Gate output on");
+
+    setParam(&testMatrix, &aNode, 1, 0); // gate off
+    runMatrix(&testMatrix);
+    assertEquals(0,testMatrix.gateBuffer,"Gate output off");
+}
+
+void testTriggerOutput(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_TRIGGER_OUTPUT);
+    aNode.state = 0;
+    testMatrix.triggerCountdown[1] = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 1); // pin
+    addConstantParam(&testMatrix, &aNode, 1); // input high
+    addConstantParam(&testMatrix, &aNode, 5); // pulse width
+
+    //pulse should start on first high input
+    runMatrix(&testMatrix);
+    assertEquals(5,testMatrix.triggerCountdown[1],"Trigger output start");
+
+    //pulse should not restart while input stays high
+    testMatrix.triggerCountdown[1] = 3;
+    runMatrix(&testMatrix);
+    assertEquals(3,testMatrix.triggerCountdown[1],"Trigger output no restart");
+
+    //pulse should restart when input goes high again
+    setParam(&testMatrix, &aNode, 1, 0);
+    runMatrix(&testMatrix);
+    setParam(&testMatrix, &aNode, 1, 1);
+    runMatrix(&testMatrix);
+    assertEquals(5,testMatrix.triggerCountdown[1],"Trigger output retrigger");
+}
+
+void testSlewLinear(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_SLEW);
+    aNode.highResState = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 100); // input
+    addConstantParam(&testMatrix, &aNode, 16); // rise rate, 32 steps per iteration
+    addConstantParam(&testMatrix, &aNode, 0); // fall rate, no glide
+    addConstantParam(&testMatrix, &aNode, SLEW_LINEAR);
+
+    runMatrix(&testMatrix);
+    assertEquals(32,aNode.result,"Slew linear step 1");
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    assertEquals(96,aNode.result,"Slew linear step 3");
+    runMatrix(&testMatrix);
+    assertEquals(100,aNode.result,"Slew linear reached");
+
+    // fall rate is 0, so output should follow input at once
+    setParam(&testMatrix, &aNode, 0, -20);
+    runMatrix(&testMatrix);
+    assertEquals(-20,aNode.result,"Slew linear no fall");
+}
+
+void testSlewExponential(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_SLEW);
+    aNode.highResState = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 100); // input
+    addConstantParam(&testMatrix, &aNode, 16); // rise rate, 1/4 of the distance per iteration
+    addConstantParam(&testMatrix, &aNode, 16); // fall rate
+    addConstantParam(&testMatrix, &aNode, SLEW_EXPONENTIAL);
+
+    runMatrix(&testMatrix);
+    assertEquals(25,aNode.result,"Slew exponential step 1");
+    runMatrix(&testMatrix);
+    assertEquals(44,aNode.result,"Slew exponential step 2");
+}
+
+void testSlewConstantTime(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_SLEW);
+    aNode.highResState = 0;
+    aNode.auxState = 0;
+    aNode.state = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 100); // input
+    addConstantParam(&testMatrix, &aNode, 32); // rise rate, reach target in 4 iterations
+    addConstantParam(&testMatrix, &aNode, 32); // fall rate
+    addConstantParam(&testMatrix, &aNode, SLEW_CONSTANT_TIME);
+
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    assertEquals(50,aNode.result,"Slew constant time halfway");
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    assertEquals(100,aNode.result,"Slew constant time reached");
+}
+
+void testValidatePatch(){
+    Node aNode0, aNode1;
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, MAX_INPUTS - 1);
+
+    aNode1.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, MAX_SH_OUTPUTS - 1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Validate patch ok");
+
+    forceParam(&aNode1, 0, MAX_SH_OUTPUTS);
+    assertEquals(PATCH_INVALID_OUTPUT,validatePatch(&testMatrix),"Validate output out of range");
+    assertEquals(1,testMatrix.patchErrorNode,"Validate output error node");
+
+    forceParam(&aNode1, 0, 0);
+    forceParam(&aNode1, 1, 2);
+    assertEquals(PATCH_INVALID_NODE_INDEX,validatePatch(&testMatrix),"Validate node index out of range");
+
+    forceParam(&aNode1, 1, 0);
+    forceParam(&aNode0, 0, MAX_INPUTS);
+    assertEquals(PATCH_INVALID_INPUT,validatePatch(&testMatrix),"Validate input out of range");
+}
+
+void testSetParamRange(){
+    Node aNode0, aNode1, aNode2;
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 0);
+
+    aNode1.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, 0);
+    addNodeParam(&testMatrix, &aNode1, 0);
+
+    aNode2.func = getFunctionPointer(NODE_GATE_OUTPUT);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, 0);
+    addNodeParam(&testMatrix, &aNode2, 0);
+
+    assertEquals(PATCH_OK,setParam(&testMatrix, &aNode0, 0, MAX_INPUTS - 1),"Set input in range");
+    assertEquals(PATCH_INVALID_INPUT,setParam(&testMatrix, &aNode0, 0, MAX_INPUTS),"Set input out of range");
+    assertEquals(PATCH_INVALID_INPUT,setParam(&testMatrix, &aNode0, 0, -1),"Set input negative");
+    assertEquals(PATCH_OK,setParam(&testMatrix, &aNode1, 0, MAX_SH_OUTPUTS - 1),"Set output in range");
+    assertEquals(PATCH_INVALID_OUTPUT,setParam(&testMatrix, &aNode1, 0, MAX_SH_OUTPUTS),"Set output out of range");
+    assertEquals(PATCH_INVALID_OUTPUT,setParam(&testMatrix, &aNode2, 0, MAX_GATE_OUTPUTS),"Set gate output out of range");
+    assertEquals(PATCH_INVALID_NODE_INDEX,setParam(&testMatrix, &aNode1, 1, 3),"Set node index out of range");
+    assertEquals(PATCH_INVALID_NODE_INDEX,setParam(&testMatrix, &aNode1, 1, -1),"Set node index negative");
+    assertEquals(PATCH_MISSING_PARAMS,setParam(&testMatrix, &aNode1, 2, 0),"Set param not in use");
+
+    assertEquals(MAX_INPUTS - 1,testMatrix.params[aNode0.firstParam],"Set input kept");
+    assertEquals(MAX_SH_OUTPUTS - 1,testMatrix.params[aNode1.firstParam],"Set output kept");
+    assertEquals(0,testMatrix.params[aNode1.firstParam + 1],"Set node index kept");
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Set param patch still valid");
+}
+
+void testNodeRate(){
+    Node aNode;
+    aNode.func = getFunctionPointer(NODE_LFO_PULSE);
+    aNode.result = 0;
+    addNode(&testMatrix, &aNode);
+    addConstantParam(&testMatrix, &aNode, 4); // cycle width = 4
+    addConstantParam(&testMatrix, &aNode, 2); // pulse width = 2
+    addConstantParam(&testMatrix, &aNode, 1); // trigger pulse start
+    addConstantParam(&testMatrix, &aNode, 10); // max positive
+    addConstantParam(&testMatrix, &aNode, -5); // max negative
+    addConstantParam(&testMatrix, &aNode, 0b00000001); // start on top
+    setNodeRate(&aNode, 1); // run every second matrix run
+
+    runMatrix(&testMatrix);
+    assertEquals(10,aNode.result,"Node rate first run");
+    setParam(&testMatrix, &aNode, 2, 0); // remove trigger
+
+    // node should not run on the second matrix run
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode.highResState,"Node rate skipped");
+
+    // on the third run the LFO should have stepped two at once, past pulse width
+    runMatrix(&testMatrix);
+    assertEquals(2,aNode.highResState,"Node rate scaled step");
+    assertEquals(-5,aNode.result,"Node rate pulse width");
+
+    runMatrix(&testMatrix);
+    runMatrix(&testMatrix);
+    assertEquals(10,aNode.result,"Node rate cycle");
+}
+
+void testScaleIncrement(){
+    Node aNode, aNode1;
+    aNode.rateShift = 0;
+    assertEquals(1000,scaleIncrement(&testMatrix, &aNode, 1000),"Scale increment nominal");
+    testMatrix.timeScale = TIME_SCALE_NOMINAL / 2;
+    assertEquals(500,scaleIncrement(&testMatrix, &aNode, 1000),"Scale increment fast dacs");
+    testMatrix.timeScale = TIME_SCALE_NOMINAL * 3;
+    assertEquals(-3000,scaleIncrement(&testMatrix, &aNode, -1000),"Scale increment slow dacs");
+    aNode.rateShift = 2;
+    assertEquals(12000,scaleIncrement(&testMatrix, &aNode, 1000),"Scale increment node rate");
+
+    // the largest increments saturate instead of overflowing the multiply
+    aNode.rateShift = MAX_RATE_SHIFT;
+    testMatrix.timeScale = 65535;
+    assertEquals(matrixlongintmax,scaleIncrement(&testMatrix, &aNode, 32767),"Scale increment saturate");
+    assertEquals(matrixlongintmin,scaleIncrement(&testMatrix, &aNode, -32768),"Scale increment saturate negative");
+    testMatrix.timeScale = TIME_SCALE_NOMINAL - 1;
+    assertEquals(matrixlongintmax,scaleIncrement(&testMatrix, &aNode, 32767),"Scale increment saturate fast dacs");
+    testMatrix.timeScale = 0;
+    assertEquals(0,scaleIncrement(&testMatrix, &aNode, 32767),"Scale increment stopped");
+
+    // a glide at twice the nominal time scale moves twice as far per run
+    testMatrix.timeScale = TIME_SCALE_NOMINAL * 2;
+    aNode1.func = getFunctionPointer(NODE_GLIDE);
+    aNode1.result = 0;
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, 100);
+    addConstantParam(&testMatrix, &aNode1, 4);
+    addConstantParam(&testMatrix, &aNode1, 1);
+    addConstantParam(&testMatrix, &aNode1, 1);
+    runMatrix(&testMatrix);
+    assertEquals(8,aNode1.result,"Glide time scale");
+}
+
+void testStaggerNodeRates(){
+    Node aNode0, aNode1;
+    aNode0.func = getFunctionPointer(NODE_SUM);
+    aNode0.result = 0;
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 5);
+    setNodeRate(&aNode0, 1);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    aNode1.result = 0;
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, 7);
+    setNodeRate(&aNode1, 1);
+
+    staggerNodeRates(&testMatrix);
+
+    // nodes at the same rate should run on different matrix runs
+    runMatrix(&testMatrix);
+    assertEquals(5,aNode0.result,"Stagger first node");
+    assertEquals(0,aNode1.result,"Stagger second node waits");
+
+    runMatrix(&testMatrix);
+    assertEquals(7,aNode1.result,"Stagger second node");
+}
+
+void testGetFunctionType(){
+    assertEquals(NODE_SCALE,getFunctionType(getFunctionPointer(NODE_SCALE)),"Function type scale");
+    assertEquals(NODE_SLEW,getFunctionType(getFunctionPointer(NODE_SLEW)),"Function type slew");
+}
+
+void testFuseInputScaleOutput(){
+    Node aNode0, aNode1, aNode2;
+    testMatrix.outputBuffer = testOutputBuffer;
+    testMatrix.inputBuffer[1] = 100;
+
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 1);
+
+    aNode1.func = getFunctionPointer(NODE_SCALE);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 64); // scale by half
+
+    aNode2.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, 2);
+    addNodeParam(&testMatrix, &aNode2, 1);
+
+    assertEquals(2,fusePatch(&testMatrix),"Fuse input scale output removed");
+    assertEquals(1,testMatrix.nodesInUse,"Fuse input scale output nodes");
+    assertEquals(NODE_FUSED_INPUT_SCALE_OUTPUT,getFunctionType(aNode2.func),"Fuse input scale output type");
+    assertEquals(3,testMatrix.paramsInPool,"Fuse input scale output params");
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Fuse input scale output valid");
+
+    runMatrix(&testMatrix);
+    assertEquals(50,testOutputBuffer[2],"Fuse input scale output result");
+}
+
+void testFuseInputOffsetScale(){
+    Node aNode0, aNode1, aNode2, aNode3;
+    testMatrix.outputBuffer = testOutputBuffer;
+    testMatrix.inputBuffer[0] = 20;
+
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 0);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, 40); // offset
+    addNodeParam(&testMatrix, &aNode1, 0);
+
+    aNode2.func = getFunctionPointer(NODE_SCALE);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, 32); // scale by a quarter
+    addNodeParam(&testMatrix, &aNode2, 1);
+
+    // reads the scaled result, the last node in the chain keeps its result
+    aNode3.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode3);
+    addConstantParam(&testMatrix, &aNode3, 0);
+    addNodeParam(&testMatrix, &aNode3, 2);
+
+    assertEquals(2,fusePatch(&testMatrix),"Fuse offset scale removed");
+    assertEquals(NODE_FUSED_INPUT_OFFSET_SCALE,getFunctionType(aNode2.func),"Fuse offset scale type");
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Fuse offset scale valid");
+
+    runMatrix(&testMatrix);
+    assertEquals(15,aNode2.result,"Fuse offset scale result");
+    assertEquals(15,testOutputBuffer[0],"Fuse offset scale output");
+}
+
+void testFuseCompareTrigger(){
+    Node aNode0, aNode1;
+    aNode0.func = getFunctionPointer(NODE_COMPARE);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 10);
+    addConstantParam(&testMatrix, &aNode0, 5);
+
+    aNode1.func = getFunctionPointer(NODE_TRIGGER);
+    aNode1.result = 0;
+    aNode1.state = 0;
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+
+    assertEquals(1,fusePatch(&testMatrix),"Fuse compare trigger removed");
+    assertEquals(NODE_FUSED_COMPARE_TRIGGER,getFunctionType(aNode1.func),"Fuse compare trigger type");
+
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode1.result,"Fuse compare trigger high");
+    runMatrix(&testMatrix);
+    assertEquals(0,aNode1.result,"Fuse compare trigger low");
+}
+
+void testFuseSharedResult(){
+    Node aNode0, aNode1, aNode2, aNode3;
+    testMatrix.outputBuffer = testOutputBuffer;
+
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 0);
+
+    aNode1.func = getFunctionPointer(NODE_SCALE);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 64);
+
+    aNode2.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, 0);
+    addNodeParam(&testMatrix, &aNode2, 1);
+
+    // the scaled value is also read here, so it can't be fused away
+    aNode3.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode3);
+    addConstantParam(&testMatrix, &aNode3, 1);
+    addNodeParam(&testMatrix, &aNode3, 1);
+
+    assertEquals(0,fusePatch(&testMatrix),"Fuse shared result kept");
+    assertEquals(4,testMatrix.nodesInUse,"Fuse shared result nodes");
+}
+
+void testFuseModDestination(){
+    Node aNode0, aNode1, aNode2, aNode3, aNode4;
+    testMatrix.outputBuffer = testOutputBuffer;
+    testMatrix.inputBuffer[0] = 100;
+
+    aNode0.func = getFunctionPointer(NODE_INPUT);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 0);
+
+    aNode1.func = getFunctionPointer(NODE_MOD_DESTINATION);
+    aNode1.result = 0;
+    addNode(&testMatrix, &aNode1);
+
+    // reads the destination before the mod matrix writes it
+    aNode2.func = getFunctionPointer(NODE_SCALE);
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 0);
+    addNodeParam(&testMatrix, &aNode2, 1);
+
+    aNode3.func = getFunctionPointer(NODE_MOD_MATRIX);
+    addNode(&testMatrix, &aNode3);
+    addNodeParam(&testMatrix, &aNode3, 1);
+    addConstantParam(&testMatrix, &aNode3, 1);
+    addConstantParam(&testMatrix, &aNode3, 100);
+    addConstantParam(&testMatrix, &aNode3, 127);
+
+    aNode4.func = getFunctionPointer(NODE_OUTPUT);
+    addNode(&testMatrix, &aNode4);
+    addConstantParam(&testMatrix, &aNode4, 0);
+    addNodeParam(&testMatrix, &aNode4, 2);
+
+    // the scale can't be moved past the mod matrix
+    assertEquals(0,fusePatch(&testMatrix),"Fuse mod destination kept");
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Fuse mod destination valid");
+
+    runMatrix(&testMatrix);
+    assertEquals(0,testOutputBuffer[0],"Fuse mod destination first run");
+    runMatrix(&testMatrix);
+    assertEquals(77,testOutputBuffer[0],"Fuse mod destination second run");
+}
+
+void testLinkPatch(){
+    Node aNode0, aNode1, aNode2;
+    aNode0.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 3);
+    addConstantParam(&testMatrix, &aNode0, 4);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 10);
+
+    aNode2.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode2);
+    addConstantParam(&testMatrix, &aNode2, 20);
+
+    assertEquals(PATCH_OK,linkPatch(&testMatrix),"Link patch ok");
+    runMatrix(&testMatrix);
+    assertEquals(17,aNode1.result,"Link patch result");
+
+    // constants can change without linking again
+    setParam(&testMatrix, &aNode0, 0, 5);
+    runMatrix(&testMatrix);
+    assertEquals(19,aNode1.result,"Link patch changed constant");
+
+    // node params fall back to lookup until linked again
+    setParam(&testMatrix, &aNode1, 0, 2);
+    runMatrix(&testMatrix);
+    assertEquals(30,aNode1.result,"Link patch changed node param");
+
+    assertEquals(PATCH_INVALID_NODE_INDEX,setParam(&testMatrix, &aNode1, 0, 3),"Link patch set invalid node");
+    forceParam(&aNode1, 0, 3);
+    assertEquals(PATCH_INVALID_NODE_INDEX,linkPatch(&testMatrix),"Link patch invalid");
+}
+
+void testAttenuateParam(){
+    Node aNode0, aNode1, aNode2;
+    aNode0.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 100);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 0);
+
+    aNode2.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 0);
+
+    assertEquals(0,attenuateParam(&testMatrix, &aNode1, 1, 64, 0),"Attenuate constant");
+    assertEquals(0,attenuateParam(&testMatrix, &aNode1, 2, 64, 0),"Attenuate unused");
+    assertEquals(1,attenuateParam(&testMatrix, &aNode1, 0, 64, 10),"Attenuate param");
+    assertEquals(1,attenuateParam(&testMatrix, &aNode2, 0, -128, 0),"Attenuate invert");
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Attenuate valid");
+    runMatrix(&testMatrix);
+    assertEquals(60,aNode1.result,"Attenuate depth and offset");
+    assertEquals(-100,aNode2.result,"Attenuate inverted");
+
+    // attenuating again changes the depth in place
+    assertEquals(1,attenuateParam(&testMatrix, &aNode1, 0, 127, 100),"Attenuate again");
+    assertEquals(2,testMatrix.attenuationsInUse,"Attenuate again in place");
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode1.result,"Attenuate saturate");
+
+    assertEquals(PATCH_OK,linkPatch(&testMatrix),"Attenuate link");
+    runMatrix(&testMatrix);
+    assertEquals(MAX_POSITIVE,aNode1.result,"Attenuate linked");
+    assertEquals(-100,aNode2.result,"Attenuate linked inverted");
+
+    // moving the source keeps the attenuation
+    setParam(&testMatrix, &aNode2, 0, 1);
+    runMatrix(&testMatrix);
+    assertEquals(-127,aNode2.result,"Attenuate moved source");
+}
+
+void testRunMatrixSlice(){
+    Node aNode0, aNode1, aNode2;
+    aNode0.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 1);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode1);
+    addNodeParam(&testMatrix, &aNode1, 0);
+    addConstantParam(&testMatrix, &aNode1, 2);
+
+    aNode2.func = getFunctionPointer(NODE_SUM);
+    aNode2.result = 0;
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 1);
+    addConstantParam(&testMatrix, &aNode2, 3);
+
+    assertEquals(0,runMatrixSlice(&testMatrix, 2),"Slice not completed");
+    assertEquals(0,testMatrix.matrixCalculationCompleted,"Slice not published");
+    assertEquals(3,aNode1.result,"Slice first part");
+    assertEquals(0,aNode2.result,"Slice second part waits");
+
+    assertEquals(1,runMatrixSlice(&testMatrix, 2),"Slice completed");
+    assertEquals(1,testMatrix.matrixCalculationCompleted,"Slice published");
+    assertEquals(6,aNode2.result,"Slice second part");
+    assertEquals(0,testMatrix.nextNode,"Slice restarts");
+}
+
+void testModMatrix(){
+    Node aNode0, aNode1, aNode2, aNode3, aNode4;
+    aNode0.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode0);
+    addConstantParam(&testMatrix, &aNode0, 100);
+
+    aNode1.func = getFunctionPointer(NODE_SUM);
+    addNode(&testMatrix, &aNode1);
+    addConstantParam(&testMatrix, &aNode1, -64);
+
+    aNode2.func = getFunctionPointer(NODE_MOD_MATRIX);
+    addNode(&testMatrix, &aNode2);
+    addNodeParam(&testMatrix, &aNode2, 3);     // first destination
+    addConstantParam(&testMatrix, &aNode2, 2); // two routes
+    addNodeParam(&testMatrix, &aNode2, 0);
+    addConstantParam(&testMatrix, &aNode2, 64);   // 100 * 0.5
+    addNodeParam(&testMatrix, &aNode2, 1);
+    addConstantParam(&testMatrix, &aNode2, -64);  // -64 * -0.5
+    addNodeParam(&testMatrix, &aNode2, 4);     // second destination
+    addConstantParam(&testMatrix, &aNode2, 2); // two routes, saturates
+    addNodeParam(&testMatrix, &aNode2, 0);
+    addConstantParam(&testMatrix, &aNode2, 127);
+    addNodeParam(&testMatrix, &aNode2, 0);
+    addConstantParam(&testMatrix, &aNode2, 127);
+
+    aNode3.func = getFunctionPointer(NODE_MOD_DESTINATION);
+    addNode(&testMatrix, &aNode3);
+    aNode4.func = getFunctionPointer(NODE_MOD_DESTINATION);
+    addNode(&testMatrix, &aNode4);
+
+    assertEquals(PATCH_OK,validatePatch(&testMatrix),"Mod matrix valid");
+    runMatrix(&testMatrix);
+    assertEquals(82,aNode3.result,"Mod matrix sum");
+    assertEquals(MAX_POSITIVE,aNode4.result,"Mod matrix saturate");
+
+    assertEquals(PATCH_INVALID_ROUTING,setParam(&testMatrix, &aNode2, 7, 1),"Mod matrix set routes");
+    assertEquals(PATCH_INVALID_ROUTING,setParam(&testMatrix, &aNode2, 6, 3),"Mod matrix set destination");
+    assertEquals(PATCH_OK,setParam(&testMatrix, &aNode2, 9, 100),"Mod matrix set depth");
+    assertEquals(PATCH_OK,setParam(&testMatrix, &aNode2, 8, 1),"Mod matrix set source");
+
+    forceParam(&aNode2, 7, 3);
+    assertEquals(PATCH_INVALID_ROUTING,validatePatch(&testMatrix),"Mod matrix too many routes");
+    forceParam(&aNode2, 7, 2);
+    forceParam(&aNode2, 6, 0);
+    assertEquals(PATCH_INVALID_ROUTING,validatePatch(&testMatrix),"Mod matrix destination type");
+}
+
+#ifdef TARGET_HOST
+// Differential tests, host only. Random patches are run through the plain
+// interpreter and through the optimized engine in lockstep with the same
+// random inputs, and must give the same outputs and node results on every
+// tick. The first difference is reported with its node and tick.
+
+// optimizations applied to the optimized copy of a patch
+#define DIFF_FUSE 0x01
+#define DIFF_LINK 0x02
+#define DIFF_SLICE 0x04
+#define DIFF_COMPILE 0x08
+
+// The compiled patch is emitted to a file, built into a shared library with
+// the C compiler in CC (cc if not set) and loaded. Its calls into matrix.c
+// resolve to the test runner, which must be linked with -rdynamic and run from
+// the repository root so the headers are found.
+typedef void (*compiledPatch)(Matrix *aMatrix);
+FILE *diffPatchFile;
+void *diffLibrary;
+char diffFileName[64];
+char diffCommand[256];
+
+#define DIFF_PATCHES 40
+#define DIFF_TICKS 200
+
+Matrix referenceMatrix;
+Matrix optimizedMatrix;
+Node referenceNodes[MAX_OPERATIONS];
+Node optimizedNodes[MAX_OPERATIONS];
+matrixint referenceOutputBuffer[MAX_SH_OUTPUTS];
+matrixint optimizedOutputBuffer[MAX_SH_OUTPUTS];
+
+// nodes with the same function in both copies that are still in the
+// optimized matrix, only those results can be compared.
+unsigned short diffCompared[MAX_OPERATIONS];
+
+char diffMessage[MUNIT_MESSAGE_LENGTH];
+
+void diffPatchSink(char character){
+    fputc(character, diffPatchFile);
+}
+
+// Emit the patch in aMatrix, build and load it. Returns its
+// runCompiledPatch(), or 0 if it could not be built. The library is kept open
+// in diffLibrary until closeCompiledPatch().
+compiledPatch compilePatch(Matrix *aMatrix, unsigned short patch){
+    const char *compiler;
+    unsigned short status;
+
+    compiler = getenv("CC");
+    if(compiler == 0){
+        compiler = "cc";
+    }
+    sprintf(diffFileName, "%s/omm-patch-%d-%d.c", P_tmpdir, (int)getpid(), patch);
+    diffPatchFile = fopen(diffFileName, "w");
+    if(diffPatchFile == 0){
+        return 0;
+    }
+    status = emitPatch(aMatrix, diffPatchSink);
+    fclose(diffPatchFile);
+    if(status != PATCH_OK){
+        remove(diffFileName);
+        return 0;
+    }
+
+    sprintf(diffCommand, "%s -DTARGET_HOST -I. -shared -fPIC -o %s.so %s", compiler, diffFileName, diffFileName);
+    status = system(diffCommand);
+    remove(diffFileName);
+    if(status != 0){
+        return 0;
+    }
+    strcat(diffFileName, ".so");
+    diffLibrary = dlopen(diffFileName, RTLD_NOW | RTLD_LOCAL);
+    remove(diffFileName);
+    if(diffLibrary == 0){
+        return 0;
+    }
+    return (compiledPatch)dlsym(diffLibrary, "runCompiledPatch");
+}
+
+void closeCompiledPatch(){
+    if(diffLibrary){
+        dlclose(diffLibrary);
+        diffLibrary = 0;
+    }
+}
+
+// run the patch in benchMatrix both ways for DIFF_TICKS ticks. Returns 0 and
+// records a message at the first difference.
+unsigned short checkDifferential(unsigned short optimizations, unsigned short patch){
+    nodeindex i, nodes;
+    unsigned int tick;
+    unsigned short input;
+    matrixint value;
+    compiledPatch compiled;
+
+    nodes = benchMatrix.nodesInUse;
+    copyBenchPatch(&referenceMatrix, referenceNodes, referenceOutputBuffer);
+    copyBenchPatch(&optimizedMatrix, optimizedNodes, optimizedOutputBuffer);
+
+    if(optimizations & DIFF_FUSE){
+        fusePatch(&optimizedMatrix);
+    }
+    if(optimizations & DIFF_LINK){
+        linkPatch(&optimizedMatrix);
+    }
+    compiled = 0;
+    if(optimizations & DIFF_COMPILE){
+        compiled = compilePatch(&optimizedMatrix, patch);
+        if(compiled == 0){
+            sprintf(diffMessage, "patch %d does not compile", patch);
+            fail(diffMessage);
+            return 0;
+        }
+    }
+
+    for(i = 0; i<nodes; i++){
+        diffCompared[i] = 0;
+    }
+    for(i = 0; i<optimizedMatrix.nodesInUse; i++){
+        diffCompared[optimizedMatrix.nodes[i] - optimizedNodes] = 1;
+    }
+    for(i = 0; i<nodes; i++){
+        // compiled patches keep most results in static variables, only the
+        // outputs can be compared
+        if(referenceNodes[i].func != optimizedNodes[i].func || compiled){
+            diffCompared[i] = 0;
+        }
+    }
+
+    for(tick = 0; tick<DIFF_TICKS; tick++){
+        for(input = 0; input<MAX_INPUTS; input++){
+            value = benchRandomValue();
+            referenceMatrix.inputBuffer[input] = value;
+            optimizedMatrix.inputBuffer[input] = value;
+        }
+
+        runMatrix(&referenceMatrix);
+        if(compiled){
+            compiled(&optimizedMatrix);
+        } else if(optimizations & DIFF_SLICE){
+            while(!runMatrixSlice(&optimizedMatrix, 1 + benchRandom() % 7));
+        } else {
+            runMatrix(&optimizedMatrix);
+        }
+
+        for(i = 0; i<nodes; i++){
+            if(diffCompared[i] && referenceNodes[i].result != optimizedNodes[i].result){
+                sprintf(diffMessage, "patch %d node %d tick %d: %d != %d", patch, i, tick,
+                        referenceNodes[i].result, optimizedNodes[i].result);
+                fail(diffMessage);
+                return 0;
+            }
+        }
+        for(i = 0; i<MAX_SH_OUTPUTS; i++){
+            if(referenceOutputBuffer[i] != optimizedOutputBuffer[i]){
+                sprintf(diffMessage, "patch %d output %d tick %d: %d != %d", patch, i, tick,
+                        referenceOutputBuffer[i], optimizedOutputBuffer[i]);
+                fail(diffMessage);
+                return 0;
+            }
+        }
+        if(referenceMatrix.gateBuffer != optimizedMatrix.gateBuffer){
+            sprintf(diffMessage, "patch %d gates tick %d", patch, tick);
+            fail(diffMessage);
+            return 0;
+        }
+        for(i = 0; i<MAX_GATE_OUTPUTS; i++){
+            if(referenceMatrix.triggerCountdown[i] != optimizedMatrix.triggerCountdown[i]){
+                sprintf(diffMessage, "patch %d trigger %d tick %d", patch, i, tick);
+                fail(diffMessage);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// check random patches of every size with the given optimizations, stops at
+// the first patch that differs.
+void checkRandomPatches(unsigned short optimizations){
+    unsigned short patch, same;
+    benchSeed = 0xACE1 + optimizations;
+    for(patch = 0; patch<DIFF_PATCHES; patch++){
+        generatePatch(1 + benchRandom() % MAX_OPERATIONS, 1 + patch % 8, patch % 9);
+        assertEquals(PATCH_OK, validatePatch(&benchMatrix), "generated patch is valid");
+        same = checkDifferential(optimizations, patch);
+        closeCompiledPatch();
+        if(!same){
+            return;
+        }
+    }
+}
+
+void testDifferentialFused(){
+    checkRandomPatches(DIFF_FUSE);
+}
+
+void testDifferentialLinked(){
+    checkRandomPatches(DIFF_LINK);
+}
+
+void testDifferentialSliced(){
+    checkRandomPatches(DIFF_SLICE);
+}
+
+void testDifferentialAll(){
+    checkRandomPatches(DIFF_FUSE | DIFF_LINK | DIFF_SLICE);
+}
+
+void testDifferentialCompiled(){
+    checkRandomPatches(DIFF_FUSE | DIFF_COMPILE);
+}
+#endif
+
+// setup and run test suite
+void runMatrixTests(){
+    reset();
+    resetTestMatrix();
+    /*
+    add(&testSum);
+    add(&testMultiply);
+    
+    add(&testInvertPositive);
+    add(&testInvertNegative);
+    add(&testInvertMaxNegative);
+    add(&testInvertZero);
+
+    add(&testInvertEachSideZero);
+    add(&testInvertEachSidePositive);
+    add(&testInvertEachSideNegative);
+    
+    add(&testDelayLine);
+
+    add(&testMemorySet);
+    add(&testMemoryHold);
+    add(&testMemoryClear);
+    
+    add(&testLfoPulse);
+    add(&testLfoPulseRetrigger);
+    add(&testLfoPulseStartOnBottom);
+    add(&testSwitch);
+    add(&testCompare);
+    add(&testMax);
+    add(&testMin);
+    add(&testScale);
+    add(&testTrigger);
+    add(&testBinaryAnd);
+    add(&testBinaryOr);
+    */
+
+    add(&testDelayBuffer);
+    add(&testDelayBufferInvalid);
+    add(&testEmitPatchKeepsState);
+    add(&testSequencer);
+    add(&testSequencerDirections);
+    add(&testSequencerInvalid);
+    add(&testDivide);
+    add(&testDivideMagnitude);
+    add(&testAverage);
+    add(&testClamp);
+    add(&testCrossfade);
+    add(&testAbs);
+    add(&testGateOutput);
+    add(&testTriggerOutput);
+    add(&testSlewLinear);
+    add(&testSlewExponential);
+    add(&testSlewConstantTime);
+    add(&testValidatePatch);
+    add(&testSetParamRange);
+    add(&testNodeRate);
+    add(&testScaleIncrement);
+    add(&testStaggerNodeRates);
+    add(&testGetFunctionType);
+    add(&testFuseInputScaleOutput);
+    add(&testFuseInputOffsetScale);
+    add(&testFuseCompareTrigger);
+    add(&testFuseSharedResult);
+    add(&testFuseModDestination);
+    add(&testLinkPatch);
+    add(&testRunMatrixSlice);
+    add(&testModMatrix);
+    add(&testAttenuateParam);
+#ifdef TARGET_HOST
+    add(&testDifferentialFused);
+    add(&testDifferentialLinked);
+    add(&testDifferentialSliced);
+    add(&testDifferentialAll);
+    add(&testDifferentialCompiled);
+#endif
+
+    run(resetTestMatrix);
+}
+
+// TODO void nodeFuncRamp(Node *aNode){
 // TODO void nodeFuncLfoPulse(Node *aNode){
\ No newline at end of file
@@ -1,31 +1,52 @@
-#ifndef _NODETYPES_H
-#define _NODETYPES_H
-
-// functions
-#define NODE_SUM 0
-#define NODE_INVERT 1
-#define NODE_INVERT_EACH_SIDE 2
-#define NODE_RAMP 3
-#define NODE_DELAY_LINE 4
-#define NODE_INPUT 5
-#define NODE_OUTPUT 6
-#define NODE_MULTIPLY 7
-#define NODE_MEMORY 8
-#define NODE_LFO_PULSE 9
-#define NODE_SWITCH 10
-#define NODE_COMPARE 11
-#define NODE_MAX 12
-#define NODE_MIN 13
-#define NODE_SCALE 14
-#define NODE_TRIGGER 15
-#define NODE_BINARY_AND 16
-#define NODE_BINARY_OR 17
-#define NODE_BINARY_XOR 18
-#define NODE_BINARY_NOT 19
-#define NODE_INPUT 20
-#define NODE_OUTPUT 21
-#define NODE_QUANTIZE 22
-#define NODE_GLIDE 23
-#define NODE_TUNE 24
-#define NODE_POSITIVE_EXP 25
+#ifndef _NODETYPES_H
+#define _NODETYPES_H
+
+// functions
+#define NODE_SUM 0
+#define NODE_INVERT 1
+#define NODE_INVERT_EACH_SIDE 2
+#define NODE_RAMP 3
+#define NODE_DELAY_LINE 4
+#define NODE_INPUT 5
+#define NODE_OUTPUT 6
+#define NODE_MULTIPLY 7
+#define NODE_MEMORY 8
+#define NODE_LFO_PULSE 9
+#define NODE_SWITCH 10
+#define NODE_COMPARE 11
+#define NODE_MAX 12
+#define NODE_MIN 13
+#define NODE_SCALE 14
+#define NODE_TRIGGER 15
+#define NODE_BINARY_AND 16
+#define NODE_BINARY_OR 17
+#define NODE_BINARY_XOR 18
+#define NODE_BINARY_NOT 19
+#define NODE_QUANTIZE 22
+#define NODE_GLIDE 23
+#define NODE_TUNE 24
+#define NODE_POSITIVE_EXP 25
+#define NODE_GATE_OUTPUT 26
+#define NODE_TRIGGER_OUTPUT 27
+#define NODE_SLEW 28
+// fused node chains, created by fusePatch()
+#define NODE_FUSED_INPUT_SCALE_OUTPUT 29
+#define NODE_FUSED_INPUT_OFFSET_SCALE 30
+#define NODE_FUSED_COMPARE_TRIGGER 31
+// modulation matrix and the nodes holding its destinations
+#define NODE_MOD_MATRIX 32
+#define NODE_MOD_DESTINATION 33
+// saturating arithmetic
+#define NODE_DIVIDE 34
+#define NODE_AVERAGE 35
+#define NODE_CLAMP 36
+#define NODE_CROSSFADE 37
+#define NODE_ABS 38
+#define NODE_DELAY_BUFFER 39
+// step sequencer and the node reading its gate
+#define NODE_SEQUENCER 40
+#define NODE_SEQUENCER_GATE 41
+
+// number of node types, must be one more than the last type above
+#define NODE_TYPES 42
 #endif
\ No newline at end of file
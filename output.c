@@ -1,92 +1,456 @@
-#include "types.h"
-#include "config.h"
-
-#define DAC_TRIS TRISC
-#define DAC_CS LATC.B0
-#define DAC_CS_ON 0
-#define DAC_CS_OFF 1
-
-// place where matrix write outputs to
-matrixint *outputBuffer;
-
-// buffer that dac reads from. outputs should be moved here by swapping output
-// buffers before dac starts writing outputs, to make it possible to write to
-// output while simultaneously calculating the next matrix run.
-matrixint *dacBuffer;
-
-// buffers to hold output values, will be mapped to outputBuffer and dacBuffer
-matrixint outputBuffer1[MAX_SH_OUTPUTS];
-matrixint outputBuffer2[MAX_SH_OUTPUTS];
-
-// dac update timing - interval between each dac update (= s&h acquisition time)
-unsigned short dacIntervalTimerStartH;
-unsigned short dacIntervalTimerStartL;
-
-// what sample-and-hold output to update
-unsigned short shToUpdate;
-
-// Write output to DAC. NB: Only positive values are written!
-// TODO: Does not work once we switch to 16 bit.
-void writeToDac(unsigned short output){/*
-    unsigned short positiveOut;
-    if(output > 0) {
-        positiveOut = output; //7 to 8 bit, as input is signed. NB: this means that the maximum value is 254 (as the LSB is 0).
-        positiveOut = positiveOut << 1;
-    } else {
-        positiveOut = 0;
-    }*/
-
-    DAC_CS = DAC_CS_ON;  //must write directly to latch (didn't work with PORTC.B0!)
-
-//    SPI1_write(positiveOut);
-    SPI1_write(output);
-    SPI1_write(0);       // 0 as long as we are working with 8 bit numbers.
-
-    DAC_CS = DAC_CS_OFF; //latches values in DAC.
-}
-
-void dacTimerInit(){
-
-  // Enable GIE (all interrupt sources)
-  // Enable PEIE (all peripheral interrupt sources - timer1, 2, 3 etc)
-  // Enable T0IE (enable TMRO interrupt)
-  // Disable T0IF (clear TMR0 interrupt)
-  INTCON = 0xE0;
-
-  // Timer1 - DAC clock
-  TMR1H = dacIntervalTimerStartH;
-  TMR1L = dacIntervalTimerStartL;
-
-  T1CON = 0xA4; // Set to 16 bit, prescaler of 4 and timer stopped
-  PIR1.TMR1IF = 0; // clear timer 1 interrupt
-  PIE1.TMR1IE = 1; // enable timer 1 interrupt
-}
-
-// Start dac timer, should be run after everything else is ready to go to prevent
-// writing bogus data to outputs.
-void dacTimerStart(){
-  shToUpdate = 0;
-  T1CON.TMR1ON = 1;
-}
-
-void dacTimerStop(){
-  T1CON.TMR1ON = 0;
-}
-
-void dacInit(){
-    SPI1_Init();
-    DAC_TRIS = 0; //output
-    DAC_CS = DAC_CS_OFF;
-}
-
-// initialize output buffers and set buffer pointers
-void outputBufferInit(){
-    unsigned short i;
-    outputBuffer = &outputBuffer1;
-    dacBuffer    = &outputBuffer2;
-
-    for(i=0; i<MAX_SH_OUTPUTS; i++){
-        outputBuffer[i] = 0;
-        dacBuffer[i]    = 0;
-    }
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "output.h"
+
+#define DAC_TRIS TRISC
+#define DAC_CS LATC.B0
+#define DAC_CS_ON 0
+#define DAC_CS_OFF 1
+
+#define GATE_TRIS TRISD
+#define GATE_LAT LATD
+
+// buffer that dac reads from. outputs should be moved here by swapping the
+// output buffer of the matrix before dac starts writing outputs, to make it
+// possible to write to output while simultaneously calculating the next matrix
+// run.
+matrixint *dacBuffer;
+
+// buffers to hold output values, will be mapped to the output buffer of the
+// matrix and dacBuffer
+matrixint outputBuffer1[MAX_SH_OUTPUTS];
+matrixint outputBuffer2[MAX_SH_OUTPUTS];
+
+// dac update timing - interval between each dac update (= s&h acquisition time)
+unsigned short dacIntervalTimerStartH;
+unsigned short dacIntervalTimerStartL;
+
+// what sample-and-hold output to update
+unsigned short shToUpdate;
+
+// dac interval in timer counts, the controller keeps this within these limits.
+// The minimum is set by the S&H acquisition time.
+#define DAC_MIN_INTERVAL 200
+#define DAC_MAX_INTERVAL 20000
+
+// the interval that time based nodes are tuned for
+#define DAC_NOMINAL_INTERVAL 2000
+
+// keep 1/8 of the interval free as headroom
+#define DAC_HEADROOM_SHIFT 3
+
+// move 1/8 of the way towards a faster interval per matrix run
+#define DAC_SETTLE_SHIFT 3
+
+// current dac interval in timer counts
+unsigned int dacInterval;
+
+// time scale of a single S&H rotation at the current dac interval, relative to
+// the nominal interval. See timeScale in the Matrix.
+unsigned int dacTimeScale;
+
+// number of S&H rotations that started without a new matrix result since the
+// dac interval was last adjusted. Incremented by the dac interrupt.
+unsigned short dacMissedSwaps;
+
+// number of S&H rotations started since the dacs were started, wraps around.
+// Incremented by the dac interrupt.
+unsigned int dacRotations;
+
+// Interpolated channels step linearly from their previous value to a new
+// frame over the S&H rotations until the next frame is expected, instead of
+// jumping, so ramps stay smooth when the matrix runs slower than the dacs.
+
+// output mode of each S&H channel, DAC_MODE_* flags
+unsigned short dacChannelMode[MAX_SH_OUTPUTS];
+
+// current value of each channel in 8.8 fixed point, the upper byte is written
+// to the dac.
+int dacLevel[MAX_SH_OUTPUTS];
+
+// change of an interpolated channel per rotation, the level it ends on and
+// the rotations left to get there
+int dacDelta[MAX_SH_OUTPUTS];
+int dacTarget[MAX_SH_OUTPUTS];
+unsigned short dacStepsLeft[MAX_SH_OUTPUTS];
+
+// highest and lowest channel level
+#define DAC_LEVEL_MAX 32767
+#define DAC_LEVEL_MIN -32768
+
+// Per channel calibration, applied once per frame when the frame is moved to
+// the dacs: level = value * gain / 256 + offset, in 8.8 fixed point. Gain and
+// offset are stored in EEPROM, four bytes per channel from
+// DAC_CALIBRATION_EEPROM.
+#define DAC_CALIBRATION_EEPROM 0
+#define DAC_CALIBRATION_BYTES 4
+STATIC_ASSERT(DAC_CALIBRATION_EEPROM + MAX_SH_OUTPUTS * DAC_CALIBRATION_BYTES <= EEPROM_SIZE, calibration_fits_in_eeprom);
+
+unsigned int dacGain[MAX_SH_OUTPUTS];
+int dacOffset[MAX_SH_OUTPUTS];
+
+// fraction of a dac step carried over to the next refresh of a dithered
+// channel
+unsigned short dacError[MAX_SH_OUTPUTS];
+
+// The dac, its timers and the EEPROM are only there on the PIC, the host
+// build runs the rest of the output stage against plain variables.
+#ifndef TARGET_HOST
+// Write output to DAC. NB: Only positive values are written!
+// TODO: Does not work once we switch to 16 bit.
+void writeToDac(unsigned short output){/*
+    unsigned short positiveOut;
+    if(output > 0) {
+        positiveOut = output; //7 to 8 bit, as input is signed. NB: this means that the maximum value is 254 (as the LSB is 0).
+        positiveOut = positiveOut << 1;
+    } else {
+        positiveOut = 0;
+    }*/
+
+    DAC_CS = DAC_CS_ON;  //must write directly to latch (didn't work with PORTC.B0!)
+
+//    SPI1_write(positiveOut);
+    SPI1_write(output);
+    SPI1_write(0);       // 0 as long as we are working with 8 bit numbers.
+
+    DAC_CS = DAC_CS_OFF; //latches values in DAC.
+}
+
+void dacTimerInit(){
+
+  // Enable GIE (all interrupt sources)
+  // Enable PEIE (all peripheral interrupt sources - timer1, 2, 3 etc)
+  // Enable T0IE (enable TMRO interrupt)
+  // Disable T0IF (clear TMR0 interrupt)
+  INTCON = 0xE0;
+
+  // Timer1 - DAC clock
+  TMR1H = dacIntervalTimerStartH;
+  TMR1L = dacIntervalTimerStartL;
+
+  T1CON = 0xA4; // Set to 16 bit, prescaler of 4 and timer stopped
+  PIR1.TMR1IF = 0; // clear timer 1 interrupt
+  PIE1.TMR1IE = 1; // enable timer 1 interrupt
+}
+
+// Start dac timer, should be run after everything else is ready to go to prevent
+// writing bogus data to outputs.
+void dacTimerStart(){
+  shToUpdate = 0;
+  dacRotations = 0;
+  T1CON.TMR1ON = 1;
+}
+
+void dacTimerStop(){
+  T1CON.TMR1ON = 0;
+}
+
+void dacInit(){
+    SPI1_Init();
+    DAC_TRIS = 0; //output
+    DAC_CS = DAC_CS_OFF;
+}
+#endif
+
+// initialize output buffers and set buffer pointers
+void outputBufferInit(Matrix *aMatrix){
+    unsigned short i;
+    aMatrix->outputBuffer = outputBuffer1;
+    dacBuffer             = outputBuffer2;
+
+    for(i=0; i<MAX_SH_OUTPUTS; i++){
+        aMatrix->outputBuffer[i] = 0;
+        dacBuffer[i]             = 0;
+        dacChannelMode[i]        = DAC_MODE_DIRECT;
+        dacLevel[i]              = 0;
+        dacStepsLeft[i]          = 0;
+        dacGain[i]               = DAC_GAIN_UNITY;
+        dacOffset[i]             = 0;
+        dacError[i]              = 0;
+    }
+}
+
+// set the output mode of a S&H channel, see DAC_MODE_*
+void setDacChannelMode(unsigned short channel, unsigned short mode){
+    dacChannelMode[channel] = mode;
+}
+
+// Calibrated level of a channel for an output value, in 8.8 fixed point.
+// Kept low enough that stepping to it can not overflow.
+int calibrateDacValue(unsigned short channel, matrixint value){
+    long level;
+    level = value;
+    level = level * dacGain[channel] + dacOffset[channel];
+    if(level > DAC_LEVEL_MAX){
+        return DAC_LEVEL_MAX;
+    } else if(level < DAC_LEVEL_MIN){
+        return DAC_LEVEL_MIN;
+    }
+    return level;
+}
+
+// Calibrate the frame that was just swapped into the dac buffer and start
+// moving the channels to it, in a single pass per frame. Called from the main
+// loop with the number of S&H rotations since the previous frame, which the
+// next frame is expected to take too, so the dac interrupt only has to add.
+// Direct channels, and all channels when frames come every rotation, are set
+// at once. Interpolated channels step from their current level and land on
+// the new level after that many rotations.
+void startDacFrame(unsigned short rotations){
+    unsigned short channel;
+    int target;
+    long difference;
+    unsigned int reciprocal;
+
+    // 1/rotations in 0.16 fixed point, so each channel only multiplies
+    reciprocal = 0;
+    if(rotations > 1){
+        reciprocal = 65536 / rotations;
+    }
+
+    for(channel = 0; channel < MAX_SH_OUTPUTS; channel++){
+        target = calibrateDacValue(channel, dacBuffer[channel]);
+
+        if((dacChannelMode[channel] & DAC_MODE_INTERPOLATE) && reciprocal){
+            // the interrupt no longer changes the level once the steps left
+            // are cleared, a single byte write
+            dacStepsLeft[channel] = 0;
+            difference = target;
+            difference = difference - dacLevel[channel];
+            // rounded towards 0, the last step makes up the rest
+            if(difference >= 0){
+                dacDelta[channel] = (difference * reciprocal) >> 16;
+            } else {
+                dacDelta[channel] = -((-difference * reciprocal) >> 16);
+            }
+            dacTarget[channel] = target;
+            dacStepsLeft[channel] = rotations;
+        } else {
+            // the interrupt reads both bytes of the level
+            INTCON.GIE = 0;
+            dacLevel[channel] = target;
+            dacStepsLeft[channel] = 0;
+            INTCON.GIE = 1;
+        }
+    }
+}
+
+// Value to write to a S&H channel, called by the dac interrupt for every tick.
+// Channels being stepped to a new frame take one step per rotation, the last
+// step sets the level of the frame so the rounding of the steps is not left
+// over.
+// Dithered channels add the fraction below one dac step to an error term and
+// write one step more whenever it overflows, so the S&H averages out to the
+// level between two steps (first order error feedback).
+matrixint nextDacValue(unsigned short channel){
+    matrixint output;
+    unsigned int fraction;
+
+    if(dacStepsLeft[channel]){
+        dacStepsLeft[channel]--;
+        if(dacStepsLeft[channel]){
+            dacLevel[channel] += dacDelta[channel];
+        } else {
+            dacLevel[channel] = dacTarget[channel];
+        }
+    }
+
+    output = Hi(dacLevel[channel]);
+    if(dacChannelMode[channel] & DAC_MODE_DITHER){
+        fraction = Lo(dacLevel[channel]);
+        fraction += dacError[channel];
+        dacError[channel] = Lo(fraction);
+        if(Hi(fraction) && output != MAX_POSITIVE){
+            output++;
+        }
+    }
+    return output;
+}
+
+// Set the calibration of a channel. Gain is in 1/256, DAC_GAIN_UNITY leaves
+// the value unchanged, offset is in 1/256 of a dac step.
+void setDacCalibration(unsigned short channel, unsigned int gain, int offset){
+    dacGain[channel] = gain;
+    dacOffset[channel] = offset;
+}
+
+// Read the calibration of all channels from EEPROM. Channels that were never
+// calibrated (erased EEPROM reads 0xFF) are left uncalibrated.
+void loadDacCalibration(){
+    unsigned short channel;
+    unsigned int address;
+    unsigned int gain;
+    int offset;
+    unsigned short offsetHigh;
+
+    address = DAC_CALIBRATION_EEPROM;
+    for(channel = 0; channel < MAX_SH_OUTPUTS; channel++){
+        // int may be wider than the two bytes set below, the offset is sign
+        // extended
+        gain = 0;
+        Hi(gain) = EEPROM_Read(address);
+        Lo(gain) = EEPROM_Read(address + 1);
+        offsetHigh = EEPROM_Read(address + 2);
+        offset = 0;
+        if(offsetHigh & 0x80){
+            offset = -1;
+        }
+        Hi(offset) = offsetHigh;
+        Lo(offset) = EEPROM_Read(address + 3);
+        address += DAC_CALIBRATION_BYTES;
+
+        if(gain == 0xFFFF){
+            setDacCalibration(channel, DAC_GAIN_UNITY, 0);
+        } else {
+            setDacCalibration(channel, gain, offset);
+        }
+    }
+}
+
+// write the calibration of all channels to EEPROM
+void saveDacCalibration(){
+    unsigned short channel;
+    unsigned int address;
+
+    address = DAC_CALIBRATION_EEPROM;
+    for(channel = 0; channel < MAX_SH_OUTPUTS; channel++){
+        EEPROM_Write(address, Hi(dacGain[channel]));
+        EEPROM_Write(address + 1, Lo(dacGain[channel]));
+        EEPROM_Write(address + 2, Hi(dacOffset[channel]));
+        EEPROM_Write(address + 3, Lo(dacOffset[channel]));
+        address += DAC_CALIBRATION_BYTES;
+    }
+}
+
+
+// initialize gate output pins and clear all gates and triggers
+void gateOutputInit(Matrix *aMatrix){
+    unsigned short i;
+    GATE_TRIS = 0; //output
+    aMatrix->gateBuffer = 0;
+    for(i=0; i<MAX_GATE_OUTPUTS; i++){
+        aMatrix->triggerCountdown[i] = 0;
+    }
+    GATE_LAT = 0;
+}
+
+// Write gates and running trigger pulses to the gate port. Called once per dac
+// tick from the timer interrupt so gates do not have to wait for the
+// sample-and-hold rotation, all pins are updated with a single port write.
+void flushGateOutputs(Matrix *aMatrix){
+    unsigned short i, pinMask, triggerBits;
+
+    triggerBits = 0;
+    pinMask = 1;
+    for(i=0; i<MAX_GATE_OUTPUTS; i++){
+        if(aMatrix->triggerCountdown[i]){
+            aMatrix->triggerCountdown[i]--;
+            triggerBits |= pinMask;
+        }
+        pinMask = pinMask << 1;
+    }
+
+    GATE_LAT = aMatrix->gateBuffer | triggerBits;
+}
+
+#ifndef TARGET_HOST
+// Timer3 measures how long each matrix run takes, in the same units as the dac
+// timer (Fosc/4 with a prescaler of 4).
+void matrixTimerInit(){
+    T3CON = 0xA1; // 16 bit, prescaler of 4, timer running
+}
+
+void matrixTimerStart(){
+    TMR3H = 0;
+    TMR3L = 0;
+}
+
+unsigned int matrixTimerRead(){
+    unsigned int counts;
+    Lo(counts) = TMR3L; // reading the low byte latches the high byte
+    Hi(counts) = TMR3H;
+    return counts;
+}
+#endif
+
+// Set the dac interval in timer counts. The timer start value is read by the
+// dac interrupt, so interrupts are disabled while both bytes are written. Time
+// based nodes are told about the change through dacTimeScale.
+void setDacInterval(unsigned int interval){
+    unsigned int timerStart;
+    unsigned long scale;
+
+    dacInterval = interval;
+    timerStart = 65536 - interval;
+
+    INTCON.GIE = 0;
+    dacIntervalTimerStartH = Hi(timerStart);
+    dacIntervalTimerStartL = Lo(timerStart);
+    INTCON.GIE = 1;
+
+    scale = interval;
+    scale = (scale << TIME_SCALE_SHIFT) / DAC_NOMINAL_INTERVAL;
+    dacTimeScale = scale;
+}
+
+// the timer start value the dac interrupt loads, from its two bytes
+unsigned int getDacTimerStart(){
+    unsigned int timerStart;
+    timerStart = 0; // int may be wider than the two bytes set below
+    Hi(timerStart) = dacIntervalTimerStartH;
+    Lo(timerStart) = dacIntervalTimerStartL;
+    return timerStart;
+}
+
+// start the rate controller from the dac interval currently set
+void dacRateInit(){
+    unsigned int timerStart, interval;
+    timerStart = getDacTimerStart();
+    dacMissedSwaps = 0;
+
+    interval = 65536 - timerStart;
+    if(interval == 0 || interval > DAC_MAX_INTERVAL){
+        interval = DAC_MAX_INTERVAL;
+    } else if(interval < DAC_MIN_INTERVAL){
+        interval = DAC_MIN_INTERVAL;
+    }
+    setDacInterval(interval);
+}
+
+// Adjust the dac interval to the measured matrix load. Called after each
+// matrix run with the number of timer counts the run took. The interval is made
+// longer at once when the matrix can't keep up or a rotation started without
+// new data, and moves slowly towards faster rates to avoid oscillating, so light
+// patches end up at the fastest rate they can sustain.
+void adaptDacInterval(unsigned int matrixCounts){
+    unsigned long required;
+    unsigned int interval;
+
+    // counts per dac tick needed to finish the matrix within one rotation
+    required = matrixCounts / MAX_SH_OUTPUTS + DAC_INTERRUPT_COUNTS;
+    required += required >> DAC_HEADROOM_SHIFT;
+
+    if(dacMissedSwaps){
+        dacMissedSwaps = 0;
+        if(required < dacInterval + (dacInterval >> 2)){
+            required = dacInterval + (dacInterval >> 2);
+        }
+    }
+
+    if(required >= dacInterval){
+        if(required > DAC_MAX_INTERVAL){
+            required = DAC_MAX_INTERVAL;
+        }
+        interval = required;
+    } else {
+        interval = dacInterval - ((dacInterval - required) >> DAC_SETTLE_SHIFT);
+        if(interval < DAC_MIN_INTERVAL){
+            interval = DAC_MIN_INTERVAL;
+        }
+    }
+
+    if(interval != dacInterval){
+        setDacInterval(interval);
+    }
 }
\ No newline at end of file
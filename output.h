@@ -1,18 +1,49 @@
-#ifndef _OUTPUT_H
-#define _OUTPUT_H
-#include "config.h"
-
-extern matrixint *outputBuffer;
-extern matrixint *dacBuffer;
-extern unsigned short dacIntervalTimerStartH;
-extern unsigned short dacIntervalTimerStartL;
-extern unsigned short shToUpdate;
-
-void writeToDac(unsigned short output);
-void dacTimerInit();
-void dacTimerStart();
-void dacTimerStop();
-void dacInit();
-void outputBufferInit();
-
+#ifndef _OUTPUT_H
+#define _OUTPUT_H
+#include "config.h"
+#include "types.h"
+
+extern matrixint *dacBuffer;
+extern unsigned short dacIntervalTimerStartH;
+extern unsigned short dacIntervalTimerStartL;
+extern unsigned short shToUpdate;
+extern unsigned int dacInterval;
+extern unsigned int dacTimeScale;
+extern unsigned short dacMissedSwaps;
+extern unsigned int dacRotations;
+
+// timer counts used by each dac interrupt
+#define DAC_INTERRUPT_COUNTS 50
+
+// S&H channel output modes
+#define DAC_MODE_DIRECT 0
+#define DAC_MODE_INTERPOLATE 0x01
+#define DAC_MODE_DITHER 0x02
+
+// calibration gain that leaves output values unchanged
+#define DAC_GAIN_UNITY 256
+
+void writeToDac(unsigned short output);
+void dacTimerInit();
+void dacTimerStart();
+void dacTimerStop();
+void dacInit();
+void outputBufferInit(Matrix *aMatrix);
+void setDacChannelMode(unsigned short channel, unsigned short mode);
+int calibrateDacValue(unsigned short channel, matrixint value);
+void startDacFrame(unsigned short rotations);
+matrixint nextDacValue(unsigned short channel);
+void setDacCalibration(unsigned short channel, unsigned int gain, int offset);
+void loadDacCalibration();
+void saveDacCalibration();
+void gateOutputInit(Matrix *aMatrix);
+void flushGateOutputs(Matrix *aMatrix);
+void matrixTimerInit();
+void matrixTimerStart();
+unsigned int matrixTimerRead();
+void setDacInterval(unsigned int interval);
+unsigned int getDacTimerStart();
+void dacRateInit();
+void adaptDacInterval(unsigned int matrixCounts);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "test/munit.h"
+#include "test/asserts.h"
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "output.h"
+
+// matrix whose output buffer is swapped with the dac buffer
+Matrix outputTestMatrix;
+
+// start each test at the nominal dac rate with fresh buffers
+void resetOutputTest(){
+    outputBufferInit(&outputTestMatrix);
+    setDacInterval(2000);
+    dacMissedSwaps = 0;
+}
+
+void testSetDacInterval(){
+    setDacInterval(4000);
+    assertEquals(4000,dacInterval,"Dac interval");
+    assertEquals(0xF0,dacIntervalTimerStartH,"Dac timer start high");
+    assertEquals(0x60,dacIntervalTimerStartL,"Dac timer start low");
+    assertEquals(TIME_SCALE_NOMINAL * 2,dacTimeScale,"Dac time scale");
+    assertEquals(61536,getDacTimerStart(),"Dac timer start");
+}
+
+void testDacRateInit(){
+    dacIntervalTimerStartH = 0xFC;
+    dacIntervalTimerStartL = 0x18;
+    dacRateInit();
+    assertEquals(1000,dacInterval,"Dac rate init");
+
+    // a timer start that was never set starts at the slowest rate
+    dacIntervalTimerStartH = 0;
+    dacIntervalTimerStartL = 0;
+    dacRateInit();
+    assertEquals(20000,dacInterval,"Dac rate init unset");
+}
+
+void testAdaptDacIntervalSlower(){
+    // 4000 counts per tick, plus interrupt and headroom, is taken at once
+    adaptDacInterval(MAX_SH_OUTPUTS * 4000);
+    assertEquals(4556,dacInterval,"Adapt dac interval slower");
+    assertEquals(0xEE,dacIntervalTimerStartH,"Adapt dac interval timer start high");
+    assertEquals(0x34,dacIntervalTimerStartL,"Adapt dac interval timer start low");
+}
+
+void testAdaptDacIntervalFaster(){
+    // moves 1/8 of the way towards the 1181 counts the load needs
+    adaptDacInterval(MAX_SH_OUTPUTS * 1000);
+    assertEquals(1898,dacInterval,"Adapt dac interval faster");
+    adaptDacInterval(MAX_SH_OUTPUTS * 1000);
+    assertEquals(1809,dacInterval,"Adapt dac interval settles");
+}
+
+void testAdaptDacIntervalMissedSwaps(){
+    dacMissedSwaps = 2;
+    adaptDacInterval(0);
+    assertEquals(2500,dacInterval,"Adapt dac interval missed swaps");
+    assertEquals(0,dacMissedSwaps,"Adapt dac interval clears missed swaps");
+}
+
+void testAdaptDacIntervalLimits(){
+    setDacInterval(19000);
+    dacMissedSwaps = 1;
+    adaptDacInterval(0);
+    assertEquals(20000,dacInterval,"Adapt dac interval maximum");
+
+    setDacInterval(208);
+    adaptDacInterval(0);
+    assertEquals(200,dacInterval,"Adapt dac interval minimum");
+}
+
+// the dac buffer after a matrix run swapped it in, the given number of S&H
+// rotations after the previous one
+void setDacFrame(matrixint value0, matrixint value1, unsigned short rotations){
+    dacBuffer[0] = value0;
+    dacBuffer[1] = value1;
+    startDacFrame(rotations);
+}
+
+void testDirectChannel(){
+    setDacFrame(100, -28, 4);
+    assertEquals(100,nextDacValue(0),"Direct channel");
+    assertEquals(-28,nextDacValue(1),"Direct channel negative");
+    assertEquals(100,nextDacValue(0),"Direct channel holds");
+}
+
+void testInterpolatedChannel(){
+    setDacChannelMode(0, DAC_MODE_INTERPOLATE);
+    setDacFrame(100, 100, 4);
+    assertEquals(25,nextDacValue(0),"Interpolate step 1");
+    assertEquals(50,nextDacValue(0),"Interpolate step 2");
+    assertEquals(75,nextDacValue(0),"Interpolate step 3");
+    assertEquals(100,nextDacValue(0),"Interpolate step 4");
+    assertEquals(100,nextDacValue(0),"Interpolate holds");
+    assertEquals(100,nextDacValue(1),"Interpolate leaves direct channel");
+
+    setDacFrame(-28, 100, 4);
+    assertEquals(68,nextDacValue(0),"Interpolate down step 1");
+    assertEquals(36,nextDacValue(0),"Interpolate down step 2");
+    assertEquals(4,nextDacValue(0),"Interpolate down step 3");
+    assertEquals(-28,nextDacValue(0),"Interpolate down step 4");
+    assertEquals(-28,nextDacValue(0),"Interpolate down holds");
+}
+
+void testInterpolatedChannelNewFrame(){
+    setDacChannelMode(0, DAC_MODE_INTERPOLATE);
+    setDacFrame(64, 0, 4);
+    nextDacValue(0);
+    nextDacValue(0);
+
+    // a frame arriving halfway continues from the level reached
+    setDacFrame(0, 0, 4);
+    assertEquals(24,nextDacValue(0),"Interpolate new frame step 1");
+    assertEquals(16,nextDacValue(0),"Interpolate new frame step 2");
+    assertEquals(8,nextDacValue(0),"Interpolate new frame step 3");
+    assertEquals(0,nextDacValue(0),"Interpolate new frame step 4");
+}
+
+void testInterpolatedChannelFrameRate(){
+    setDacChannelMode(0, DAC_MODE_INTERPOLATE);
+
+    // frames every rotation leave nothing to interpolate
+    setDacFrame(100, 0, 1);
+    assertEquals(100,nextDacValue(0),"Interpolate every rotation");
+
+    // steps over all rotations until the next frame, without holding early
+    setDacFrame(-28, 0, 8);
+    assertEquals(84,nextDacValue(0),"Interpolate slow frame step 1");
+    assertEquals(68,nextDacValue(0),"Interpolate slow frame step 2");
+    nextDacValue(0);
+    assertEquals(36,nextDacValue(0),"Interpolate slow frame step 4");
+    nextDacValue(0);
+    nextDacValue(0);
+    assertEquals(-12,nextDacValue(0),"Interpolate slow frame step 7");
+    assertEquals(-28,nextDacValue(0),"Interpolate slow frame step 8");
+    assertEquals(-28,nextDacValue(0),"Interpolate slow frame holds");
+
+    // steps that don't divide the difference
+    setDacFrame(0, 0, 3);
+    assertEquals(-19,nextDacValue(0),"Interpolate uneven step 1");
+    assertEquals(-10,nextDacValue(0),"Interpolate uneven step 2");
+    assertEquals(0,nextDacValue(0),"Interpolate uneven step 3");
+}
+
+void testInterpolatedChannelLandsOnFrame(){
+    setDacChannelMode(0, DAC_MODE_INTERPOLATE);
+
+    // just below the next dac step, the steps round down
+    setDacCalibration(0, DAC_GAIN_UNITY, 255);
+    setDacFrame(0, 0, 4);
+    nextDacValue(0);
+    nextDacValue(0);
+    nextDacValue(0);
+    assertEquals(0,nextDacValue(0),"Interpolate lands below step");
+    assertEquals(0,nextDacValue(0),"Interpolate holds below step");
+
+    // just below 0, less than a step per rotation
+    setDacCalibration(0, DAC_GAIN_UNITY, -1);
+    setDacFrame(0, 0, 4);
+    nextDacValue(0);
+    nextDacValue(0);
+    nextDacValue(0);
+    assertEquals(-1,nextDacValue(0),"Interpolate lands below 0");
+}
+
+void testCalibrateDacValue(){
+    assertEquals(-1280,calibrateDacValue(0, -5),"Calibrate unity");
+    setDacCalibration(0, 512, 128);
+    assertEquals(5248,calibrateDacValue(0, 10),"Calibrate gain and offset");
+    assertEquals(32767,calibrateDacValue(0, 127),"Calibrate maximum");
+    assertEquals(-32768,calibrateDacValue(0, -128),"Calibrate minimum");
+    assertEquals(-1280,calibrateDacValue(1, -5),"Calibrate other channel");
+}
+
+void testCalibratedFrame(){
+    setDacCalibration(0, 128, -256);
+    setDacFrame(100, 100, 1);
+    assertEquals(49,nextDacValue(0),"Calibrated frame");
+    assertEquals(100,nextDacValue(1),"Uncalibrated frame");
+}
+
+// NB: overwrites the calibration stored in EEPROM
+void testDacCalibrationEeprom(){
+    setDacCalibration(0, 300, -200);
+    setDacCalibration(1, 0xFFFF, 0);
+    saveDacCalibration();
+
+    outputBufferInit(&outputTestMatrix);
+    loadDacCalibration();
+    assertEquals(-2000,calibrateDacValue(0, -6),"Load calibration");
+    // an erased channel reads as uncalibrated
+    assertEquals(-1536,calibrateDacValue(1, -6),"Load erased calibration");
+    assertEquals(-1536,calibrateDacValue(2, -6),"Load unity calibration");
+}
+
+void testDitheredChannel(){
+    unsigned short i;
+    int sum;
+
+    // a quarter step above 10
+    setDacChannelMode(0, DAC_MODE_DITHER);
+    setDacCalibration(0, DAC_GAIN_UNITY, 64);
+    setDacCalibration(1, DAC_GAIN_UNITY, 64);
+    setDacFrame(10, 10, 1);
+    assertEquals(10,nextDacValue(0),"Dither tick 1");
+    assertEquals(10,nextDacValue(0),"Dither tick 2");
+    assertEquals(10,nextDacValue(0),"Dither tick 3");
+    assertEquals(11,nextDacValue(0),"Dither tick 4");
+    assertEquals(10,nextDacValue(1),"Dither leaves direct channel");
+
+    sum = 0;
+    for(i = 0; i < 64; i++){
+        sum += nextDacValue(0);
+    }
+    assertEquals(64 * 10 + 16,sum,"Dither average");
+}
+
+void testDitheredChannelLimit(){
+    unsigned short i;
+    matrixint value;
+
+    // never steps above the highest output value
+    setDacChannelMode(0, DAC_MODE_DITHER);
+    setDacCalibration(0, DAC_GAIN_UNITY, 255);
+    setDacFrame(127, 0, 1);
+    for(i = 0; i < 8; i++){
+        value = nextDacValue(0);
+        assertEquals(MAX_POSITIVE,value,"Dither limit");
+    }
+}
+
+void testDitheredInterpolatedChannel(){
+    unsigned short i;
+    int sum;
+
+    setDacChannelMode(0, DAC_MODE_INTERPOLATE | DAC_MODE_DITHER);
+    setDacCalibration(0, DAC_GAIN_UNITY, 128);
+    setDacFrame(20, 0, 4);
+    for(i = 0; i < 4; i++){
+        nextDacValue(0);
+    }
+
+    // half a step above 20 once the frame is reached
+    sum = 0;
+    for(i = 0; i < 64; i++){
+        sum += nextDacValue(0);
+    }
+    assertEquals(64 * 20 + 32,sum,"Dither interpolated average");
+}
+
+// setup and run test suite
+void runOutputTests(){
+    reset();
+    resetOutputTest();
+    add(&testSetDacInterval);
+    add(&testDacRateInit);
+    add(&testAdaptDacIntervalSlower);
+    add(&testAdaptDacIntervalFaster);
+    add(&testAdaptDacIntervalMissedSwaps);
+    add(&testAdaptDacIntervalLimits);
+    add(&testDirectChannel);
+    add(&testInterpolatedChannel);
+    add(&testInterpolatedChannelNewFrame);
+    add(&testInterpolatedChannelFrameRate);
+    add(&testInterpolatedChannelLandsOnFrame);
+    add(&testCalibrateDacValue);
+    add(&testCalibratedFrame);
+    add(&testDacCalibrationEeprom);
+    add(&testDitheredChannel);
+    add(&testDitheredChannelLimit);
+    add(&testDitheredInterpolatedChannel);
+    run(resetOutputTest);
+}
\ No newline at end of file
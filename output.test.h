@@ -0,0 +1 @@
+extern void runOutputTests();
\ No newline at end of file
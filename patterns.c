@@ -0,0 +1,24 @@
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "patterns.h"
+
+// Patterns played by sequencer nodes. They are const so they stay in flash
+// and take no RAM, sequencer nodes read the steps in place. Each step is
+// {value, gate, length}, the length counted in triggers.
+
+const SequencerPattern sequencerPatterns[SEQUENCER_PATTERNS] = {
+    // octave bass line
+    {8, {
+        {-48, 1, 1}, {-48, 0, 1}, {-24, 1, 1}, {-48, 1, 1},
+        {-36, 1, 2}, {-24, 1, 1}, {-48, 0, 1}, {-12, 1, 1}
+    }},
+    // rising arpeggio
+    {4, {
+        {0, 1, 1}, {16, 1, 1}, {28, 1, 1}, {48, 1, 1}
+    }},
+    // slow drone changes
+    {2, {
+        {-24, 1, 8}, {-12, 1, 8}
+    }}
+};
\ No newline at end of file
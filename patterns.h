@@ -0,0 +1,11 @@
+#ifndef _PATTERNS_H
+#define _PATTERNS_H
+
+#include "types.h"
+
+// number of patterns in sequencerPatterns
+#define SEQUENCER_PATTERNS 3
+
+extern const SequencerPattern sequencerPatterns[SEQUENCER_PATTERNS];
+
+#endif
\ No newline at end of file
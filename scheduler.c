@@ -0,0 +1,87 @@
+#include "types.h"
+#include "config.h"
+#include "output.h"
+#include "scheduler.h"
+
+// Cooperative scheduler for the main loop. The first task added is the
+// foreground task, i.e. the matrix, and is offered the processor on every
+// pass. Background tasks only run in the slack left before the next S&H
+// buffer swap, so the matrix never starts a frame late because of
+// housekeeping. Between background tasks that fit, the one that is most
+// overdue runs first, ties go to the task added first.
+
+void schedulerInit(Scheduler *aScheduler){
+    aScheduler->tasksInUse = 0;
+    aScheduler->slack = SCHEDULER_NO_SLACK_MEASURED;
+    aScheduler->minimumSlack = SCHEDULER_NO_SLACK_MEASURED;
+}
+
+// Add a task with func, cost and period set. Tasks must be added in priority
+// order, starting with the foreground task. Returns 0 if there is no room.
+unsigned short addTask(Scheduler *aScheduler, Task *aTask){
+    if(aScheduler->tasksInUse == MAX_TASKS){
+        return 0;
+    }
+    aTask->due = dacRotations;
+    aScheduler->tasks[aScheduler->tasksInUse] = aTask;
+    aScheduler->tasksInUse++;
+    return 1;
+}
+
+// Timer counts left until the dac interrupt swaps buffers at the start of the
+// next S&H rotation, without the time taken by the interrupt itself.
+unsigned int getSlack(){
+    unsigned long counts;
+    unsigned short ticksLeft;
+
+    ticksLeft = MAX_SH_OUTPUTS - shToUpdate;
+    counts = dacInterval - DAC_INTERRUPT_COUNTS;
+    counts = counts * ticksLeft;
+    if(counts > 0xFFFE){
+        return 0xFFFE;
+    }
+    return counts;
+}
+
+// One pass of the main loop: offer the foreground task the processor, then
+// run at most one background task that fits in the time left.
+void runScheduler(Scheduler *aScheduler){
+    unsigned short i;
+    unsigned int slack, now;
+    int lateness, worstLateness;
+    Task *aTask, *nextTask;
+
+    if(aScheduler->tasksInUse == 0){
+        return;
+    }
+
+    slack = getSlack();
+    if(aScheduler->tasks[0]->func()){
+        // measure how much time the foreground task left
+        slack = getSlack();
+        aScheduler->slack = slack;
+        if(slack < aScheduler->minimumSlack){
+            aScheduler->minimumSlack = slack;
+        }
+    }
+
+    now = dacRotations;
+    nextTask = 0;
+    worstLateness = 0;
+    for(i = 1; i < aScheduler->tasksInUse; i++){
+        aTask = aScheduler->tasks[i];
+        if(aTask->cost > slack){
+            continue;
+        }
+        lateness = now - aTask->due;
+        if(nextTask == 0 || lateness > worstLateness){
+            nextTask = aTask;
+            worstLateness = lateness;
+        }
+    }
+
+    if(nextTask != 0){
+        nextTask->func();
+        nextTask->due = now + nextTask->period;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+// most tasks the main loop can run
+#define MAX_TASKS 6
+
+// slack before any cycle has been measured
+#define SCHEDULER_NO_SLACK_MEASURED 0xFFFF
+
+// task run by the main loop, returns 1 if it did any work
+typedef unsigned short (*taskFunction)();
+
+typedef struct task{
+    // function to run
+    taskFunction func;
+
+    // worst case time of a single call, in dac timer counts
+    unsigned int cost;
+
+    // the task should run at least every period S&H rotations, used to pick
+    // between background tasks. 0 runs it whenever there is time.
+    unsigned int period;
+
+    // rotation the task is due to run next
+    unsigned int due;
+} Task;
+
+typedef struct scheduler{
+    // tasks in priority order, the first one is the foreground task
+    Task *tasks[MAX_TASKS];
+    unsigned short tasksInUse;
+
+    // timer counts left until the next buffer swap when the foreground task
+    // last did work, and the lowest seen since the scheduler was started.
+    unsigned int slack;
+    unsigned int minimumSlack;
+} Scheduler;
+
+void schedulerInit(Scheduler *aScheduler);
+unsigned short addTask(Scheduler *aScheduler, Task *aTask);
+unsigned int getSlack();
+void runScheduler(Scheduler *aScheduler);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "test/munit.h"
+#include "test/asserts.h"
+#include "types.h"
+#include "config.h"
+#include "output.h"
+#include "scheduler.h"
+
+Scheduler testScheduler;
+Task foregroundTask, firstTask, secondTask, thirdTask;
+
+// order the tasks ran in, one letter per task
+char taskLog[8];
+unsigned short taskLogged;
+
+// what the foreground task returns, and the S&H output it leaves the dacs at
+unsigned short foregroundWork;
+unsigned short foregroundShToUpdate;
+
+void logTask(char name){
+    if(taskLogged < sizeof(taskLog) - 1){
+        taskLog[taskLogged] = name;
+        taskLogged++;
+        taskLog[taskLogged] = 0;
+    }
+}
+
+unsigned short foregroundTaskFunc(){
+    logTask('F');
+    shToUpdate = foregroundShToUpdate;
+    return foregroundWork;
+}
+
+unsigned short firstTaskFunc(){
+    logTask('A');
+    return 1;
+}
+
+unsigned short secondTaskFunc(){
+    logTask('B');
+    return 1;
+}
+
+unsigned short thirdTaskFunc(){
+    logTask('C');
+    return 1;
+}
+
+// the log of the tasks run so far
+unsigned short taskLogEquals(char *expected){
+    unsigned short i;
+    for(i = 0; expected[i] || taskLog[i]; i++){
+        if(expected[i] != taskLog[i]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void setTask(Task *aTask, taskFunction func, unsigned int cost, unsigned int period){
+    aTask->func = func;
+    aTask->cost = cost;
+    aTask->period = period;
+}
+
+// start each test at the beginning of a rotation at the nominal dac rate, with
+// a foreground task that does work without using any time
+void resetSchedulerTest(){
+    schedulerInit(&testScheduler);
+    setDacInterval(2000);
+    dacRotations = 0;
+    shToUpdate = 0;
+    taskLogged = 0;
+    taskLog[0] = 0;
+    foregroundWork = 1;
+    foregroundShToUpdate = 0;
+    setTask(&foregroundTask, foregroundTaskFunc, 0, 0);
+    setTask(&firstTask, firstTaskFunc, 100, 4);
+    setTask(&secondTask, secondTaskFunc, 100, 4);
+    setTask(&thirdTask, thirdTaskFunc, 100, 4);
+}
+
+void testGetSlack(){
+    assertEquals(0xFFFE,getSlack(),"Slack limit");
+    shToUpdate = MAX_SH_OUTPUTS - 1;
+    assertEquals(1950,getSlack(),"Slack last tick");
+    shToUpdate = MAX_SH_OUTPUTS - 2;
+    assertEquals(3900,getSlack(),"Slack two ticks");
+}
+
+void testAddTask(){
+    unsigned short i;
+    dacRotations = 7;
+    for(i = 0; i < MAX_TASKS; i++){
+        assertEquals(1,addTask(&testScheduler, &firstTask),"Add task");
+    }
+    assertEquals(7,firstTask.due,"Add task due now");
+    assertEquals(0,addTask(&testScheduler, &secondTask),"Add task full");
+    assertEquals(MAX_TASKS,testScheduler.tasksInUse,"Add task count");
+}
+
+void testSchedulerNoTasks(){
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals(""),"Scheduler without tasks");
+}
+
+void testSchedulerForegroundFirst(){
+    addTask(&testScheduler, &foregroundTask);
+    addTask(&testScheduler, &firstTask);
+    runScheduler(&testScheduler);
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals("FAFA"),"Foreground runs first");
+}
+
+void testSchedulerAddedOrder(){
+    addTask(&testScheduler, &foregroundTask);
+    addTask(&testScheduler, &firstTask);
+    addTask(&testScheduler, &secondTask);
+    addTask(&testScheduler, &thirdTask);
+
+    // one background task per pass, ties go to the task added first
+    runScheduler(&testScheduler);
+    runScheduler(&testScheduler);
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals("FAFBFC"),"Background tasks in added order");
+    assertEquals(4,firstTask.due,"Background task due after period");
+}
+
+void testSchedulerMostOverdue(){
+    addTask(&testScheduler, &foregroundTask);
+    addTask(&testScheduler, &firstTask);
+    addTask(&testScheduler, &secondTask);
+    addTask(&testScheduler, &thirdTask);
+    dacRotations = 10;
+    firstTask.due = 8;
+    secondTask.due = 2;
+    thirdTask.due = 12;
+
+    runScheduler(&testScheduler);
+    runScheduler(&testScheduler);
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals("FBFAFC"),"Most overdue task first");
+}
+
+void testSchedulerSlack(){
+    addTask(&testScheduler, &foregroundTask);
+    addTask(&testScheduler, &firstTask);
+    addTask(&testScheduler, &secondTask);
+    firstTask.cost = 2000;
+
+    // the foreground task leaves one dac tick, too short for the first task
+    foregroundShToUpdate = MAX_SH_OUTPUTS - 1;
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals("FB"),"Background task over slack skipped");
+    assertEquals(1950,testScheduler.slack,"Scheduler slack");
+    assertEquals(1950,testScheduler.minimumSlack,"Scheduler minimum slack");
+
+    foregroundShToUpdate = MAX_SH_OUTPUTS - 2;
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals("FBFA"),"Background task in slack");
+    assertEquals(3900,testScheduler.slack,"Scheduler slack later");
+    assertEquals(1950,testScheduler.minimumSlack,"Scheduler minimum slack kept");
+}
+
+void testSchedulerForegroundIdle(){
+    addTask(&testScheduler, &foregroundTask);
+    addTask(&testScheduler, &firstTask);
+    firstTask.cost = 2000;
+
+    // slack is only measured when the foreground task did work, otherwise the
+    // time left before it ran is used
+    foregroundWork = 0;
+    foregroundShToUpdate = MAX_SH_OUTPUTS - 1;
+    runScheduler(&testScheduler);
+    assertEquals(1,taskLogEquals("FA"),"Idle foreground leaves slack");
+    assertEquals(SCHEDULER_NO_SLACK_MEASURED,testScheduler.slack,"Idle foreground slack");
+    assertEquals(SCHEDULER_NO_SLACK_MEASURED,testScheduler.minimumSlack,"Idle foreground minimum slack");
+}
+
+// setup and run test suite
+void runSchedulerTests(){
+    reset();
+    resetSchedulerTest();
+    add(&testGetSlack);
+    add(&testAddTask);
+    add(&testSchedulerNoTasks);
+    add(&testSchedulerForegroundFirst);
+    add(&testSchedulerAddedOrder);
+    add(&testSchedulerMostOverdue);
+    add(&testSchedulerSlack);
+    add(&testSchedulerForegroundIdle);
+    run(resetSchedulerTest);
+}
\ No newline at end of file
@@ -0,0 +1 @@
+extern void runSchedulerTests();
\ No newline at end of file
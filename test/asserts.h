@@ -1,6 +1,6 @@
-#ifndef _ASSERTS_H
-#define _ASSERTS_H
-
-extern void assertEquals(int expected, int actual, char* message);
-extern void fail(char* message);
+#ifndef _ASSERTS_H
+#define _ASSERTS_H
+
+extern void assertEquals(int expected, int actual, char* message);
+extern void fail(char* message);
 #endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <time.h>
+#include "munit.h"
+#include "../types.h"
+#include "../config.h"
+#include "../matrix.test.h"
+#include "../output.test.h"
+#include "../display.test.h"
+#include "../scheduler.test.h"
+#include "../trace.test.h"
+#include "../batch.test.h"
+
+// Runs the test suites on the host and prints the failures. Build and run
+// from the repository root with, as one command:
+//
+//   gcc -DTARGET_HOST -I. -rdynamic -pthread -o omm-tests matrix.c
+//       matrix.bench.c codegen.c output.c display.c scheduler.c trace.c
+//       batch.c matrix.test.c output.test.c display.test.c
+//       scheduler.test.c trace.test.c batch.test.c test/munit.c
+//       test/asserts.c test/host.c -ldl
+//
+// The compiled patch tests build emitted patches with the compiler in CC.
+//
+// Prints the time of every test in microseconds, then the failures. Exits with
+// 1 if any test failed.
+
+// registers and EEPROM of the PIC, see host.h
+HostInterruptControl INTCON;
+unsigned char LATD;
+unsigned char TRISD;
+unsigned short hostEeprom[EEPROM_SIZE];
+
+// lcd, see host.h
+char hostLcd[HOST_LCD_SIZE];
+unsigned short hostLcdAddress;
+unsigned int hostLcdWrites;
+
+// suites with a failed test
+unsigned short failedSuites;
+
+unsigned short EEPROM_Read(unsigned int address){
+    return hostEeprom[address];
+}
+
+void EEPROM_Write(unsigned int address, unsigned short data){
+    hostEeprom[address] = data & 0xFF;
+}
+
+// Takes the set address command and characters, like a HD44780 the address
+// moves on after every character.
+void displayWrite(unsigned short value, unsigned short isData){
+    hostLcdWrites++;
+    if(isData){
+        hostLcd[hostLcdAddress] = value;
+        hostLcdAddress = (hostLcdAddress + 1) % HOST_LCD_SIZE;
+    } else if(value & 0x80){
+        hostLcdAddress = value & 0x7F;
+    }
+}
+
+unsigned long hostTimer(){
+    return (unsigned long)((double)clock() * 1000000.0 / CLOCKS_PER_SEC);
+}
+
+// print the results of the suite that was just run
+void report(char *suite){
+    unsigned short i;
+    for(i=0; i<getTestCount(); i++){
+        printf("%s test %u: %lu us\n", suite, i + 1, getTestTime(i));
+    }
+    for(i=0; i<getMessageCount(); i++){
+        printf("%s test %u: %s\n", suite, getMessageTest(i) + 1, getMessage(i));
+    }
+    printf("%s: %u tests, %s\n", suite, getTestCount(), failedtests ? "failed" : "passed");
+    if(failedtests){
+        failedSuites++;
+    }
+}
+
+int main(){
+    setTestTimer(hostTimer);
+    runMatrixTests();
+    report("matrix");
+    runOutputTests();
+    report("output");
+    runDisplayTests();
+    report("display");
+    runSchedulerTests();
+    report("scheduler");
+    runTraceTests();
+    report("trace");
+    runBatchTests();
+    report("batch");
+    return failedSuites ? 1 : 0;
+}
\ No newline at end of file
@@ -1,33 +1,108 @@
-#include "munit.h"
-
-unsigned short failedtests;
-testFunc tests[255];
-unsigned short currTest = 0;
-
-void msg(char* messsage){
-    //do nothing
-}
-
-void add(testFunc aTest){
-    tests[currTest++] = aTest;
-}
-
-void run(callback runBetweenTests){
-    unsigned short i;
-    for(i=0; i<currTest; i++){
-        tests[i]();
-        if(failedtests){
-//            break;
-        }
-        runBetweenTests();
-    }
-}
-
-void reset(){
-    currTest = 0;
-    failedtests = 0;
-}
-
-void error(){
-    failedtests = 1;
-}
+#include "munit.h"
+
+unsigned short failedtests;
+testFunc tests[MUNIT_MAX_TESTS];
+unsigned short currTest = 0;
+
+#ifdef TARGET_HOST
+// time each test took, if a timer is set
+testTimer timer = 0;
+unsigned long testTimes[MUNIT_MAX_TESTS];
+
+// test being run, messages are recorded against it
+unsigned short runningTest;
+
+// the first failure messages and the test each came from
+char messages[MUNIT_MAX_MESSAGES][MUNIT_MESSAGE_LENGTH];
+unsigned short messageTests[MUNIT_MAX_MESSAGES];
+unsigned short messagesInUse;
+#endif
+
+// keep a copy of the message, as it may be built in a buffer that is reused
+void msg(char* messsage){
+#ifdef TARGET_HOST
+    unsigned short i;
+    if(messagesInUse == MUNIT_MAX_MESSAGES){
+        return;
+    }
+    for(i=0; i<MUNIT_MESSAGE_LENGTH-1 && messsage[i]; i++){
+        messages[messagesInUse][i] = messsage[i];
+    }
+    messages[messagesInUse][i] = 0;
+    messageTests[messagesInUse] = runningTest;
+    messagesInUse++;
+#endif
+}
+
+void add(testFunc aTest){
+    if(currTest == MUNIT_MAX_TESTS){
+        return;
+    }
+    tests[currTest++] = aTest;
+}
+
+void run(callback runBetweenTests){
+    unsigned short i;
+#ifdef TARGET_HOST
+    unsigned long start;
+#endif
+    for(i=0; i<currTest; i++){
+#ifdef TARGET_HOST
+        runningTest = i;
+        if(timer){
+            start = timer();
+        }
+#endif
+        tests[i]();
+#ifdef TARGET_HOST
+        if(timer){
+            testTimes[i] = timer() - start;
+        }
+#endif
+        if(failedtests){
+//            break;
+        }
+        runBetweenTests();
+    }
+}
+
+void reset(){
+    currTest = 0;
+    failedtests = 0;
+#ifdef TARGET_HOST
+    messagesInUse = 0;
+#endif
+}
+
+void error(){
+    failedtests = 1;
+}
+
+unsigned short getTestCount(){
+    return currTest;
+}
+
+#ifdef TARGET_HOST
+// time each test with timer, 0 to stop timing
+void setTestTimer(testTimer aTimer){
+    timer = aTimer;
+}
+
+// time the test took, in the unit of the timer
+unsigned long getTestTime(unsigned short test){
+    return testTimes[test];
+}
+
+unsigned short getMessageCount(){
+    return messagesInUse;
+}
+
+char* getMessage(unsigned short message){
+    return messages[message];
+}
+
+// index of the test, in the order added, that recorded the message
+unsigned short getMessageTest(unsigned short message){
+    return messageTests[message];
+}
+#endif
\ No newline at end of file
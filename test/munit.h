@@ -1,15 +1,36 @@
-#ifndef _MUNIT_H
-#define _MUNIT_H
-
-// pointer to test function
-typedef void (*testFunc)();
-typedef void (*callback)();
-
-extern short failedtests;
-extern void msg(char* messsage);
-extern void add(testFunc aTest);
-extern void run(callback runBetweenTests);
-extern void reset();
-extern void error();
-
-#endif
+#ifndef _MUNIT_H
+#define _MUNIT_H
+
+// most tests that can be added
+#ifndef MUNIT_MAX_TESTS
+#define MUNIT_MAX_TESTS 255
+#endif
+
+// most failure messages kept, and the length they are cut to. Messages and
+// test times are only kept on the host, there is no RAM for them on the PIC.
+#define MUNIT_MAX_MESSAGES 8
+#define MUNIT_MESSAGE_LENGTH 64
+
+// pointer to test function
+typedef void (*testFunc)();
+typedef void (*callback)();
+
+// returns the current time in any unit, used to time each test
+typedef unsigned long (*testTimer)();
+
+extern unsigned short failedtests;
+extern void msg(char* messsage);
+extern void add(testFunc aTest);
+extern void run(callback runBetweenTests);
+extern void reset();
+extern void error();
+extern unsigned short getTestCount();
+#ifdef TARGET_HOST
+extern void setTestTimer(testTimer timer);
+extern unsigned long getTestTime(unsigned short test);
+extern unsigned short getMessageCount();
+extern char* getMessage(unsigned short message);
+extern unsigned short getMessageTest(unsigned short message);
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "trace.h"
+
+// Trace recorder for debugging patches. The results of up to TRACE_CHANNELS
+// nodes are recorded after every matrix run into a ring of fixed size blocks.
+// Each block starts with the raw values of all channels, followed by a token
+// per channel for every tick where any channel changed, or a run token
+// counting ticks where none did. A block is closed when the worst case tick
+// might not fit, so recording a tick never costs more than writing two bytes
+// per channel, and the oldest block can be dropped without losing the values
+// the following blocks start from.
+//
+// dumpTrace() writes the blocks as hex text, oldest first:
+//   OMMTRACE
+//   C <channels>
+//   N <node> <node> ...
+//   B <tick of first value> <block bytes>
+//   E
+// decodeTrace() turns that back into CSV on the host.
+
+// the keyframe and the largest possible tick must fit in a block, and block
+// offsets are kept in a byte.
+STATIC_ASSERT(TRACE_BLOCK_BYTES >= TRACE_CHANNELS * 3, trace_tick_fits_block);
+STATIC_ASSERT(TRACE_BLOCK_BYTES <= 255, trace_block_offset_fits_byte);
+
+unsigned short traceBuffer[TRACE_BLOCKS][TRACE_BLOCK_BYTES];
+
+// bytes used in each block and the tick of the block keyframe
+unsigned short traceBlockUsed[TRACE_BLOCKS];
+unsigned int traceBlockTick[TRACE_BLOCKS];
+
+// nodes being recorded and their values at the last tick
+nodeindex traceNodes[TRACE_CHANNELS];
+matrixint traceLast[TRACE_CHANNELS];
+unsigned short traceChannelsInUse;
+
+// block being written, number of blocks holding data and the offset of the
+// run token at the end of the block.
+unsigned short traceBlock;
+unsigned short traceBlocksFilled;
+unsigned short traceRunAt;
+
+unsigned int traceTicks;
+unsigned short traceRunning;
+
+// forget all channels and recorded data
+void traceInit(){
+    traceChannelsInUse = 0;
+    traceRunning = 0;
+    traceBlocksFilled = 0;
+}
+
+// record the result of a node, returns 0 if all channels are in use or the
+// node does not exist.
+unsigned short addTraceNode(Matrix *aMatrix, nodeindex node){
+    if(traceChannelsInUse == TRACE_CHANNELS || node >= aMatrix->nodesInUse){
+        return 0;
+    }
+    traceNodes[traceChannelsInUse] = node;
+    traceChannelsInUse++;
+    return 1;
+}
+
+// clear the recorded data and record from the next tick
+void traceStart(){
+    traceBlock = TRACE_BLOCKS - 1;
+    traceBlockUsed[traceBlock] = TRACE_BLOCK_BYTES;
+    traceBlocksFilled = 0;
+    traceTicks = 0;
+    traceRunning = 1;
+}
+
+// stop recording, the data is kept until the next traceStart()
+void traceStop(){
+    traceRunning = 0;
+}
+
+// start the next block with the values of all channels
+void traceStartBlock(Matrix *aMatrix){
+    unsigned short i;
+
+    traceBlock++;
+    if(traceBlock == TRACE_BLOCKS){
+        traceBlock = 0;
+    }
+    if(traceBlocksFilled < TRACE_BLOCKS){
+        traceBlocksFilled++;
+    }
+
+    for(i = 0; i<traceChannelsInUse; i++){
+        traceLast[i] = aMatrix->nodes[traceNodes[i]]->result;
+        traceBuffer[traceBlock][i] = traceLast[i];
+    }
+    traceBlockUsed[traceBlock] = traceChannelsInUse;
+    traceBlockTick[traceBlock] = traceTicks;
+    traceRunAt = TRACE_NO_RUN;
+}
+
+// Record the traced nodes, run once after every completed matrix run.
+void traceTick(Matrix *aMatrix){
+    unsigned short i, used, changed;
+    unsigned short *block;
+    matrixint value;
+    int delta;
+
+    if(!traceRunning){
+        return;
+    }
+
+    if(traceBlockUsed[traceBlock] + traceChannelsInUse * 2 > TRACE_BLOCK_BYTES){
+        traceStartBlock(aMatrix);
+        traceTicks++;
+        return;
+    }
+
+    block = traceBuffer[traceBlock];
+    used = traceBlockUsed[traceBlock];
+
+    changed = 0;
+    for(i = 0; i<traceChannelsInUse; i++){
+        if(aMatrix->nodes[traceNodes[i]]->result != traceLast[i]){
+            changed = 1;
+        }
+    }
+
+    if(!changed){
+        if(traceRunAt != TRACE_NO_RUN && block[traceRunAt] != TRACE_RUN_MAX){
+            block[traceRunAt]++;
+        } else {
+            traceRunAt = used;
+            block[used] = TRACE_RUN;
+            used++;
+        }
+    } else {
+        traceRunAt = TRACE_NO_RUN;
+        for(i = 0; i<traceChannelsInUse; i++){
+            value = aMatrix->nodes[traceNodes[i]]->result;
+            delta = value - traceLast[i];
+            if(delta >= -64 && delta <= 63){
+                block[used] = delta & TRACE_DELTA_MASK;
+                used++;
+            } else {
+                block[used] = TRACE_ABSOLUTE;
+                block[used+1] = value;
+                used += 2;
+            }
+            traceLast[i] = value;
+        }
+    }
+
+    traceBlockUsed[traceBlock] = used;
+    traceTicks++;
+}
+
+// write a value as a given number of hex digits
+void traceHex(charSink sink, unsigned int value, unsigned short digits){
+    unsigned short digit;
+    while(digits){
+        digits--;
+        digit = (value >> (digits * 4)) & 0x0F;
+        if(digit < 10){
+            sink('0' + digit);
+        } else {
+            sink('A' + digit - 10);
+        }
+    }
+}
+
+void traceLine(charSink sink){
+    sink('\r');
+    sink('\n');
+}
+
+// Write the recorded data as text, oldest block first. Blocking, stop the
+// trace before dumping so the data does not change underneath.
+void dumpTrace(charSink sink){
+    unsigned short i, block, count;
+
+    sink('O'); sink('M'); sink('M');
+    sink('T'); sink('R'); sink('A'); sink('C'); sink('E');
+    traceLine(sink);
+
+    sink('C');
+    sink(' ');
+    traceHex(sink, traceChannelsInUse, 2);
+    traceLine(sink);
+
+    sink('N');
+    for(i = 0; i<traceChannelsInUse; i++){
+        sink(' ');
+        traceHex(sink, traceNodes[i], 4);
+    }
+    traceLine(sink);
+
+    if(traceBlocksFilled < TRACE_BLOCKS){
+        block = 0;
+    } else {
+        block = traceBlock + 1;
+    }
+    for(count = 0; count<traceBlocksFilled; count++){
+        if(block == TRACE_BLOCKS){
+            block = 0;
+        }
+        sink('B');
+        sink(' ');
+        traceHex(sink, traceBlockTick[block], 4);
+        sink(' ');
+        for(i = 0; i<traceBlockUsed[block]; i++){
+            traceHex(sink, traceBuffer[block][i], 2);
+        }
+        traceLine(sink);
+        block++;
+    }
+
+    sink('E');
+    traceLine(sink);
+}
+
+#ifdef TARGET_HOST
+// read a number of hex digits, returns 0 if there are not enough of them
+unsigned short traceReadHex(const char **text, unsigned short digits, unsigned int *value){
+    char character;
+    *value = 0;
+    while(digits){
+        character = **text;
+        if(character >= '0' && character <= '9'){
+            *value = (*value << 4) | (character - '0');
+        } else if(character >= 'A' && character <= 'F'){
+            *value = (*value << 4) | (character - 'A' + 10);
+        } else {
+            return 0;
+        }
+        (*text)++;
+        digits--;
+    }
+    return 1;
+}
+
+// write a number in decimal
+void traceDecimal(charSink sink, long number){
+    char digits[11];
+    unsigned short count;
+
+    if(number < 0){
+        sink('-');
+        number = -number;
+    }
+    count = 0;
+    do {
+        digits[count] = '0' + number % 10;
+        number = number / 10;
+        count++;
+    } while(number);
+    while(count){
+        count--;
+        sink(digits[count]);
+    }
+}
+
+// write one CSV row
+void traceRow(charSink sink, long tick, int *values, unsigned short channels){
+    unsigned short i;
+    traceDecimal(sink, tick);
+    for(i = 0; i<channels; i++){
+        sink(',');
+        traceDecimal(sink, values[i]);
+    }
+    traceLine(sink);
+}
+
+// Turn the output of dumpTrace() into CSV with a tick column and a column per
+// traced node. Ticks count on from the first tick of the oldest block, so
+// they keep increasing when the tick counter has wrapped. Returns 0 if the
+// dump is malformed.
+unsigned short decodeTrace(const char *dump, charSink sink){
+    int values[TRACE_CHANNELS];
+    unsigned short channels, i, token;
+    unsigned int value, lastBlockTick;
+    long tick, blockTick;
+    unsigned short blocks;
+
+    while(*dump == '\r' || *dump == '\n'){
+        dump++;
+    }
+    for(i = 0; i<8; i++){
+        if(dump[i] != "OMMTRACE"[i]){
+            return 0;
+        }
+    }
+    dump += 8;
+
+    while(*dump == '\r' || *dump == '\n'){
+        dump++;
+    }
+    if(*dump != 'C' || dump[1] != ' '){
+        return 0;
+    }
+    dump += 2;
+    if(!traceReadHex(&dump, 2, &value) || value > TRACE_CHANNELS){
+        return 0;
+    }
+    channels = value;
+
+    while(*dump == '\r' || *dump == '\n'){
+        dump++;
+    }
+    if(*dump != 'N'){
+        return 0;
+    }
+    dump++;
+    sink('t'); sink('i'); sink('c'); sink('k');
+    for(i = 0; i<channels; i++){
+        if(*dump != ' ' ){
+            return 0;
+        }
+        dump++;
+        if(!traceReadHex(&dump, 4, &value)){
+            return 0;
+        }
+        sink(',');
+        sink('n'); sink('o'); sink('d'); sink('e');
+        traceDecimal(sink, value);
+    }
+    traceLine(sink);
+
+    blocks = 0;
+    blockTick = 0;
+    lastBlockTick = 0;
+    while(1){
+        while(*dump == '\r' || *dump == '\n'){
+            dump++;
+        }
+        if(*dump == 'E'){
+            return 1;
+        }
+        if(*dump != 'B' || dump[1] != ' '){
+            return 0;
+        }
+        dump += 2;
+        if(!traceReadHex(&dump, 4, &value) || *dump != ' '){
+            return 0;
+        }
+        dump++;
+
+        // unwrap the 16 bit tick counter, blocks are less than 65536 ticks
+        // apart.
+        if(blocks == 0){
+            blockTick = value;
+        } else {
+            blockTick += (value - lastBlockTick) & 0xFFFF;
+        }
+        lastBlockTick = value;
+        tick = blockTick;
+        blocks++;
+
+        for(i = 0; i<channels; i++){
+            if(!traceReadHex(&dump, 2, &value)){
+                return 0;
+            }
+            values[i] = (signed char)value;
+        }
+        traceRow(sink, tick, values, channels);
+
+        while(traceReadHex(&dump, 2, &value)){
+            token = value;
+            if((token & 0xC0) == TRACE_RUN){
+                token = (token & 0x3F) + 1;
+                while(token){
+                    tick++;
+                    traceRow(sink, tick, values, channels);
+                    token--;
+                }
+                continue;
+            }
+
+            tick++;
+            for(i = 0; i<channels; i++){
+                if(i > 0 && !traceReadHex(&dump, 2, &value)){
+                    return 0;
+                }
+                token = value;
+                if(token == TRACE_ABSOLUTE){
+                    if(!traceReadHex(&dump, 2, &value)){
+                        return 0;
+                    }
+                    values[i] = (signed char)value;
+                } else if(token & 0x80){
+                    return 0;
+                } else if(token & 0x40){
+                    values[i] += token - 0x80;
+                } else {
+                    values[i] += token;
+                }
+            }
+            traceRow(sink, tick, values, channels);
+        }
+    }
+}
+#endif
\ No newline at end of file
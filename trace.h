@@ -0,0 +1,26 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+// trace tokens, see trace.c
+#define TRACE_DELTA_MASK 0x7F     // 0xxxxxxx: value changed by a 7 bit signed delta
+#define TRACE_RUN 0x80            // 10nnnnnn: no channel changed for nnnnnn+1 ticks
+#define TRACE_RUN_MAX 0xBF
+#define TRACE_ABSOLUTE 0xC0       // 11000000 vvvvvvvv: value set to vvvvvvvv
+
+// current block has no run token that can be extended
+#define TRACE_NO_RUN 0xFF
+
+void traceInit();
+unsigned short addTraceNode(Matrix *aMatrix, nodeindex node);
+void traceStart();
+void traceStop();
+void traceTick(Matrix *aMatrix);
+void dumpTrace(charSink sink);
+
+#ifdef TARGET_HOST
+unsigned short decodeTrace(const char *dump, charSink sink);
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test/munit.h"
+#include "test/asserts.h"
+#include "types.h"
+#include "config.h"
+#include "trace.h"
+
+// Runs on the host only, decodeTrace() is not built for the PIC.
+
+#define TRACE_TEST_NODES 3
+#define TRACE_TEST_TICKS 1000
+
+extern unsigned int traceTicks;
+
+Matrix traceTestMatrix;
+Node traceTestNodes[TRACE_TEST_NODES];
+
+// values of the nodes at every tick
+matrixint traceHistory[TRACE_TEST_TICKS][TRACE_TEST_NODES];
+
+// text written by dumpTrace() and decodeTrace(), and the expected CSV
+char traceDump[8192];
+char traceCsv[65536];
+char traceExpected[65536];
+unsigned int traceDumpLength, traceCsvLength;
+
+unsigned int traceTestSeed;
+
+void traceDumpSink(char character){
+    if(traceDumpLength < sizeof(traceDump) - 1){
+        traceDump[traceDumpLength++] = character;
+        traceDump[traceDumpLength] = 0;
+    }
+}
+
+void traceCsvSink(char character){
+    if(traceCsvLength < sizeof(traceCsv) - 1){
+        traceCsv[traceCsvLength++] = character;
+        traceCsv[traceCsvLength] = 0;
+    }
+}
+
+void resetTraceTest(){
+    unsigned short i;
+    traceInit();
+    traceTestMatrix.nodesInUse = TRACE_TEST_NODES;
+    for(i = 0; i<TRACE_TEST_NODES; i++){
+        traceTestMatrix.nodes[i] = &traceTestNodes[i];
+        traceTestNodes[i].result = 0;
+    }
+    traceDumpLength = 0;
+    traceCsvLength = 0;
+    traceTestSeed = 1;
+}
+
+unsigned int traceTestRandom(){
+    traceTestSeed = traceTestSeed * 1103515245 + 12345;
+    return (traceTestSeed >> 16) & 0x7FFF;
+}
+
+// set the node results for a tick, record them and keep them to check against
+void traceTestTick(unsigned int tick, int value0, int value1, int value2){
+    traceTestNodes[0].result = value0;
+    traceTestNodes[1].result = value1;
+    traceTestNodes[2].result = value2;
+    traceHistory[tick][0] = value0;
+    traceHistory[tick][1] = value1;
+    traceHistory[tick][2] = value2;
+    traceTick(&traceTestMatrix);
+}
+
+// Dump and decode the trace of nodes 0 and 2, and check that it holds the
+// recorded ticks from firstTick up to lastTick. tickOffset is added to the
+// ticks in the CSV.
+void assertTraceRoundTrip(unsigned int firstTick, unsigned int lastTick, long tickOffset, char *message){
+    unsigned int tick, length;
+
+    dumpTrace(traceDumpSink);
+    assertEquals(1,decodeTrace(traceDump, traceCsvSink),message);
+
+    length = sprintf(traceExpected, "tick,node0,node2\r\n");
+    for(tick = firstTick; tick <= lastTick; tick++){
+        length += sprintf(traceExpected + length, "%ld,%d,%d\r\n",
+            tick + tickOffset, traceHistory[tick][0], traceHistory[tick][2]);
+    }
+    assertEquals(0,strcmp(traceExpected, traceCsv),message);
+}
+
+void testAddTraceNode(){
+    unsigned short i;
+    assertEquals(0,addTraceNode(&traceTestMatrix, TRACE_TEST_NODES),"Trace missing node");
+    for(i = 0; i<TRACE_CHANNELS; i++){
+        assertEquals(1,addTraceNode(&traceTestMatrix, 0),"Trace node");
+    }
+    assertEquals(0,addTraceNode(&traceTestMatrix, 0),"Trace channels full");
+}
+
+void testTraceTokens(){
+    unsigned int tick;
+
+    addTraceNode(&traceTestMatrix, 0);
+    addTraceNode(&traceTestMatrix, 2);
+    traceStart();
+    tick = 0;
+    // unchanged for longer than a run token holds
+    while(tick < 80){
+        traceTestTick(tick, 5, 1, -5);
+        tick++;
+    }
+    // the largest deltas, then just too large for a delta
+    traceTestTick(tick++, 68, 1, -69);
+    traceTestTick(tick++, 5, 1, -5);
+    traceTestTick(tick++, 69, 1, -70);
+    traceTestTick(tick++, 4, 1, 6);
+    // full range jumps and a change of an untraced node only
+    traceTestTick(tick++, 127, 1, -128);
+    traceTestTick(tick++, -128, 1, 127);
+    traceTestTick(tick++, -128, 50, 127);
+    traceTestTick(tick++, -127, 50, 126);
+    assertTraceRoundTrip(0, tick - 1, 0, "Trace tokens round trip");
+}
+
+void testTraceRandomRoundTrip(){
+    unsigned int tick;
+    int value0, value2;
+
+    addTraceNode(&traceTestMatrix, 0);
+    addTraceNode(&traceTestMatrix, 2);
+    traceStart();
+    value0 = 0;
+    value2 = 0;
+    // small steps, jumps and holds, short enough to fit in the trace
+    for(tick = 0; tick < 300; tick++){
+        switch(traceTestRandom() % 4){
+            case 0:
+                value0 = (int)(traceTestRandom() & 0xFF) - 128;
+                break;
+            case 1:
+                value0 = (matrixint)(value0 + (int)(traceTestRandom() % 9) - 4);
+                value2 = (matrixint)(value2 + (int)(traceTestRandom() % 129) - 64);
+                break;
+        }
+        traceTestTick(tick, value0, tick & 0xFF, value2);
+    }
+    assertTraceRoundTrip(0, tick - 1, 0, "Trace random round trip");
+}
+
+void testTraceDropsOldest(){
+    unsigned int tick, firstTick;
+    char *firstRow;
+
+    addTraceNode(&traceTestMatrix, 0);
+    addTraceNode(&traceTestMatrix, 2);
+    traceStart();
+    for(tick = 0; tick < TRACE_TEST_TICKS; tick++){
+        traceTestTick(tick, (int)(traceTestRandom() & 0xFF) - 128, 0, tick & 0x7F);
+    }
+
+    // the trace starts at the oldest block left and ends at the last tick
+    dumpTrace(traceDumpSink);
+    decodeTrace(traceDump, traceCsvSink);
+    firstRow = strchr(traceCsv, '\n') + 1;
+    firstTick = strtoul(firstRow, 0, 10);
+    assertEquals(1,firstTick > 0,"Trace dropped oldest block");
+    traceDumpLength = 0;
+    traceCsvLength = 0;
+    assertTraceRoundTrip(firstTick, tick - 1, 0, "Trace drops oldest round trip");
+}
+
+void testTraceTickWraps(){
+    unsigned int tick;
+
+    addTraceNode(&traceTestMatrix, 0);
+    addTraceNode(&traceTestMatrix, 2);
+    traceStart();
+    // the dump keeps 16 bits of the tick counter, like the PIC
+    traceTicks = 0xFFF0;
+    for(tick = 0; tick < 100; tick++){
+        traceTestTick(tick, tick & 0x3F, 0, -(int)(tick & 0x1F));
+    }
+    assertTraceRoundTrip(0, tick - 1, 0xFFF0, "Trace tick wraps");
+}
+
+void testTraceStop(){
+    unsigned int tick;
+
+    addTraceNode(&traceTestMatrix, 0);
+    addTraceNode(&traceTestMatrix, 2);
+    traceStart();
+    for(tick = 0; tick < 10; tick++){
+        traceTestTick(tick, tick, 0, -(int)tick);
+    }
+    traceStop();
+    traceTestTick(10, 100, 0, 100);
+    assertTraceRoundTrip(0, 9, 0, "Trace stopped");
+}
+
+void testDecodeTraceMalformed(){
+    assertEquals(0,decodeTrace("OMMTRAC", traceCsvSink),"Decode trace header");
+    assertEquals(0,decodeTrace("OMMTRACE\r\nC 09\r\n", traceCsvSink),"Decode trace channels");
+    assertEquals(0,decodeTrace("OMMTRACE\r\nC 01\r\nN 0000\r\nB 0000 0501", traceCsvSink),"Decode trace truncated");
+    assertEquals(0,decodeTrace("OMMTRACE\r\nC 01\r\nN 0000\r\nB 0000 05C0\r\nE\r\n", traceCsvSink),"Decode trace absolute");
+    assertEquals(1,decodeTrace("OMMTRACE\r\nC 01\r\nN 0000\r\nB 0000 05C0FF\r\nE\r\n", traceCsvSink),"Decode trace");
+}
+
+// setup and run test suite
+void runTraceTests(){
+    reset();
+    resetTraceTest();
+    add(&testAddTraceNode);
+    add(&testTraceTokens);
+    add(&testTraceRandomRoundTrip);
+    add(&testTraceDropsOldest);
+    add(&testTraceTickWraps);
+    add(&testTraceStop);
+    add(&testDecodeTraceMalformed);
+    run(resetTraceTest);
+}
\ No newline at end of file
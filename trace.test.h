@@ -0,0 +1 @@
+extern void runTraceTests();
\ No newline at end of file
@@ -1,47 +1,204 @@
-#ifndef _TYPES_H
-#define _TYPES_H
-
-// datatype to use for matrix, makes it easier to switch between 8 and 16 bit
-// operations later.
-#define matrixint short
-#define matrixintrange 256
-#define matrixintmin -128
-#define matrixintmax 127
-
-#define matrixlongint int
-#define matrixlongintrange 65535
-#define matrixlongintmin -32768
-#define matrixlongintmax 32767
-
-//function pointer to a matrix node function
-typedef void (*nodeFunction)(struct matrixNode *);
-
-//node in matrix
-typedef struct matrixNode{
-    // function to run when this Node is accessed
-    nodeFunction func;
-
-    // parameters passed to this node
-    matrixint params[8];
-
-    // Bitwise variable that indicates usage of params:
-    // 1 signifies that param is a constant
-    // 0 that it is the index of the Node to get result from
-    unsigned short paramIsConstant;
-
-    // How many of the input params are used
-    unsigned short paramsInUse;
-
-    // high res status variable for ramps etc, to reduce effects of rounding
-    // errors.
-    int highResState;
-
-    // state, holds flags for
-    short state;
-
-    // placeholder for result from Node function
-    matrixint result;
-
-} Node;
-
+#ifndef _TYPES_H
+#define _TYPES_H
+
+#include "config.h"
+
+// datatype to use for matrix, makes it easier to switch between 8 and 16 bit
+// operations later. short and int are wider on the host, so it uses fixed
+// width types to wrap and saturate like the PIC does.
+#ifdef TARGET_HOST
+#define matrixint int8_t
+#else
+#define matrixint short
+#endif
+#define matrixintrange 256
+#define matrixintmin -128
+#define matrixintmax 127
+
+#ifdef TARGET_HOST
+#define matrixlongint int16_t
+#else
+#define matrixlongint int
+#endif
+#define matrixlongintrange 65535
+#define matrixlongintmin -32768
+#define matrixlongintmax 32767
+
+// datatype of an entry in the operand pool, either a constant or the index of
+// the Node to get result from, so it must be able to hold any node index.
+#if MAX_OPERATIONS > matrixintmax
+#define operandint int
+#else
+#define operandint matrixint
+#endif
+
+// datatypes used to index nodes and the operand pool, only widened when the
+// configured capacity needs it.
+#if MAX_OPERATIONS > 255
+#define nodeindex unsigned int
+#else
+#define nodeindex unsigned short
+#endif
+
+#if MAX_OPERANDS > 255
+#define paramindex unsigned int
+#else
+#define paramindex unsigned short
+#endif
+
+struct matrix;
+struct matrixNode;
+
+//function pointer to a matrix node function
+typedef void (*nodeFunction)(struct matrix *, struct matrixNode *);
+
+// function writing a single character somewhere, used for text output that
+// must not depend on a particular device.
+typedef void (*charSink)(char character);
+
+//node in matrix
+typedef struct matrixNode{
+    // function to run when this Node is accessed
+    nodeFunction func;
+
+    // index of the first parameter of this node in the shared operand pool,
+    // the parameters of a node are stored one after another from here.
+    paramindex firstParam;
+
+    // How many of the input params are used
+    paramindex paramsInUse;
+
+    // high res status variable for ramps etc, to reduce effects of rounding
+    // errors.
+    int highResState;
+
+    // second state variable for nodes that need to keep more than one value
+    // between runs, e.g. the step size of a constant time glide.
+    int auxState;
+
+    // state, holds flags for
+    short state;
+
+    // the node is run every 2^rateShift matrix runs. Time based nodes multiply
+    // their increments by the same amount to keep their timing.
+    unsigned short rateShift;
+
+    // matrix runs left until the node is run again
+    unsigned short rateCountdown;
+
+    // placeholder for result from Node function
+    matrixint result;
+
+} Node;
+
+// A step of a sequencer pattern. The step lasts length triggers, 0 counts as
+// 1, and the gate is on for all of them if gate is set.
+typedef struct sequencerStep{
+    matrixint value;
+    unsigned short gate;
+    unsigned short length;
+} SequencerStep;
+
+// Sequencer pattern, kept in flash and read in place by sequencer nodes.
+typedef struct sequencerPattern{
+    unsigned short stepsInUse;
+    SequencerStep steps[SEQUENCER_MAX_STEPS];
+} SequencerPattern;
+
+// Depth and offset applied to a node param as it is read, so a modulation
+// amount does not need a scale node of its own. See attenuateParam().
+typedef struct attenuation{
+    // node the param reads
+    nodeindex source;
+
+    // the result is scaled by gain / (MAX_POSITIVE + 1), negative gains invert
+    matrixint gain;
+
+    // added after scaling, the sum saturates
+    matrixint offset;
+} Attenuation;
+
+// A complete matrix instance. All state used while running a patch is kept
+// here, so several matrices can be built and run independently of each other.
+typedef struct matrix{
+    // matrix nodes
+    Node *nodes[MAX_OPERATIONS];
+    nodeindex nodesInUse;
+
+    // shared operand pool. Every node uses exactly as many operands as it has
+    // params, so single input nodes only pay for one and n-ary nodes are not
+    // limited to a fixed number of inputs.
+    operandint params[MAX_OPERANDS];
+    paramindex paramsInPool;
+
+    // Bitwise variable that indicates usage of operands, one bit per operand:
+    // 1 signifies that param is a constant
+    // 0 that it is the index of the Node to get result from
+    unsigned short paramIsConstant[(MAX_OPERANDS + 7) >> 3];
+
+    // Bitwise variable, one bit per operand: 1 signifies that the operand is
+    // the index of the Attenuation holding the node to read, 0 that it is used
+    // as flagged in paramIsConstant.
+    unsigned short paramIsAttenuated[(MAX_OPERANDS + 7) >> 3];
+    Attenuation attenuations[MAX_ATTENUATIONS];
+    paramindex attenuationsInUse;
+
+    // samples of all delay buffer nodes, each node gets a part of it when the
+    // patch is validated, see allocateDelay().
+    matrixint delayArena[DELAY_ARENA_SIZE];
+    unsigned int delayArenaInUse;
+
+#ifdef MATRIX_LINKED_OPERANDS
+    // every operand resolved to the value it reads, set by linkPatch(). Node
+    // params point to the result of the node, constants to their copy in
+    // linkedConstants.
+    matrixint *linkedParams[MAX_OPERANDS];
+    matrixint linkedConstants[MAX_OPERANDS];
+#endif
+
+    // set to PATCH_LINKED or PATCH_LINKED_ATTENUATED when the operands have
+    // been linked, cleared when the patch changes
+    unsigned short patchLinked;
+
+    // set if the patch could not be built, checked by validatePatch()
+    unsigned short patchStatus;
+
+    // index of the node that failed validation
+    nodeindex patchErrorNode;
+
+    // patterns sequencer nodes can play, usually sequencerPatterns in flash
+    const SequencerPattern *patterns;
+    unsigned short patternsInUse;
+
+    // state of the random source used by nodes, see matrixRandom()
+    unsigned int randomState;
+
+    // place where matrix reads inputs from
+    matrixint inputBuffer[MAX_INPUTS];
+
+    // place where matrix write outputs to
+    matrixint *outputBuffer;
+
+    // gate outputs, one bit per digital output pin. Written by gate nodes
+    // while the matrix runs.
+    unsigned short gateBuffer;
+
+    // number of dac ticks left of the trigger pulse on each digital output
+    // pin. Set by trigger nodes, counted down when gates are flushed, so pulse
+    // width timing does not need any matrix nodes.
+    unsigned short triggerCountdown[MAX_GATE_OUTPUTS];
+
+    // node the next slice of a matrix run starts from, see runMatrixSlice()
+    nodeindex nextNode;
+
+    // true if a matrix run has been completed and data is ready to be copied
+    // to the dac buffer before the next dac cycle.
+    unsigned short matrixCalculationCompleted;
+
+    // time passed since the previous matrix run, in 1/256 of the nominal run
+    // time. Time based nodes scale their increments by this so their timing
+    // stays the same when the dac rate changes or dac cycles are missed.
+    unsigned int timeScale;
+} Matrix;
+
 #endif
\ No newline at end of file
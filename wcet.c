@@ -0,0 +1,184 @@
+#include "types.h"
+#include "config.h"
+#include "definitions.h"
+#include "nodetypes.h"
+#include "matrix.h"
+#include "wcet.h"
+
+// Worst case execution time estimates for a patch, in instruction cycles.
+// The cycle counts are estimates of the worst path through each node function.
+// benchNodeCosts() in matrix.bench.c measures the same costs on target to
+// check them against. Update them when node functions change. Indexed by node
+// type.
+
+// cycles used by a node regardless of number of params, including the worst
+// branch through the node function.
+const unsigned int nodeBaseCycles[NODE_TYPES] = {
+     40, // NODE_SUM
+     70, // NODE_INVERT
+     75, // NODE_INVERT_EACH_SIDE
+    260, // NODE_RAMP
+     65, // NODE_DELAY_LINE
+     80, // NODE_INPUT
+    120, // NODE_OUTPUT
+     45, // NODE_MULTIPLY
+    170, // NODE_MEMORY
+    330, // NODE_LFO_PULSE
+    120, // NODE_SWITCH
+    120, // NODE_COMPARE
+     45, // NODE_MAX
+     45, // NODE_MIN
+    200, // NODE_SCALE
+     80, // NODE_TRIGGER
+     40, // NODE_BINARY_AND
+     40, // NODE_BINARY_OR
+    130, // NODE_BINARY_XOR
+     70, // NODE_BINARY_NOT
+     10, // unused
+     10, // unused
+     10, // NODE_QUANTIZE
+    220, // NODE_GLIDE
+     10, // NODE_TUNE
+     90, // NODE_POSITIVE_EXP
+    110, // NODE_GATE_OUTPUT
+    120, // NODE_TRIGGER_OUTPUT
+    380, // NODE_SLEW
+    300, // NODE_FUSED_INPUT_SCALE_OUTPUT
+    260, // NODE_FUSED_INPUT_OFFSET_SCALE
+    140, // NODE_FUSED_COMPARE_TRIGGER
+     60, // NODE_MOD_MATRIX
+     10, // NODE_MOD_DESTINATION
+    260, // NODE_DIVIDE
+    240, // NODE_AVERAGE
+    110, // NODE_CLAMP
+    190, // NODE_CROSSFADE
+     60, // NODE_ABS
+    290, // NODE_DELAY_BUFFER
+    340, // NODE_SEQUENCER
+     60  // NODE_SEQUENCER_GATE
+};
+
+// cycles used for each param in use, for nodes that loop over all their params
+const unsigned int nodeParamCycles[NODE_TYPES] = {
+    55, 0, 0, 0, 0, 0, 0, 90, 0, 0, // NODE_SUM - NODE_LFO_PULSE
+     0, 0, 70, 70, 0, 0, 60, 60, 0, 0, // NODE_SWITCH - NODE_BINARY_NOT
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // unused - NODE_FUSED_INPUT_SCALE_OUTPUT
+     0, 0, 130, 0, 0, 55, 0, 0, 0, // NODE_FUSED_INPUT_OFFSET_SCALE - NODE_ABS
+     0, 0, 0                       // NODE_DELAY_BUFFER - NODE_SEQUENCER_GATE
+};
+
+// cycles used by runMatrix() for each node, whether it runs or not
+#define NODE_LOOP_CYCLES 30
+
+// cycles used to call a node function
+#define NODE_CALL_CYCLES 20
+
+// cycles of each dac interrupt, taken from the time left for the matrix
+#define DAC_INTERRUPT_CYCLES 200
+
+// cycles used to apply the depth and offset of an attenuated param
+#define ATTENUATION_CYCLES 230
+
+// cycles of the main loop around each matrix run
+#define MAIN_LOOP_CYCLES 100
+
+// cycles used to start a new frame, the division when frames are more than a
+// rotation apart, and per S&H channel to calibrate it and work out the step of
+// an interpolated channel. See startDacFrame().
+#define DAC_FRAME_CYCLES 500
+#define DAC_FRAME_CHANNEL_CYCLES 250
+
+// warn when the patch uses more than 7/8 of the budget
+#define WCET_WARNING_SHIFT 3
+
+// worst case cycles of running a single node
+unsigned int getNodeCycles(Matrix *aMatrix, Node *aNode){
+    paramindex param;
+    unsigned int cycles;
+    unsigned short type;
+    type = getFunctionType(aNode->func);
+    if(type == NODE_TYPES){
+        return 0;
+    }
+    cycles = NODE_CALL_CYCLES + nodeBaseCycles[type] + nodeParamCycles[type] * aNode->paramsInUse;
+    for(param = 0; param<aNode->paramsInUse; param++){
+        if(isAttenuatedParam(aMatrix, aNode, param)){
+            cycles += ATTENUATION_CYCLES;
+        }
+    }
+    return cycles;
+}
+
+// Estimate the worst case cycles of a single matrix run. Nodes running at a
+// lower rate only count on the runs they are due, so every run in the longest
+// rate period is checked to find the worst one.
+unsigned long estimatePatchCycles(Matrix *aMatrix){
+    unsigned long cycles, worstCycles;
+    unsigned short run, period;
+    nodeindex i;
+    Node *aNode;
+
+    worstCycles = 0;
+    for(run = 0; run < (1 << MAX_RATE_SHIFT); run++){
+        cycles = MAIN_LOOP_CYCLES + DAC_FRAME_CYCLES + DAC_FRAME_CHANNEL_CYCLES * MAX_SH_OUTPUTS;
+        for(i = 0; i<aMatrix->nodesInUse; i++){
+            aNode = aMatrix->nodes[i];
+            period = 1 << aNode->rateShift;
+            cycles += NODE_LOOP_CYCLES;
+            if(((run + period - aNode->rateCountdown) & (period - 1)) == 0){
+                cycles += getNodeCycles(aMatrix, aNode);
+            }
+        }
+        if(cycles > worstCycles){
+            worstCycles = cycles;
+        }
+    }
+    return worstCycles;
+}
+
+// cycles available to the matrix in one S&H rotation at the given timer start
+// value.
+unsigned long getDacBudgetCycles(unsigned int dacTimerStart){
+    unsigned long tickCycles;
+    tickCycles = (65536 - (unsigned long)dacTimerStart) * DAC_TIMER_PRESCALER;
+    if(tickCycles <= DAC_INTERRUPT_CYCLES){
+        return 0;
+    }
+    return (tickCycles - DAC_INTERRUPT_CYCLES) * MAX_SH_OUTPUTS;
+}
+
+// Find the highest dac timer start value, i.e. the fastest dac rate, that
+// leaves enough cycles for the patch to finish within one S&H rotation.
+// Returns 0 if even the slowest rate is too fast.
+unsigned int getMinimumDacTimerStart(Matrix *aMatrix){
+    unsigned long cycles, tickCycles;
+
+    cycles = estimatePatchCycles(aMatrix);
+
+    // cycles needed per dac tick, rounded up
+    tickCycles = (cycles + MAX_SH_OUTPUTS - 1) / MAX_SH_OUTPUTS + DAC_INTERRUPT_CYCLES;
+
+    // timer counts per tick, rounded up
+    tickCycles = (tickCycles + DAC_TIMER_PRESCALER - 1) / DAC_TIMER_PRESCALER;
+    if(tickCycles >= 65536){
+        return 0;
+    }
+    return 65536 - tickCycles;
+}
+
+// Check if the patch can finish within one S&H rotation at the given timer
+// start value. Returns WCET_OK, WCET_WARNING if the margin is small, or
+// WCET_OVERRUN if the patch will miss dac cycles.
+unsigned short checkPatchTiming(Matrix *aMatrix, unsigned int dacTimerStart){
+    unsigned long cycles, budget;
+
+    cycles = estimatePatchCycles(aMatrix);
+    budget = getDacBudgetCycles(dacTimerStart);
+
+    if(cycles > budget){
+        return WCET_OVERRUN;
+    } else if(cycles > budget - (budget >> WCET_WARNING_SHIFT)){
+        return WCET_WARNING;
+    }
+    return WCET_OK;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef _WCET_H
+#define _WCET_H
+
+#include "types.h"
+
+// result of timing check
+#define WCET_OK 0
+#define WCET_WARNING 1
+#define WCET_OVERRUN 2
+
+// dac timer runs at Fosc/4 with a prescaler of 4, see dacTimerInit()
+#define DAC_TIMER_PRESCALER 4
+
+unsigned int getNodeCycles(Matrix *aMatrix, Node *aNode);
+unsigned long estimatePatchCycles(Matrix *aMatrix);
+unsigned long getDacBudgetCycles(unsigned int dacTimerStart);
+unsigned int getMinimumDacTimerStart(Matrix *aMatrix);
+unsigned short checkPatchTiming(Matrix *aMatrix, unsigned int dacTimerStart);
+
+#endif
\ No newline at end of file